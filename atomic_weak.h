@@ -0,0 +1,359 @@
+//
+// A weak<Types...> that can be shared between threads without a lock around every access.
+//
+
+#ifndef WEAK_TYPES_ATOMIC_WEAK_H
+#define WEAK_TYPES_ATOMIC_WEAK_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include "weak.h"
+
+//=== bits ===//
+
+// The type index and the bytes of the value of a weak whose types are all trivially copyable and stored inline, packed
+// into a zeroed Word. Only the bytes of the current type are copied, so equal values always have equal bits.
+template <typename Weak>
+struct atomic_weak_bits;
+
+template <typename ... Types>
+struct atomic_weak_bits<weak<Types...>> {
+    typedef weak<Types...> weak_type;
+    typedef typename weak_type::tag_type tag_type;
+
+    static constexpr bool packable = static_all<(std::is_trivially_copyable<Types>::value &&
+                                                 weak_is_inline<Types>::value &&
+                                                 !weak_is_shared<Types>::value)...>::value;
+
+    static constexpr std::size_t size = sizeof(std::declval<const weak_type&>().storage) + sizeof(tag_type);
+
+    static std::size_t sizeOf(std::size_t index) {
+        // slot 0 is the invalid type
+        static const std::size_t sizes[] = { 0u, sizeof(Types)... };
+        return sizes[index];
+    }
+
+    template <typename Word>
+    static Word pack(const weak_type& value) {
+        Word word;
+        std::memset(&word, 0, sizeof(Word));
+
+        tag_type tag = static_cast<tag_type>(value.index());
+        std::memcpy(&word, &tag, sizeof(tag_type));
+        std::memcpy(reinterpret_cast<unsigned char*>(&word) + sizeof(tag_type), &value.storage, sizeOf(tag));
+
+        return word;
+    }
+
+    template <typename Word>
+    static weak_type unpack(const Word& word) {
+        weak_type value;
+
+        tag_type tag;
+        std::memcpy(&tag, &word, sizeof(tag_type));
+        std::memcpy(&value.storage, reinterpret_cast<const unsigned char*>(&word) + sizeof(tag_type), sizeOf(tag));
+        value.current_type = typename weak_type::type_id(tag);
+
+        return value;
+    }
+};
+
+//=== atomic_weak_base ===//
+
+enum class atomic_weak_kind {
+    // two copies guarded by reader counts, for any types
+    left_right,
+    // packed into a std::atomic<std::uint64_t>
+    word,
+    // packed into 16 bytes, swapped with a double width compare and swap
+    double_word
+};
+
+template <typename Weak, atomic_weak_kind Kind>
+class atomic_weak_base;
+
+// The weak is packed into one std::uint64_t, so every operation is a single atomic instruction and lock free wherever
+// 64 bit atomics are.
+template <typename Weak>
+class atomic_weak_base<Weak, atomic_weak_kind::word> {
+
+    typedef atomic_weak_bits<Weak> bits;
+
+    std::atomic<std::uint64_t> word;
+
+public:
+    static constexpr bool is_lock_free = ATOMIC_LLONG_LOCK_FREE == 2;
+
+    explicit atomic_weak_base(const Weak& value) : word(bits::template pack<std::uint64_t>(value)) {}
+
+    Weak load() const noexcept {
+        return bits::unpack(word.load(std::memory_order_acquire));
+    }
+
+    void store(const Weak& value) noexcept {
+        word.store(bits::template pack<std::uint64_t>(value), std::memory_order_release);
+    }
+
+    Weak exchange(const Weak& value) noexcept {
+        return bits::unpack(word.exchange(bits::template pack<std::uint64_t>(value), std::memory_order_acq_rel));
+    }
+
+    bool compare_exchange(Weak& expected, const Weak& desired) noexcept {
+        std::uint64_t current = bits::template pack<std::uint64_t>(expected);
+
+        if (word.compare_exchange_strong(current, bits::template pack<std::uint64_t>(desired),
+                                         std::memory_order_acq_rel, std::memory_order_acquire)) {
+            return true;
+        }
+
+        expected = bits::unpack(current);
+        return false;
+    }
+
+    template <template<typename Type, typename ... Ts> class Functor, typename ... Ts, typename ... Args>
+    void run(Args&&... args) const {
+        load().template run<Functor, Ts...>(std::forward<Args>(args)...);
+    }
+};
+
+#ifdef __GCC_HAVE_SYNC_COMPARE_AND_SWAP_16
+// The weak is packed into 16 bytes and every operation is a cmpxchg16b or its equivalent, loads included.
+// Requires the double width compare and swap to be enabled, e.g. with -mcx16 on x86-64.
+template <typename Weak>
+class atomic_weak_base<Weak, atomic_weak_kind::double_word> {
+
+    typedef atomic_weak_bits<Weak> bits;
+
+    typedef unsigned __int128 double_word;
+
+    alignas(16) mutable double_word word;
+
+    double_word swap(double_word expected, double_word desired) const noexcept {
+        return __sync_val_compare_and_swap(&word, expected, desired);
+    }
+
+public:
+    static constexpr bool is_lock_free = true;
+
+    explicit atomic_weak_base(const Weak& value) : word(bits::template pack<double_word>(value)) {}
+
+    Weak load() const noexcept {
+        // swapping 0 for 0 reads the current value without changing it
+        return bits::unpack(swap(0, 0));
+    }
+
+    void store(const Weak& value) noexcept {
+        exchange(value);
+    }
+
+    Weak exchange(const Weak& value) noexcept {
+        double_word desired = bits::template pack<double_word>(value);
+        double_word current = swap(0, 0);
+
+        for (;;) {
+            double_word found = swap(current, desired);
+            if (found == current) {
+                return bits::unpack(current);
+            }
+            current = found;
+        }
+    }
+
+    bool compare_exchange(Weak& expected, const Weak& desired) noexcept {
+        double_word current = bits::template pack<double_word>(expected);
+        double_word found = swap(current, bits::template pack<double_word>(desired));
+
+        if (found == current) {
+            return true;
+        }
+
+        expected = bits::unpack(found);
+        return false;
+    }
+
+    template <template<typename Type, typename ... Ts> class Functor, typename ... Ts, typename ... Args>
+    void run(Args&&... args) const {
+        load().template run<Functor, Ts...>(std::forward<Args>(args)...);
+    }
+};
+#endif
+
+// Left-right: readers announce themselves on a counter and read one of two copies of the weak, while a writer updates
+// the other copy, switches readers over to it, waits for the readers of the old copy to leave and updates that one too.
+// Readers never wait or lock. run reads the stored value in place and never allocates, load copies it, which allocates
+// if copying the value does. Writers are serialized by a mutex and wait for readers.
+template <typename Weak>
+class atomic_weak_base<Weak, atomic_weak_kind::left_right> {
+
+    // on its own cache line, so readers of one counter don't slow down readers of the other
+    struct alignas(64) reader_count {
+        std::atomic<std::size_t> count;
+    };
+
+    Weak instances[2];
+
+    std::atomic<unsigned> readable;
+
+    std::atomic<unsigned> version;
+
+    mutable reader_count readers[2];
+
+    std::mutex writer;
+
+    // counts the calling thread as a reader of the copy readable points to for its lifetime
+    class reading {
+        reader_count& announced;
+
+    public:
+        explicit reading(const atomic_weak_base& atomic) : announced(atomic.readers[atomic.version.load()]) {
+            announced.count.fetch_add(1);
+        }
+
+        ~reading() {
+            announced.count.fetch_sub(1);
+        }
+    };
+
+    static void waitFor(const reader_count& readersOf) {
+        while (readersOf.count.load() != 0u) {
+            std::this_thread::yield();
+        }
+    }
+
+    /// stores value, the writer lock must be held
+    void write(const Weak& value) {
+        unsigned current = readable.load();
+
+        instances[1 - current] = value;
+        readable.store(1 - current);
+
+        // new readers go to the other counter, then the ones that might still read the old copy drain
+        unsigned previousVersion = version.load();
+        waitFor(readers[1 - previousVersion]);
+        version.store(1 - previousVersion);
+        waitFor(readers[previousVersion]);
+
+        instances[current] = value;
+    }
+
+    template <typename T, typename ... Ts>
+    struct matches {
+        void operator() (const T& val, const Weak& stored, const Weak& expected, bool& same) const {
+            same = match(val, expected.template value<T>(), stored, expected, std::is_trivially_copyable<T>());
+        }
+
+        static bool match(const T& val, const T& other, const Weak&, const Weak&, std::true_type) {
+            return std::memcmp(&val, &other, sizeof(T)) == 0;
+        }
+
+        static bool match(const T&, const T&, const Weak& stored, const Weak& expected, std::false_type) {
+            return stored == expected;
+        }
+    };
+
+    static bool same(const Weak& stored, const Weak& expected) {
+        if (!(stored.type() == expected.type())) {
+            return false;
+        }
+
+        // both invalid when run finds no value
+        bool same = !stored.isValid();
+        stored.template run<matches>(stored, expected, same);
+        return same;
+    }
+
+public:
+    static constexpr bool is_lock_free = false;
+
+    explicit atomic_weak_base(const Weak& value) : instances{ value, value }, readable(0u), version(0u) {
+        readers[0].count.store(0u);
+        readers[1].count.store(0u);
+    }
+
+    Weak load() const {
+        reading reader(*this);
+        return instances[readable.load()];
+    }
+
+    void store(const Weak& value) {
+        std::lock_guard<std::mutex> lock(writer);
+        write(value);
+    }
+
+    Weak exchange(const Weak& value) {
+        std::lock_guard<std::mutex> lock(writer);
+
+        Weak previous = instances[readable.load()];
+        write(value);
+
+        return previous;
+    }
+
+    bool compare_exchange(Weak& expected, const Weak& desired) {
+        std::lock_guard<std::mutex> lock(writer);
+
+        const Weak& current = instances[readable.load()];
+        if (same(current, expected)) {
+            write(desired);
+            return true;
+        }
+
+        expected = current;
+        return false;
+    }
+
+    /// runs Functor on the stored value in place, without copying it
+    template <template<typename Type, typename ... Ts> class Functor, typename ... Ts, typename ... Args>
+    void run(Args&&... args) const {
+        reading reader(*this);
+        instances[readable.load()].template run<Functor, Ts...>(std::forward<Args>(args)...);
+    }
+};
+
+//=== atomic_weak ===//
+
+template <typename ... Types>
+struct atomic_weak_kind_of : std::integral_constant<atomic_weak_kind,
+        !atomic_weak_bits<weak<Types...>>::packable ? atomic_weak_kind::left_right :
+        atomic_weak_bits<weak<Types...>>::size <= sizeof(std::uint64_t) ? atomic_weak_kind::word :
+#ifdef __GCC_HAVE_SYNC_COMPARE_AND_SWAP_16
+        atomic_weak_bits<weak<Types...>>::size <= 16 ? atomic_weak_kind::double_word :
+#endif
+        atomic_weak_kind::left_right>
+{};
+
+// A weak<Types...> with load, store, exchange and compare_exchange that are safe to call from any number of threads.
+// When every type is trivially copyable and stored inline, and the type index and the largest value fit in 8 bytes (or
+// 16 where a double width compare and swap is available), every operation is one lock free atomic instruction.
+// Otherwise it falls back to two copies that readers read without waiting, and writers update under a mutex.
+//
+// compare_exchange succeeds when the stored weak has the same type as expected and the same value: the same bytes for
+// trivially copyable types, like std::atomic, so a stored NaN matches an expected NaN with the same bits, and == for
+// the others. Every kind follows this rule, so which one a build picks never changes the result.
+template <typename ... Types>
+class atomic_weak : public atomic_weak_base<weak<Types...>, atomic_weak_kind_of<Types...>::value> {
+
+    typedef atomic_weak_base<weak<Types...>, atomic_weak_kind_of<Types...>::value> base;
+
+public:
+    atomic_weak() : base(weak<Types...>()) {}
+
+    atomic_weak(const weak<Types...>& value) : base(value) {}
+
+    atomic_weak(const atomic_weak&) = delete;
+    atomic_weak& operator=(const atomic_weak&) = delete;
+
+    atomic_weak& operator=(const weak<Types...>& value) {
+        this -> store(value);
+        return *this;
+    }
+
+    operator weak<Types...>() const {
+        return this -> load();
+    }
+};
+
+#endif //WEAK_TYPES_ATOMIC_WEAK_H
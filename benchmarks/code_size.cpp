@@ -0,0 +1,145 @@
+//
+// Measures how many bytes of code and data compile_time_subject.cpp compiles to for weak types of 4, 16, 32 and 64
+// alternatives, with and without WEAK_SMALL_CODE, broken down by what the symbols are. Prints one JSON object per size
+// and mode.
+//
+// usage: code_size [--compiler c++] [--nm nm] [--subject compile_time_subject.cpp] [--include ..] [--flags "-Os"]
+// Pass a cross compiler and its nm to measure a board, e.g. --compiler avr-g++ --nm avr-nm --flags "-Os -mmcu=atmega2560"
+// Exits with 1 if a build fails.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+struct breakdown {
+    bool succeeded;
+    long kernels;     // code of the type erased kernels the tables point to
+    long tables;      // the tables themselves, and any other data
+    long dispatch;    // code of run and its jump tables' targets other than kernels
+    long other;       // everything else, such as the operators and the subject itself
+
+    long total() const {
+        return kernels + tables + dispatch + other;
+    }
+};
+
+bool run(const std::vector<std::string>& command) {
+    std::vector<char*> argv;
+    for (const std::string& argument : command) {
+        argv.push_back(const_cast<char*>(argument.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    pid_t child = fork();
+    if (child == 0) {
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+
+    int status = 0;
+    return child > 0 && waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// adds up the sizes nm reports for the symbols of object, by the kind of symbol
+breakdown measure(const std::string& nm, const std::string& object) {
+    breakdown sizes = { false, 0, 0, 0, 0 };
+
+    std::string command = nm + " --size-sort --radix=d -C " + object;
+    FILE* symbols = popen(command.c_str(), "r");
+    if (symbols == nullptr) {
+        return sizes;
+    }
+
+    char line[8192];
+    while (std::fgets(line, sizeof(line), symbols) != nullptr) {
+        // size type name, --size-sort leaves out the address
+        std::istringstream fields(line);
+        std::string type, name;
+        long size = 0;
+
+        if (!(fields >> size >> type)) {
+            continue;
+        }
+        std::getline(fields, name);
+
+        bool code = type == "t" || type == "T" || type == "W" || type == "w";
+
+        if (!code) sizes.tables += size;
+        else if (name.find("_kernel<") != std::string::npos) sizes.kernels += size;
+        else if (name.find("using_weak<") != std::string::npos) sizes.dispatch += size;
+        else sizes.other += size;
+    }
+
+    sizes.succeeded = pclose(symbols) == 0;
+    return sizes;
+}
+
+}
+
+int main(int argc, char** argv) {
+    std::string compiler = "c++";
+    std::string nm = "nm";
+    std::string subject = "compile_time_subject.cpp";
+    std::string include = "..";
+    std::string flags = "-Os";
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--compiler") == 0) compiler = argv[i + 1];
+        else if (std::strcmp(argv[i], "--nm") == 0) nm = argv[i + 1];
+        else if (std::strcmp(argv[i], "--subject") == 0) subject = argv[i + 1];
+        else if (std::strcmp(argv[i], "--include") == 0) include = argv[i + 1];
+        else if (std::strcmp(argv[i], "--flags") == 0) flags = argv[i + 1];
+        else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    static const int sizes[] = { 4, 16, 32, 64 };
+    static const char* const modes[] = { "default", "small" };
+
+    const std::string object = "code_size_subject.o";
+    int result = 0;
+
+    for (int alternatives : sizes) {
+        for (const char* mode : modes) {
+            std::vector<std::string> command = { compiler, "-std=c++11", "-I" + include,
+                                                 "-DWEAK_BENCH_ALTERNATIVES=" + std::to_string(alternatives) };
+
+            std::istringstream extra(flags);
+            for (std::string flag; extra >> flag;) {
+                command.push_back(flag);
+            }
+            if (std::strcmp(mode, "small") == 0) {
+                command.push_back("-DWEAK_SMALL_CODE");
+            }
+            command.insert(command.end(), { "-c", subject, "-o", object });
+
+            breakdown measured = { false, 0, 0, 0, 0 };
+            if (run(command)) {
+                measured = measure(nm, object);
+            }
+            std::remove(object.c_str());
+
+            std::printf("{\"benchmark\": \"code_size\", \"alternatives\": %d, \"mode\": \"%s\", \"succeeded\": %s, "
+                        "\"bytes\": %ld, \"kernels\": %ld, \"tables\": %ld, \"dispatch\": %ld, \"other\": %ld}\n",
+                        alternatives, mode, measured.succeeded ? "true" : "false", measured.total(),
+                        measured.kernels, measured.tables, measured.dispatch, measured.other);
+
+            if (!measured.succeeded) {
+                result = 1;
+            }
+        }
+    }
+
+    return result;
+}
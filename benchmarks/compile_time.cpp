@@ -0,0 +1,103 @@
+//
+// Measures how long the compiler takes, and how much memory it peaks at, to build compile_time_subject.cpp for weak
+// types of 4, 16, 32 and 64 alternatives. Prints one JSON object per size.
+//
+// usage: compile_time [--compiler c++] [--subject compile_time_subject.cpp] [--include ..]
+//                     [--max-seconds S] [--max-peak-kb K]
+// Exits with 1 if a build fails or exceeds one of the limits.
+//
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+struct measurement {
+    bool succeeded;
+    double seconds;
+    long peakKb;
+};
+
+measurement build(const std::vector<std::string>& command) {
+    std::vector<char*> argv;
+    for (const std::string& argument : command) {
+        argv.push_back(const_cast<char*>(argument.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    pid_t child = fork();
+    if (child == 0) {
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+
+    int status = 0;
+    struct rusage usage;
+    std::memset(&usage, 0, sizeof(usage));
+
+    if (child < 0 || wait4(child, &status, 0, &usage) < 0) {
+        return { false, 0.0, 0 };
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    // ru_maxrss is in kilobytes on Linux
+    return { WIFEXITED(status) && WEXITSTATUS(status) == 0, elapsed.count(), usage.ru_maxrss };
+}
+
+}
+
+int main(int argc, char** argv) {
+    std::string compiler = "c++";
+    std::string subject = "compile_time_subject.cpp";
+    std::string include = "..";
+    double maxSeconds = 0.0;
+    long maxPeakKb = 0;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--compiler") == 0) compiler = argv[i + 1];
+        else if (std::strcmp(argv[i], "--subject") == 0) subject = argv[i + 1];
+        else if (std::strcmp(argv[i], "--include") == 0) include = argv[i + 1];
+        else if (std::strcmp(argv[i], "--max-seconds") == 0) maxSeconds = std::atof(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--max-peak-kb") == 0) maxPeakKb = std::atol(argv[i + 1]);
+        else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    static const int sizes[] = { 4, 16, 32, 64 };
+
+    int result = 0;
+
+    for (int alternatives : sizes) {
+        measurement measured = build({
+                compiler, "-std=c++11", "-O2", "-I" + include,
+                "-DWEAK_BENCH_ALTERNATIVES=" + std::to_string(alternatives),
+                "-c", subject, "-o", "/dev/null"
+        });
+
+        bool withinLimits = (maxSeconds <= 0.0 || measured.seconds <= maxSeconds) &&
+                            (maxPeakKb <= 0 || measured.peakKb <= maxPeakKb);
+
+        std::printf("{\"benchmark\": \"compile_time\", \"alternatives\": %d, \"succeeded\": %s, "
+                    "\"seconds\": %.3f, \"peak_kb\": %ld}\n",
+                    alternatives, measured.succeeded ? "true" : "false", measured.seconds, measured.peakKb);
+
+        if (!measured.succeeded || !withinLimits) {
+            result = 1;
+        }
+    }
+
+    return result;
+}
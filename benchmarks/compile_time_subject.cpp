@@ -0,0 +1,66 @@
+//
+// The translation unit compile_time builds to measure compile time and memory, for a weak of
+// WEAK_BENCH_ALTERNATIVES alternatives.
+//
+
+#include <cstddef>
+#include "weak.h"
+
+#ifndef WEAK_BENCH_ALTERNATIVES
+#define WEAK_BENCH_ALTERNATIVES 16
+#endif
+
+// distinct alternatives, each combinable with itself and with int
+template <std::size_t I>
+struct alternative {
+    int value;
+};
+
+template <std::size_t I>
+alternative<I> operator+(const alternative<I>& left, const alternative<I>& right) { return { left.value + right.value }; }
+
+template <std::size_t I>
+alternative<I> operator-(const alternative<I>& left, int right) { return { left.value - right }; }
+
+template <std::size_t I>
+bool operator==(const alternative<I>& left, const alternative<I>& right) { return left.value == right.value; }
+
+template <std::size_t I>
+bool operator<(const alternative<I>& left, const alternative<I>& right) { return left.value < right.value; }
+
+template <typename Sequence>
+struct alternatives;
+
+template <std::size_t ... Is>
+struct alternatives<weak_index_sequence<Is...>> {
+    typedef weak<int, double, alternative<Is>...> type;
+};
+
+typedef alternatives<weak_make_index_sequence<WEAK_BENCH_ALTERNATIVES - 2>::type>::type var;
+
+template <typename T>
+struct touch {
+    void operator() (const T&, int& visited) {
+        ++visited;
+    }
+};
+
+int use(const var& a, const var& b) {
+    int visited = 0;
+
+    var c = a + b;
+    c = c - b;
+    c = c * a;
+    c = c / b;
+    c += a;
+    c -= b;
+    c *= a;
+    c /= b;
+
+    visited += (a == b) + (a != b) + (a < b) + (a > b) + (a <= b) + (a >= b);
+    visited += c.isType<alternative<0>>() + c.isType<int>() + c.as<double>().value_or(0);
+
+    c.run<touch>(visited);
+
+    return visited;
+}
@@ -0,0 +1,649 @@
+//
+// Measures the run time cost of weak's operations against std::variant, a hand written tagged union and the raw types.
+// Prints one JSON object per case and subject with the nanoseconds and heap allocations per operation.
+//
+// usage: runtime [--filter substring] [--repetitions 5]
+// std::variant is only measured when built as C++17 or later.
+//
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+#include "weak.h"
+#include "weak_vector.h"
+
+#if __cplusplus >= 201703L
+#include <variant>
+#define WEAK_BENCH_VARIANT 1
+#endif
+
+//=== allocation counting ===//
+
+namespace {
+    std::size_t allocations = 0;
+}
+
+void* operator new(std::size_t size) {
+    ++allocations;
+    if (void* allocated = std::malloc(size == 0 ? 1 : size)) {
+        return allocated;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+// a std::string that weak keeps in a reference counted block, so copies share it
+struct shared_string : std::string {
+    shared_string(const char* chars) : std::string(chars) {}
+};
+
+template <>
+struct weak_is_shared<shared_string> : std::true_type {};
+
+namespace {
+
+//=== harness ===//
+
+// makes the compiler assume value is read and memory changed, so work isn't hoisted out of the loops or removed
+template <typename T>
+void keep(const T& value) {
+#if defined(__GNUC__)
+    asm volatile("" : : "r"(&value) : "memory");
+#else
+    static const volatile void* sink;
+    sink = &value;
+#endif
+}
+
+struct options {
+    const char* filter = "";
+    int repetitions = 5;
+};
+
+options settings;
+
+// runs body(iterations) repetitions times and reports the fastest, body does operations operations per iteration
+template <typename Body>
+void measure(const char* name, const char* subject, std::size_t iterations, std::size_t operations, Body body) {
+    std::string label = std::string(name) + " " + subject;
+    if (label.find(settings.filter) == std::string::npos) {
+        return;
+    }
+
+    // warm up caches and branch predictors
+    body(iterations / 10 + 1);
+
+    double best = 0.0;
+    std::size_t allocated = 0;
+
+    for (int repetition = 0; repetition < settings.repetitions; ++repetition) {
+        std::size_t allocationsBefore = allocations;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        body(iterations);
+
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        allocated = allocations - allocationsBefore;
+
+        if (repetition == 0 || elapsed.count() < best) {
+            best = elapsed.count();
+        }
+    }
+
+    double ops = double(iterations) * double(operations);
+    std::printf("{\"benchmark\": \"runtime\", \"case\": \"%s\", \"subject\": \"%s\", \"ns_per_op\": %.3f, "
+                "\"allocs_per_op\": %.3f}\n", name, subject, best / ops, double(allocated) / ops);
+}
+
+const std::size_t iterations = 1 << 20;
+
+// long enough to need the heap in std::string
+const char* const text = "a string too long for the small string buffer";
+
+//=== subjects ===//
+
+typedef weak<int, double, std::string> weak_subject;
+
+typedef weak<int, double, shared_string> weak_shared_subject;
+
+#ifdef WEAK_BENCH_VARIANT
+// monostate plays the part of weak's invalid state
+typedef std::variant<std::monostate, int, double, std::string> variant_subject;
+#endif
+
+// what a weak would be written as by hand
+class tagged_union {
+public:
+    enum kind_type { none, integer, floating, text };
+
+private:
+    kind_type tag;
+
+    union {
+        int i;
+        double d;
+        std::string s;
+    };
+
+    void destroy() {
+        if (tag == text) {
+            s.~basic_string();
+        }
+        tag = none;
+    }
+
+    void copy(const tagged_union& other) {
+        switch (other.tag) {
+            case integer: i = other.i; break;
+            case floating: d = other.d; break;
+            case text: ::new (&s) std::string(other.s); break;
+            case none: break;
+        }
+        tag = other.tag;
+    }
+
+public:
+    tagged_union() : tag(none) {}
+    tagged_union(int val) : tag(integer), i(val) {}
+    tagged_union(double val) : tag(floating), d(val) {}
+    tagged_union(std::string val) : tag(text), s(std::move(val)) {}
+
+    tagged_union(const tagged_union& other) : tag(none) {
+        copy(other);
+    }
+
+    tagged_union(tagged_union&& other) noexcept : tag(other.tag) {
+        switch (other.tag) {
+            case integer: i = other.i; break;
+            case floating: d = other.d; break;
+            case text: ::new (&s) std::string(std::move(other.s)); break;
+            case none: break;
+        }
+    }
+
+    tagged_union& operator=(const tagged_union& other) {
+        if (this != &other) {
+            destroy();
+            copy(other);
+        }
+        return *this;
+    }
+
+    tagged_union& operator=(tagged_union&& other) noexcept {
+        if (this != &other) {
+            destroy();
+            ::new (this) tagged_union(std::move(other));
+        }
+        return *this;
+    }
+
+    ~tagged_union() {
+        destroy();
+    }
+
+    kind_type kind() const {
+        return tag;
+    }
+
+    int& integerValue() { return i; }
+    const int& integerValue() const { return i; }
+    const double& floatingValue() const { return d; }
+    const std::string& textValue() const { return s; }
+
+    template <typename T>
+    void emplace(T val) {
+        *this = tagged_union(std::move(val));
+    }
+
+    // applies Op to two numbers, invalid for anything else
+    template <typename Op>
+    tagged_union binary(const tagged_union& other) const {
+        if (tag == integer && other.tag == integer) return tagged_union(Op::apply(i, other.i));
+        if (tag == integer && other.tag == floating) return tagged_union(Op::apply(i, other.d));
+        if (tag == floating && other.tag == integer) return tagged_union(Op::apply(d, other.i));
+        if (tag == floating && other.tag == floating) return tagged_union(Op::apply(d, other.d));
+        return tagged_union();
+    }
+
+    // the numeric value as a double, false for other types
+    bool asDouble(double& val) const {
+        switch (tag) {
+            case integer: val = i; return true;
+            case floating: val = d; return true;
+            default: return false;
+        }
+    }
+};
+
+//=== cases ===//
+
+template <typename T, typename ... Ts>
+struct accumulate {
+    void operator() (const T&, std::size_t&) const {}
+};
+
+template <typename ... Ts>
+struct accumulate<int, Ts...> {
+    void operator() (const int& val, std::size_t& sum) const {
+        sum += static_cast<std::size_t>(val);
+    }
+};
+
+template <typename ... Ts>
+struct accumulate<std::string, Ts...> {
+    void operator() (const std::string& val, std::size_t& sum) const {
+        sum += val.size();
+    }
+};
+
+void construction() {
+    measure("construct_int", "weak", iterations, 1, [](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) { weak_subject value(static_cast<int>(i)); keep(value); }
+    });
+    measure("construct_int", "tagged_union", iterations, 1, [](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) { tagged_union value(static_cast<int>(i)); keep(value); }
+    });
+    measure("construct_string", "weak", iterations, 1, [](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) { weak_subject value = std::string(text); keep(value); }
+    });
+    measure("construct_string", "tagged_union", iterations, 1, [](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) { tagged_union value{std::string(text)}; keep(value); }
+    });
+    measure("construct_string", "raw", iterations, 1, [](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) { std::string value(text); keep(value); }
+    });
+#ifdef WEAK_BENCH_VARIANT
+    measure("construct_int", "std_variant", iterations, 1, [](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) { variant_subject value(static_cast<int>(i)); keep(value); }
+    });
+    measure("construct_string", "std_variant", iterations, 1, [](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) { variant_subject value{std::string(text)}; keep(value); }
+    });
+#endif
+}
+
+template <typename Value>
+void copyAndMove(const char* subject, const Value& number, const Value& string) {
+    measure("copy_int", subject, iterations, 1, [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) { Value copy(number); keep(copy); }
+    });
+    measure("copy_string", subject, iterations, 1, [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) { Value copy(string); keep(copy); }
+    });
+    measure("move_string", subject, iterations, 1, [&](std::size_t n) {
+        Value from(string);
+        for (std::size_t i = 0; i < n; ++i) {
+            Value to(std::move(from));
+            keep(to);
+            from = std::move(to);
+        }
+    });
+}
+
+void typeChanges() {
+    // int to double to string and back to int, three changes of type per iteration
+    measure("emplace_change", "weak", iterations, 3, [](std::size_t n) {
+        weak_subject value;
+        for (std::size_t i = 0; i < n; ++i) {
+            value.emplace(int(i)); keep(value);
+            value.emplace(double(i)); keep(value);
+            value.emplace(std::string(text)); keep(value);
+        }
+    });
+    measure("emplace_change", "tagged_union", iterations, 3, [](std::size_t n) {
+        tagged_union value;
+        for (std::size_t i = 0; i < n; ++i) {
+            value.emplace(int(i)); keep(value);
+            value.emplace(double(i)); keep(value);
+            value.emplace(std::string(text)); keep(value);
+        }
+    });
+#ifdef WEAK_BENCH_VARIANT
+    measure("emplace_change", "std_variant", iterations, 3, [](std::size_t n) {
+        variant_subject value;
+        for (std::size_t i = 0; i < n; ++i) {
+            value.emplace<int>(int(i)); keep(value);
+            value.emplace<double>(double(i)); keep(value);
+            value.emplace<std::string>(text); keep(value);
+        }
+    });
+#endif
+}
+
+void dispatch() {
+    weak_subject first(1), last = std::string(text);
+    tagged_union firstUnion(1), lastUnion = tagged_union(std::string(text));
+
+    measure("dispatch_first", "weak", iterations, 1, [&](std::size_t n) {
+        std::size_t sum = 0;
+        for (std::size_t i = 0; i < n; ++i) { keep(first); first.run<accumulate>(sum); }
+        keep(sum);
+    });
+    measure("dispatch_last", "weak", iterations, 1, [&](std::size_t n) {
+        std::size_t sum = 0;
+        for (std::size_t i = 0; i < n; ++i) { keep(last); last.run<accumulate>(sum); }
+        keep(sum);
+    });
+
+    // the same work through a switch over the tag
+    auto visitUnion = [](const tagged_union& value, std::size_t& sum) {
+        switch (value.kind()) {
+            case tagged_union::integer: accumulate<int>()(value.integerValue(), sum); break;
+            case tagged_union::floating: accumulate<double>()(value.floatingValue(), sum); break;
+            case tagged_union::text: accumulate<std::string>()(value.textValue(), sum); break;
+            case tagged_union::none: break;
+        }
+    };
+    measure("dispatch_first", "tagged_union", iterations, 1, [&](std::size_t n) {
+        std::size_t sum = 0;
+        for (std::size_t i = 0; i < n; ++i) { keep(firstUnion); visitUnion(firstUnion, sum); }
+        keep(sum);
+    });
+    measure("dispatch_last", "tagged_union", iterations, 1, [&](std::size_t n) {
+        std::size_t sum = 0;
+        for (std::size_t i = 0; i < n; ++i) { keep(lastUnion); visitUnion(lastUnion, sum); }
+        keep(sum);
+    });
+
+#ifdef WEAK_BENCH_VARIANT
+    variant_subject firstVariant(1), lastVariant{std::string(text)};
+    auto visitVariant = [](const variant_subject& value, std::size_t& sum) {
+        std::visit([&](const auto& val) {
+            using T = typename std::decay<decltype(val)>::type;
+            if constexpr (!std::is_same<T, std::monostate>::value) accumulate<T>()(val, sum);
+        }, value);
+    };
+    measure("dispatch_first", "std_variant", iterations, 1, [&](std::size_t n) {
+        std::size_t sum = 0;
+        for (std::size_t i = 0; i < n; ++i) { keep(firstVariant); visitVariant(firstVariant, sum); }
+        keep(sum);
+    });
+    measure("dispatch_last", "std_variant", iterations, 1, [&](std::size_t n) {
+        std::size_t sum = 0;
+        for (std::size_t i = 0; i < n; ++i) { keep(lastVariant); visitVariant(lastVariant, sum); }
+        keep(sum);
+    });
+#endif
+}
+
+//=== binary operators ===//
+
+#ifdef WEAK_BENCH_VARIANT
+// applies Op when it is defined for the pair of types, monostate otherwise, like weak's operators
+template <typename Op>
+struct variant_binary {
+    template <typename L, typename R>
+    variant_subject operator() (const L& left, const R& right) const {
+        if constexpr (Op::template defined<L, R>::value) {
+            return variant_subject(Op::apply(left, right));
+        }
+        else {
+            return variant_subject();
+        }
+    }
+};
+#endif
+
+// weak's operator for each tag
+template <typename Op> struct weak_operator;
+template <> struct weak_operator<weak_addition> { static weak_subject apply(const weak_subject& l, const weak_subject& r) { return l + r; } };
+template <> struct weak_operator<weak_subtraction> { static weak_subject apply(const weak_subject& l, const weak_subject& r) { return l - r; } };
+template <> struct weak_operator<weak_multiplication> { static weak_subject apply(const weak_subject& l, const weak_subject& r) { return l * r; } };
+template <> struct weak_operator<weak_division> { static weak_subject apply(const weak_subject& l, const weak_subject& r) { return l / r; } };
+template <> struct weak_operator<weak_equal> { static bool apply(const weak_subject& l, const weak_subject& r) { return l == r; } };
+template <> struct weak_operator<weak_not_equal> { static bool apply(const weak_subject& l, const weak_subject& r) { return l != r; } };
+template <> struct weak_operator<weak_less_than> { static bool apply(const weak_subject& l, const weak_subject& r) { return l < r; } };
+template <> struct weak_operator<weak_greater_than> { static bool apply(const weak_subject& l, const weak_subject& r) { return l > r; } };
+template <> struct weak_operator<weak_less_than_equal_to> { static bool apply(const weak_subject& l, const weak_subject& r) { return l <= r; } };
+template <> struct weak_operator<weak_greater_than_equal_to> { static bool apply(const weak_subject& l, const weak_subject& r) { return l >= r; } };
+
+template <typename Op, typename Left, typename Right>
+void binary(const char* name, const char* pair, Left left, Right right) {
+    std::string caseName = std::string(name) + "_" + pair;
+
+    weak_subject weakLeft(left), weakRight(right);
+    measure(caseName.c_str(), "weak", iterations, 1, [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            keep(weakLeft);
+            auto result = weak_operator<Op>::apply(weakLeft, weakRight);
+            keep(result);
+        }
+    });
+
+    tagged_union unionLeft(left), unionRight(right);
+    measure(caseName.c_str(), "tagged_union", iterations, 1, [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            keep(unionLeft);
+            tagged_union result = unionLeft.binary<Op>(unionRight);
+            keep(result);
+        }
+    });
+
+    measure(caseName.c_str(), "raw", iterations, 1, [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            keep(left);
+            auto result = Op::apply(left, right);
+            keep(result);
+        }
+    });
+
+#ifdef WEAK_BENCH_VARIANT
+    variant_subject variantLeft(left), variantRight(right);
+    measure(caseName.c_str(), "std_variant", iterations, 1, [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            keep(variantLeft);
+            variant_subject result = std::visit(variant_binary<Op>(), variantLeft, variantRight);
+            keep(result);
+        }
+    });
+#endif
+}
+
+template <typename Op>
+void binaryPairs(const char* name) {
+    binary<Op>(name, "same", 7, 3);
+    binary<Op>(name, "mixed", 7, 3.5);
+}
+
+void binaries() {
+    binaryPairs<weak_addition>("add");
+    binaryPairs<weak_subtraction>("subtract");
+    binaryPairs<weak_multiplication>("multiply");
+    binaryPairs<weak_division>("divide");
+    binaryPairs<weak_equal>("equal");
+    binaryPairs<weak_not_equal>("not_equal");
+    binaryPairs<weak_less_than>("less_than");
+    binaryPairs<weak_greater_than>("greater_than");
+    binaryPairs<weak_less_than_equal_to>("less_than_equal_to");
+    binaryPairs<weak_greater_than_equal_to>("greater_than_equal_to");
+}
+
+//=== retrieval ===//
+
+void retrieval() {
+    weak_subject number(42);
+    measure("retrieve", "weak", iterations, 1, [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) { keep(number); simple_optional<int> got = number.retrieve<int>(); keep(got); }
+    });
+    measure("as", "weak", iterations, 1, [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) { keep(number); simple_optional<double> got = number.as<double>(); keep(got); }
+    });
+
+    tagged_union numberUnion(42);
+    measure("retrieve", "tagged_union", iterations, 1, [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            keep(numberUnion);
+            int got = numberUnion.kind() == tagged_union::integer ? numberUnion.integerValue() : 0;
+            keep(got);
+        }
+    });
+    measure("as", "tagged_union", iterations, 1, [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) { keep(numberUnion); double got = 0; numberUnion.asDouble(got); keep(got); }
+    });
+
+#ifdef WEAK_BENCH_VARIANT
+    variant_subject numberVariant(42);
+    measure("retrieve", "std_variant", iterations, 1, [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            keep(numberVariant);
+            const int* got = std::get_if<int>(&numberVariant);
+            int copy = got != nullptr ? *got : 0;
+            keep(copy);
+        }
+    });
+    measure("as", "std_variant", iterations, 1, [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            keep(numberVariant);
+            double got = std::visit([](const auto& val) -> double {
+                if constexpr (std::is_convertible<decltype(val), double>::value) return val;
+                else return 0.0;
+            }, numberVariant);
+            keep(got);
+        }
+    });
+#endif
+}
+
+//=== containers ===//
+
+void scans() {
+    const std::size_t count = 4096;
+    const std::size_t passes = iterations / count;
+
+    // mostly ints, with a double and a string every few elements
+    std::vector<weak_subject> weaks;
+    weak_vector<int, double, std::string> columns;
+    std::vector<tagged_union> unions;
+    std::vector<int> raws;
+
+    for (std::size_t i = 0; i < count; ++i) {
+        if (i % 8 == 3) {
+            weaks.push_back(weak_subject(double(i)));
+            columns.emplace_back(double(i));
+            unions.push_back(tagged_union(double(i)));
+        }
+        else if (i % 8 == 7) {
+            weaks.push_back(weak_subject(std::string("s")));
+            columns.emplace_back(std::string("s"));
+            unions.push_back(tagged_union(std::string("s")));
+        }
+        else {
+            weaks.push_back(weak_subject(int(i)));
+            columns.emplace_back(int(i));
+            unions.push_back(tagged_union(int(i)));
+            raws.push_back(int(i));
+        }
+    }
+
+    measure("scan_sum_ints", "weak", passes, count, [&](std::size_t n) {
+        std::size_t sum = 0;
+        for (std::size_t pass = 0; pass < n; ++pass) {
+            for (const weak_subject& value : weaks) {
+                if (const int* i = value.get_if<int>()) sum += static_cast<std::size_t>(*i);
+            }
+            keep(sum);
+        }
+    });
+    measure("scan_run", "weak", passes, count, [&](std::size_t n) {
+        std::size_t sum = 0;
+        for (std::size_t pass = 0; pass < n; ++pass) {
+            for (const weak_subject& value : weaks) value.run<accumulate>(sum);
+            keep(sum);
+        }
+    });
+    measure("scan_sum_ints", "weak_vector", passes, count, [&](std::size_t n) {
+        std::size_t sum = 0;
+        for (std::size_t pass = 0; pass < n; ++pass) {
+            for (int i : columns.column<int>()) sum += static_cast<std::size_t>(i);
+            keep(sum);
+        }
+    });
+    measure("scan_sum_ints", "tagged_union", passes, count, [&](std::size_t n) {
+        std::size_t sum = 0;
+        for (std::size_t pass = 0; pass < n; ++pass) {
+            for (const tagged_union& value : unions) {
+                if (value.kind() == tagged_union::integer) sum += static_cast<std::size_t>(value.integerValue());
+            }
+            keep(sum);
+        }
+    });
+    measure("scan_sum_ints", "raw", passes, count, [&](std::size_t n) {
+        std::size_t sum = 0;
+        for (std::size_t pass = 0; pass < n; ++pass) {
+            for (int i : raws) sum += static_cast<std::size_t>(i);
+            keep(sum);
+        }
+    });
+
+#ifdef WEAK_BENCH_VARIANT
+    std::vector<variant_subject> variants(weaks.size());
+    for (std::size_t i = 0; i < count; ++i) {
+        if (const int* v = weaks[i].get_if<int>()) variants[i] = *v;
+        else if (const double* d = weaks[i].get_if<double>()) variants[i] = *d;
+        else variants[i] = std::string("s");
+    }
+
+    measure("scan_sum_ints", "std_variant", passes, count, [&](std::size_t n) {
+        std::size_t sum = 0;
+        for (std::size_t pass = 0; pass < n; ++pass) {
+            for (const variant_subject& value : variants) {
+                if (const int* i = std::get_if<int>(&value)) sum += static_cast<std::size_t>(*i);
+            }
+            keep(sum);
+        }
+    });
+    measure("scan_run", "std_variant", passes, count, [&](std::size_t n) {
+        std::size_t sum = 0;
+        for (std::size_t pass = 0; pass < n; ++pass) {
+            for (const variant_subject& value : variants) {
+                std::visit([&](const auto& val) {
+                    using T = typename std::decay<decltype(val)>::type;
+                    if constexpr (!std::is_same<T, std::monostate>::value) accumulate<T>()(val, sum);
+                }, value);
+            }
+            keep(sum);
+        }
+    });
+#endif
+}
+
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--filter") == 0) settings.filter = argv[i + 1];
+        else if (std::strcmp(argv[i], "--repetitions") == 0) settings.repetitions = std::atoi(argv[i + 1]);
+        else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    construction();
+    copyAndMove("weak", weak_subject(42), weak_subject(std::string(text)));
+    copyAndMove("weak_shared", weak_shared_subject(42), weak_shared_subject(shared_string(text)));
+    copyAndMove("tagged_union", tagged_union(42), tagged_union(std::string(text)));
+#ifdef WEAK_BENCH_VARIANT
+    copyAndMove("std_variant", variant_subject(42), variant_subject(std::string(text)));
+#endif
+    typeChanges();
+    dispatch();
+    binaries();
+    retrieval();
+    scans();
+
+    return 0;
+}
@@ -0,0 +1,235 @@
+//
+// An 8 byte, allocation free weak<Types...> for numeric and pointer types, using NaN boxing.
+//
+
+#ifndef WEAK_TYPES_BOXED_WEAK_H
+#define WEAK_TYPES_BOXED_WEAK_H
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include "weak.h"
+
+//=== boxing ===//
+
+// How an alternative of boxed_weak is packed into 64 bits. A specialization provides
+//     static std::uint64_t encode(T)     the bits to store
+//     static T decode(std::uint64_t)     the value back from them
+// double is stored as itself, every other type in the 48 bit payload of a negative quiet NaN, so its encoding must fit
+// in the low 48 bits. Specialize weak_box to store other types, such as strong_typedefs of the types below.
+template <typename T, typename enable = void>
+struct weak_box {
+    static constexpr bool boxable = false;
+};
+
+// doubles are stored as they are, NaNs all become the one positive quiet NaN so that they never look boxed
+template <>
+struct weak_box<double> {
+    static constexpr bool boxable = true;
+
+    static std::uint64_t encode(double val) {
+        std::uint64_t bits = 0x7FF8000000000000u;
+
+        if (val == val) {
+            std::memcpy(&bits, &val, sizeof(double));
+        }
+
+        return bits;
+    }
+
+    static double decode(std::uint64_t bits) {
+        double val;
+        std::memcpy(&val, &bits, sizeof(double));
+        return val;
+    }
+};
+
+// integers, enums and floats of up to 32 bits are copied bit for bit into the payload
+template <typename T>
+struct weak_box<T, typename std::enable_if<(std::is_arithmetic<T>::value || std::is_enum<T>::value) &&
+                                           sizeof(T) <= sizeof(std::uint32_t)>::type> {
+    static constexpr bool boxable = true;
+
+    static std::uint64_t encode(T val) {
+        std::uint32_t bits = 0u;
+        std::memcpy(&bits, &val, sizeof(T));
+        return bits;
+    }
+
+    static T decode(std::uint64_t bits) {
+        std::uint32_t payload = static_cast<std::uint32_t>(bits);
+        T val;
+        std::memcpy(&val, &payload, sizeof(T));
+        return val;
+    }
+};
+
+// Pointers must fit in 48 bits, which user space addresses do on x86-64 with 4 level paging and on AArch64 without
+// tagged pointers. They don't with 5 level paging, or on Android, whose heap pointers carry a tag in their top byte.
+// encode asserts that no bits are lost.
+template <typename T>
+struct weak_box<T*> {
+    static constexpr bool boxable = true;
+
+    static std::uint64_t encode(T* val) {
+        std::uint64_t bits = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(val));
+        assert((bits >> 48) == 0u && "boxed_weak can't store a pointer above 48 bits");
+        return bits;
+    }
+
+    static T* decode(std::uint64_t bits) {
+        return reinterpret_cast<T*>(static_cast<std::uintptr_t>(bits & 0x0000FFFFFFFFFFFFu));
+    }
+};
+
+//=== boxed_weak ===//
+
+// A weak<Types...> that is a single std::uint64_t. A double is stored directly, any other alternative as a negative
+// quiet NaN whose bits 48 to 50 hold the type index and whose low 48 bits hold weak_box<T>::encode(value). It is
+// trivially copyable, never allocates and holds up to 7 types, each of which must be boxable.
+//
+// Nothing is stored as a T, so there is no get_if and value<T>() returns a copy. ref<T>() returns a proxy that converts
+// to T& and writes back when it is destroyed at the end of the full expression, which is what run and weak_visit pass to
+// functors that take T&. Don't keep the T& past that: int& r = b.ref<int>(); leaves r dangling. The boxed_weak must
+// hold a T when either is called.
+template <typename ... Types>
+class boxed_weak : public weak_interface<boxed_weak<Types...>, Types...> {
+
+    friend class weak_interface<boxed_weak<Types...>, Types...>;
+
+    static_assert(sizeof...(Types) <= 7, "boxed_weak holds at most 7 types.");
+    static_assert(static_all<weak_box<Types>::boxable...>::value,
+                  "Every type of a boxed_weak must be a double, a pointer or at most 32 bits, or specialize weak_box.");
+
+    // negative quiet NaNs, never produced by weak_box<double>
+    static constexpr std::uint64_t boxed = 0xFFF8000000000000u;
+
+    static constexpr std::size_t double_index = get_type_index_impl<double, Types...>::value;
+
+    std::uint64_t bits;
+
+    template <typename T>
+    using alternative = typename std::enable_if<get_type_index_impl<typename std::decay<T>::type, Types...>::value != 0u>::type;
+
+    /// position of the current type in Types..., starting at 1. 0 when invalid.
+    std::size_t index() const noexcept {
+        return (bits & boxed) == boxed ? static_cast<std::size_t>((bits >> 48) & 7u) : double_index;
+    }
+
+    template <typename T>
+    static std::uint64_t encode(T val, std::true_type /* is double */) {
+        return weak_box<T>::encode(val);
+    }
+
+    template <typename T>
+    static std::uint64_t encode(T val, std::false_type) {
+        return boxed | (std::uint64_t(get_type_index_impl<T, Types...>::value) << 48) |
+               (weak_box<T>::encode(val) & 0x0000FFFFFFFFFFFFu);
+    }
+
+public:
+
+    /// writes the value back into the boxed_weak it was read from when it goes out of scope, unless the boxed_weak was
+    /// changed some other way in the meantime, which wins
+    template <typename T>
+    class reference {
+
+        boxed_weak<Types...>* owner;
+
+        // the bits val was read from
+        std::uint64_t read;
+
+        T val;
+
+    public:
+        explicit reference(boxed_weak<Types...>& owner)
+                : owner(&owner), read(owner.bits), val(weak_box<T>::decode(owner.bits)) {}
+
+        reference(reference&& other) noexcept : owner(other.owner), read(other.read), val(other.val) {
+            other.owner = nullptr;
+        }
+
+        reference(const reference&) = delete;
+
+        ~reference() {
+            if (owner != nullptr && owner -> bits == read) {
+                owner -> emplace(val);
+            }
+        }
+
+        reference& operator=(const T& assigned) {
+            val = assigned;
+            return *this;
+        }
+
+        operator T&() {
+            return val;
+        }
+    };
+
+    constexpr boxed_weak() noexcept : bits(boxed) {}
+
+    template <typename T, typename = alternative<T>>
+    boxed_weak(T val) : boxed_weak() {
+        emplace(val);
+    }
+
+    template <typename T, typename = alternative<T>>
+    boxed_weak<Types...>& operator=(const T& val) {
+        emplace(val);
+
+        return *this;
+    }
+
+    template <typename T>
+    void emplace(T val) {
+        using t = typename std::decay<T>::type;
+        static_assert(get_type_index_impl<t, Types...>::value != 0u, "Cannot store with non-weak type.");
+
+        bits = encode<t>(val, std::is_same<t, double>());
+    }
+
+    /// a proxy to change the T in place, valid until the end of the full expression that calls this
+    template <typename T>
+    reference<T> ref() {
+        assert(this -> template check<T>() && "ref<T>() of a boxed_weak that doesn't hold a T");
+        return reference<T>(*this);
+    }
+
+    /// a copy of the T, on const and non const boxed_weak values alike
+    template <typename T>
+    T value() const {
+        assert(this -> template check<T>() && "value<T>() of a boxed_weak that doesn't hold a T");
+        return weak_box<T>::decode(bits);
+    }
+
+private:
+
+    typedef typename std::aligned_storage<static_max<sizeof(Types)...>::value,
+            static_max<alignof(Types)...>::value>::type scratch;
+
+    template <typename T>
+    static void decodeInto(std::uint64_t bits, scratch* into) {
+        ::new (static_cast<void*>(into)) T(weak_box<T>::decode(bits));
+    }
+
+    static void decodeNone(std::uint64_t, scratch*) {}
+
+    /// decodes both values and runs Op on them with one indexed call, leaves result untouched if Op is not defined
+    template <typename Op, typename Result>
+    void binary(const boxed_weak<Types...>& other, Result* result) const {
+        // slot 0 is the invalid type
+        static void (* const decoders[])(std::uint64_t, scratch*) = { &decodeNone, &decodeInto<Types>... };
+
+        std::size_t left = index();
+        std::size_t right = other.index();
+
+        scratch leftValue, rightValue;
+        decoders[left](bits, &leftValue);
+        decoders[right](other.bits, &rightValue);
+
+        weak_binary_apply<Op, Result, Types...>(left, right, &leftValue, &rightValue, result);
+    }
+};
+
+#endif //WEAK_TYPES_BOXED_WEAK_H
@@ -78,5 +78,33 @@ template <class T, class U> struct has_less_than_equal_to_impl<T, U, decltype(st
 
 template <class T, class U> struct has_less_than_equal_to : has_less_than_equal_to_impl<T, U, void> {};
 
+template <class T, class U, class>
+struct has_addition_assignment_impl : std::false_type {};
+
+template <class T, class U> struct has_addition_assignment_impl<T, U, decltype(std::declval<T&>() += std::declval<U>(), void())> : std::true_type {};
+
+template <class T, class U> struct has_addition_assignment : has_addition_assignment_impl<T, U, void> {};
+
+template <class T, class U, class>
+struct has_subtraction_assignment_impl : std::false_type {};
+
+template <class T, class U> struct has_subtraction_assignment_impl<T, U, decltype(std::declval<T&>() -= std::declval<U>(), void())> : std::true_type {};
+
+template <class T, class U> struct has_subtraction_assignment : has_subtraction_assignment_impl<T, U, void> {};
+
+template <class T, class U, class>
+struct has_multiplication_assignment_impl : std::false_type {};
+
+template <class T, class U> struct has_multiplication_assignment_impl<T, U, decltype(std::declval<T&>() *= std::declval<U>(), void())> : std::true_type {};
+
+template <class T, class U> struct has_multiplication_assignment : has_multiplication_assignment_impl<T, U, void> {};
+
+template <class T, class U, class>
+struct has_division_assignment_impl : std::false_type {};
+
+template <class T, class U> struct has_division_assignment_impl<T, U, decltype(std::declval<T&>() /= std::declval<U>(), void())> : std::true_type {};
+
+template <class T, class U> struct has_division_assignment : has_division_assignment_impl<T, U, void> {};
+
 
 #endif //WEAK_TYPES_HAS_OPERATOR_H
@@ -0,0 +1,226 @@
+//
+// A weak<Types...> for literal types that can be built and combined in constant expressions.
+//
+
+#ifndef WEAK_TYPES_LITERAL_WEAK_H
+#define WEAK_TYPES_LITERAL_WEAK_H
+
+#include "weak.h"
+
+//=== weak_union ===//
+
+// A union of Types... with a constexpr constructor for each of them. Only the member that was constructed may be read.
+template <typename ... Types>
+union weak_union;
+
+template <>
+union weak_union<> {
+    char none;
+
+    constexpr weak_union() : none() {}
+};
+
+template <typename Head, typename ... Tail>
+union weak_union<Head, Tail...> {
+    Head head;
+    weak_union<Tail...> tail;
+
+    constexpr weak_union() : tail() {}
+
+    constexpr weak_union(weak_type<Head>, const Head& val) : head(val) {}
+
+    template <typename T>
+    constexpr weak_union(weak_type<T> type, const T& val) : tail(type, val) {}
+
+    constexpr const Head& get(weak_type<Head>) const {
+        return head;
+    }
+
+    template <typename T>
+    constexpr const T& get(weak_type<T> type) const {
+        return tail.get(type);
+    }
+
+    Head& get(weak_type<Head>) {
+        return head;
+    }
+
+    template <typename T>
+    T& get(weak_type<T> type) {
+        return tail.get(type);
+    }
+};
+
+//=== literal_weak ===//
+
+// A weak<Types...> whose construction, isValid, isType, value and operators are constexpr, so that constants and tables
+// of them are evaluated by the compiler and placed in read only memory. Every type must be trivially destructible and
+// usable in constant expressions, such as arithmetic types, enums and strong_typedefs of them.
+// run, retrieve and as work at run time, and a literal_weak converts to the weak<Types...> holding the same value.
+template <typename ... Types>
+class literal_weak : public weak_interface<literal_weak<Types...>, Types...> {
+
+    friend class weak_interface<literal_weak<Types...>, Types...>;
+
+    static_assert(static_all<std::is_trivially_destructible<Types>::value...>::value,
+                  "literal_weak can only hold trivially destructible types.");
+
+    typedef typename smallest_unsigned<sizeof...(Types)>::type tag_type;
+
+    tag_type current_type;
+
+    weak_union<Types...> values;
+
+    template <typename T>
+    using alternative = typename std::enable_if<get_type_index_impl<typename std::decay<T>::type, Types...>::value != 0u>::type;
+
+    /// position of the current type in Types..., starting at 1. 0 when invalid.
+    constexpr std::size_t index() const noexcept {
+        return current_type;
+    }
+
+    // the result of Op on a T and a V, or an empty Result if Op is not defined for them
+    template <typename Op, typename Result, typename T, typename V, typename enable = void>
+    struct kernel {
+        static constexpr Result apply(const T&, const V&) {
+            return Result();
+        }
+    };
+
+    template <typename Op, typename Result, typename T, typename V>
+    struct kernel<Op, Result, T, V, typename std::enable_if<Op::template defined<T, V>::value>::type> {
+        static constexpr Result apply(const T& val, const V& val1) {
+            return Result(Op::apply(val, val1));
+        }
+    };
+
+    // a constant expression can't index a table, so the types are found by recursing over Types... instead
+    template <typename Op, typename Result, typename T>
+    static constexpr Result applyRight(const T&, const literal_weak<Types...>&, weak_types<>) {
+        return Result();
+    }
+
+    template <typename Op, typename Result, typename T, typename V, typename ... Vs>
+    static constexpr Result applyRight(const T& val, const literal_weak<Types...>& other, weak_types<V, Vs...>) {
+        return other.index() == get_type_index_impl<V, Types...>::value ?
+               kernel<Op, Result, T, V>::apply(val, other.values.get(weak_type<V>{})) :
+               applyRight<Op, Result>(val, other, weak_types<Vs...>{});
+    }
+
+    template <typename Op, typename Result>
+    constexpr Result applyLeft(const literal_weak<Types...>&, weak_types<>) const {
+        return Result();
+    }
+
+    template <typename Op, typename Result, typename T, typename ... Ts>
+    constexpr Result applyLeft(const literal_weak<Types...>& other, weak_types<T, Ts...>) const {
+        return index() == get_type_index_impl<T, Types...>::value ?
+               applyRight<Op, Result>(values.get(weak_type<T>{}), other, weak_types<Types...>{}) :
+               applyLeft<Op, Result>(other, weak_types<Ts...>{});
+    }
+
+    /// runs Op on this and other, an invalid literal_weak or false if Op is not defined for the types
+    template <typename Op, typename Result>
+    constexpr Result binary(const literal_weak<Types...>& other) const {
+        return applyLeft<Op, Result>(other, weak_types<Types...>{});
+    }
+
+    template <typename Op>
+    void compound(const literal_weak<Types...>& other) {
+        *this = binary<Op, literal_weak<Types...>>(other);
+    }
+
+    template <typename T>
+    struct toWeak {
+        void operator() (const T& val, weak<Types...>& converted) const {
+            converted.emplace(val);
+        }
+    };
+
+public:
+
+    constexpr literal_weak() noexcept : current_type(0u), values() {}
+
+    template <typename T, typename = alternative<T>>
+    constexpr literal_weak(const T& val) noexcept
+            : current_type(static_cast<tag_type>(get_type_index_impl<T, Types...>::value)), values(weak_type<T>{}, val) {}
+
+    constexpr bool isValid() const {
+        return current_type != 0u;
+    }
+
+    template <typename T>
+    constexpr bool isType() const {
+        return get_type_index_impl<T, Types...>::value != 0u && current_type == get_type_index_impl<T, Types...>::value;
+    }
+
+    template <typename T>
+    constexpr const T& value() const & {
+        return values.get(weak_type<T>{});
+    }
+
+    // only for lvalues, so that the results of the operators read through the constexpr overload
+    template <typename T>
+    T& value() & {
+        return values.get(weak_type<T>{});
+    }
+
+    template <typename T>
+    void emplace(T val) {
+        using t = typename std::decay<T>::type;
+        static_assert(get_type_index_impl<t, Types...>::value != 0u, "Cannot store with non-weak type.");
+
+        *this = literal_weak<Types...>(val);
+    }
+
+    operator weak<Types...>() const {
+        weak<Types...> converted;
+        this -> template run<toWeak>(converted);
+        return converted;
+    }
+
+    ///// Arithmetic Operators /////
+
+    constexpr literal_weak<Types...> operator+ (const literal_weak<Types...>& other) const {
+        return binary<weak_addition, literal_weak<Types...>>(other);
+    }
+
+    constexpr literal_weak<Types...> operator- (const literal_weak<Types...>& other) const {
+        return binary<weak_subtraction, literal_weak<Types...>>(other);
+    }
+
+    constexpr literal_weak<Types...> operator* (const literal_weak<Types...>& other) const {
+        return binary<weak_multiplication, literal_weak<Types...>>(other);
+    }
+
+    constexpr literal_weak<Types...> operator/ (const literal_weak<Types...>& other) const {
+        return binary<weak_division, literal_weak<Types...>>(other);
+    }
+
+    // comparison operators
+    constexpr bool operator==(const literal_weak<Types...>& other) const {
+        return binary<weak_equal, bool>(other);
+    }
+
+    constexpr bool operator !=(const literal_weak<Types...>& other) const {
+        return binary<weak_not_equal, bool>(other);
+    }
+
+    constexpr bool operator < (const literal_weak<Types...>& other) const {
+        return binary<weak_less_than, bool>(other);
+    }
+
+    constexpr bool operator > (const literal_weak<Types...>& other) const {
+        return binary<weak_greater_than, bool>(other);
+    }
+
+    constexpr bool operator <= (const literal_weak<Types...>& other) const {
+        return binary<weak_less_than_equal_to, bool>(other);
+    }
+
+    constexpr bool operator >= (const literal_weak<Types...>& other) const {
+        return binary<weak_greater_than_equal_to, bool>(other);
+    }
+};
+
+#endif //WEAK_TYPES_LITERAL_WEAK_H
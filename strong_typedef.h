@@ -11,16 +11,16 @@ template <class Tag, typename T>
 class strong_typedef
 {
 public:
-    strong_typedef() : value_()
+    constexpr strong_typedef() : value_()
     {
     }
 
-    explicit strong_typedef(const T& value) : value_(value)
+    explicit constexpr strong_typedef(const T& value) : value_(value)
     {
     }
 
-    explicit strong_typedef(T&& value) noexcept(std::is_nothrow_move_constructible<T>::value)
-            : value_(std::move(value))
+    explicit constexpr strong_typedef(T&& value) noexcept(std::is_nothrow_move_constructible<T>::value)
+            : value_(static_cast<T&&>(value))
     {
     }
 
@@ -29,7 +29,7 @@ public:
         return value_;
     }
 
-    explicit operator const T&() const noexcept
+    explicit constexpr operator const T&() const noexcept
     {
         return value_;
     }
@@ -54,7 +54,7 @@ using underlying_type = decltype(underlying_type_impl(std::declval<T>()));
 template <class StrongTypedef>
 struct comparison
 {
-    friend bool operator==(const StrongTypedef& lhs, const StrongTypedef& rhs)
+    friend constexpr bool operator==(const StrongTypedef& lhs, const StrongTypedef& rhs)
     {
         using type = underlying_type<StrongTypedef>;
         return static_cast<const type&>(lhs) == static_cast<const type&>(rhs);
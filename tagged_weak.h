@@ -0,0 +1,208 @@
+//
+// A weak<Types...> the size of a single pointer, with the type tag kept in the low bits of the pointer to its value.
+//
+
+#ifndef WEAK_TYPES_TAGGED_WEAK_H
+#define WEAK_TYPES_TAGGED_WEAK_H
+
+#include <cstddef>
+#include <cstdint>
+#include "weak.h"
+
+// Every value is allocated out of line through weak_allocator<T>, in a block aligned to at least the number of tags, so
+// the low bits of its address are always zero and hold the type index instead. A tagged_weak is one std::uintptr_t,
+// it trades an allocation per value for being cheap to store in bulk and to move around. Zero bits are the invalid type.
+template <typename ... Types>
+class tagged_weak : public weak_interface<tagged_weak<Types...>, Types...> {
+
+    friend class weak_interface<tagged_weak<Types...>, Types...>;
+
+    // number of bits needed to tell Count values apart
+    static constexpr std::size_t bitsFor(std::size_t count) {
+        return count <= 1 ? 0 : 1 + bitsFor((count + 1) / 2);
+    }
+
+    // slot 0 is the invalid type
+    static constexpr std::size_t tag_bits = bitsFor(sizeof...(Types) + 1);
+
+    static constexpr std::uintptr_t tag_mask = (std::uintptr_t(1) << tag_bits) - 1;
+
+    static_assert((std::size_t(1) << tag_bits) <= alignof(std::max_align_t),
+                  "Too many types to keep the type index in the low bits of a pointer.");
+
+    template <typename T>
+    struct payload {
+        typedef typename std::aligned_storage<sizeof(T), static_max<alignof(T), tag_mask + 1>::value>::type block;
+
+        typedef typename std::allocator_traits<typename weak_allocator<T>::type>::template rebind_alloc<block> allocator_type;
+        typedef std::allocator_traits<allocator_type> allocator_traits;
+
+        template <typename ... Args>
+        static T* construct(Args&&... args) {
+            allocator_type allocator;
+
+            // gives the memory back if the constructor throws
+            struct guard {
+                allocator_type& allocator;
+                block* ptr;
+
+                ~guard() {
+                    if (ptr != nullptr) {
+                        allocator_traits::deallocate(allocator, ptr, 1);
+                    }
+                }
+            } allocated = { allocator, allocator_traits::allocate(allocator, 1) };
+
+            T* constructed = ::new (static_cast<void*>(allocated.ptr)) T(std::forward<Args>(args)...);
+            allocated.ptr = nullptr;
+
+            return constructed;
+        }
+
+        static void destroy(T* ptr) {
+            allocator_type allocator;
+
+            ptr -> ~T();
+            allocator_traits::deallocate(allocator, reinterpret_cast<block*>(ptr), 1);
+        }
+    };
+
+    std::uintptr_t bits;
+
+    template <typename T>
+    using alternative = typename std::enable_if<get_type_index_impl<typename std::decay<T>::type, Types...>::value != 0u>::type;
+
+    /// position of the current type in Types..., starting at 1. 0 when invalid.
+    std::size_t index() const noexcept {
+        return static_cast<std::size_t>(bits & tag_mask);
+    }
+
+    /// address of the stored value
+    const void* address() const noexcept {
+        return reinterpret_cast<const void*>(bits & ~tag_mask);
+    }
+
+public:
+
+    tagged_weak() noexcept : bits(0u) {}
+
+    template <typename T, typename = alternative<T>>
+    tagged_weak(T val) : tagged_weak() {
+        emplace(std::move(val));
+    }
+
+    ~tagged_weak() {
+        reset();
+    }
+
+    tagged_weak(const tagged_weak<Types...>& other) : tagged_weak() {
+        other.template run<copy>(this);
+    }
+
+    /// takes over the value of other and leaves other invalid, never allocates
+    tagged_weak(tagged_weak<Types...>&& other) noexcept : bits(other.bits) {
+        other.bits = 0u;
+    }
+
+    tagged_weak<Types...>& operator=(tagged_weak<Types...>&& other) noexcept {
+        if (this == &other) {
+            return *this;
+        }
+
+        reset();
+        bits = other.bits;
+        other.bits = 0u;
+
+        return *this;
+    }
+
+    tagged_weak<Types...>& operator=(const tagged_weak<Types...>& other) {
+        if (this == &other) {
+            return *this;
+        }
+
+        reset();
+        other.template run<copy>(this);
+
+        return *this;
+    }
+
+    template <typename T, typename = alternative<T>>
+    tagged_weak<Types...>& operator=(const T& val) {
+        emplace(val);
+
+        return *this;
+    }
+
+    template <typename T>
+    void emplace(T val) {
+        using t = typename std::decay<T>::type;
+        static_assert(get_type_index_impl<t, Types...>::value != 0u, "Cannot store with non-weak type.");
+
+        // construct first, so the old value is kept if the allocation or the constructor throws
+        t* constructed = payload<t>::construct(std::move(val));
+
+        reset();
+        bits = reinterpret_cast<std::uintptr_t>(constructed) | get_type_index_impl<t, Types...>::value;
+    }
+
+    /// pointer to the stored value if it is a T, nullptr otherwise
+    template <typename T>
+    T* get_if() noexcept {
+        return this -> template check<T>() ? &value<T>() : nullptr;
+    }
+
+    template <typename T>
+    const T* get_if() const noexcept {
+        return this -> template check<T>() ? &value<T>() : nullptr;
+    }
+
+    template <typename T>
+    T& value() {
+        return *static_cast<T*>(const_cast<void*>(address()));
+    }
+
+    template <typename T>
+    const T& value() const {
+        return *static_cast<const T*>(address());
+    }
+
+private:
+
+    /// destroys the stored value and leaves the tagged_weak invalid
+    void reset() {
+        this -> template run<destroy>();
+        bits = 0u;
+    }
+
+    template <typename T>
+    struct destroy {
+        void operator() (T& val) {
+            payload<T>::destroy(&val);
+        }
+    };
+
+    template <typename T>
+    struct copy {
+        void operator() (const T& val, tagged_weak<Types...>* thisWeak) const {
+            thisWeak -> emplace(val);
+        }
+    };
+
+    /// runs Op on this and other with one indexed call, leaves result untouched if Op is not defined for the types
+    template <typename Op, typename Result>
+    void binary(const tagged_weak<Types...>& other, Result* result) const {
+        weak_binary_apply<Op, Result, Types...>(index(), other.index(), address(), other.address(), result);
+    }
+
+#ifndef WEAK_SMALL_CODE
+    /// this = this Op other, in place when the result has the current type
+    template <typename Op>
+    void compound(const tagged_weak<Types...>& other) {
+        weak_compound_table<Op, tagged_weak<Types...>, Types...>::lookup(index(), other.index())(
+                const_cast<void*>(address()), other.address(), this);
+    }
+#endif
+};
+
+#endif //WEAK_TYPES_TAGGED_WEAK_H
@@ -0,0 +1,137 @@
+//
+// weak_pool_allocator's reuse of blocks, its lists on other threads, and weak values freed after the lists are gone.
+//
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include "weak.h"
+#include "weak_allocator.h"
+#include "check.h"
+
+namespace {
+
+// whether to count calls to the global allocator, and the counts
+bool counting = false;
+int allocations = 0;
+int deallocations = 0;
+
+struct pooled {
+    std::int64_t values[6];
+};
+
+}
+
+void* operator new(std::size_t size) {
+    allocations += counting;
+    if (void* allocated = std::malloc(size == 0 ? 1 : size)) {
+        return allocated;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* allocated) noexcept {
+    deallocations += counting && allocated != nullptr;
+    std::free(allocated);
+}
+
+void operator delete(void* allocated, std::size_t) noexcept {
+    ::operator delete(allocated);
+}
+
+template <>
+struct weak_is_inline<pooled> : std::false_type {};
+
+template <>
+struct weak_allocator<pooled> {
+    typedef weak_pool_allocator<pooled> type;
+};
+
+namespace {
+
+typedef weak<int, pooled> var;
+
+// destroyed after main returns, and so after the main thread's free lists. Every block it frees, including the one it
+// held, must go back to the global allocator rather than to a list that is gone.
+struct outliving {
+    var held;
+
+    ~outliving() {
+        counting = true;
+        {
+            held = pooled{};
+            var copy = held;
+            held = 1;
+        }
+        counting = false;
+
+        if (deallocations != allocations + 1) {
+            std::fprintf(stderr, "weak_pool_allocator: %d of %d blocks freed after exit were kept\n",
+                         allocations + 1 - deallocations, allocations + 1);
+            std::_Exit(1);
+        }
+    }
+};
+
+outliving global;
+
+void testReuse() {
+    weak_pool_allocator<pooled> allocator;
+    pooled* first = allocator.allocate(1);
+    allocator.deallocate(first, 1);
+
+    pooled* second = allocator.allocate(1);
+    CHECK(second == first);
+    allocator.deallocate(second, 1);
+
+    // types whose blocks round up to the same size share the list
+    weak_pool_allocator<char[40]> similar;
+    char (*shared)[40] = similar.allocate(1);
+    CHECK(static_cast<void*>(shared) == static_cast<void*>(first));
+    similar.deallocate(shared, 1);
+
+    // arrays bypass it
+    pooled* many = allocator.allocate(3);
+    allocator.deallocate(many, 3);
+
+    weak_pool_allocator<pooled>::release();
+    weak_pool_allocator<pooled>::release();
+}
+
+void testWeak() {
+    var value = pooled{ { 1, 2, 3, 4, 5, 6 } };
+    var copy = value;
+    CHECK(copy.isType<pooled>() && copy.value<pooled>().values[5] == 6);
+
+    copy = 2;
+    value = copy;
+    CHECK(value.isType<int>() && value.value<int>() == 2);
+
+    global.held = pooled{};
+}
+
+// a thread frees its cached blocks when it exits, including ones allocated on another thread
+void testThreads() {
+    var moved = pooled{};
+
+    std::thread other([&moved]() {
+        var local = pooled{};
+        moved = 3;
+        local = 4;
+    });
+    other.join();
+
+    CHECK(moved.isType<int>());
+}
+
+}
+
+int main() {
+    testReuse();
+    testWeak();
+    testThreads();
+
+    return check_result("weak_pool_allocator");
+}
@@ -0,0 +1,169 @@
+//
+// atomic_weak's operations from concurrent readers and writers, for each of its kinds.
+//
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "atomic_weak.h"
+#include "check.h"
+
+namespace {
+
+const int threads = 4;
+const int rounds = 5000;
+
+// numbers the tests write, all whole and below this
+const std::int64_t limit = std::int64_t(threads) * rounds + 1;
+
+template <typename T>
+T make(std::int64_t number) {
+    return T(number);
+}
+
+// strings are as many 'x' as the number, up to 63
+template <>
+std::string make<std::string>(std::int64_t number) {
+    return std::string(static_cast<std::size_t>(number % 64), 'x');
+}
+
+// whether a value is one the tests could have written, which a torn read wouldn't be
+bool written(const std::string& val) {
+    return val.size() < 64 && val.find_first_not_of('x') == std::string::npos;
+}
+
+template <typename T>
+bool written(const T& val) {
+    return val >= T(0) && val < T(limit) && T(std::int64_t(val)) == val;
+}
+
+template <typename T, typename ... Ts>
+struct check_written {
+    void operator() (const T& val, bool& ok) const {
+        ok = written(val);
+    }
+};
+
+void parallel(const std::function<void(int)>& body) {
+    std::vector<std::thread> running;
+    for (int thread = 0; thread < threads; ++thread) {
+        running.emplace_back(body, thread);
+    }
+    for (std::thread& thread : running) {
+        thread.join();
+    }
+}
+
+template <typename Counted, typename Other>
+void testKind(atomic_weak_kind kind) {
+    typedef weak<Counted, Other> weak_type;
+    typedef atomic_weak<Counted, Other> atomic_type;
+
+    CHECK(atomic_weak_kind_of<Counted, Other>::value == kind);
+    CHECK(kind != atomic_weak_kind::left_right || !atomic_type::is_lock_free);
+    CHECK(kind != atomic_weak_kind::double_word || atomic_type::is_lock_free);
+
+    atomic_type atomic(weak_type(make<Counted>(0)));
+
+    // half the threads store either type, the other half check every value they see through load and run
+    parallel([&](int thread) {
+        for (int round = 0; round < rounds; ++round) {
+            std::int64_t number = std::int64_t(thread) * rounds + round;
+
+            if (thread % 2 == 0) {
+                if (round % 2 == 0) {
+                    atomic.store(weak_type(make<Counted>(number)));
+                }
+                else {
+                    atomic = weak_type(make<Other>(number));
+                }
+            }
+            else {
+                bool loaded = false, ran = false;
+                atomic.load().template run<check_written>(loaded);
+                atomic.template run<check_written>(ran);
+                CHECK(loaded);
+                CHECK(ran);
+            }
+        }
+    });
+
+    // increments through compare_exchange add up to one per increment
+    atomic.store(weak_type(make<Counted>(0)));
+    parallel([&](int) {
+        for (int round = 0; round < rounds; ++round) {
+            weak_type expected = atomic.load();
+            for (;;) {
+                std::int64_t next = std::int64_t(expected.template value<Counted>()) + 1;
+                if (atomic.compare_exchange(expected, weak_type(make<Counted>(next)))) {
+                    break;
+                }
+                CHECK(expected.template isType<Counted>());
+            }
+        }
+    });
+    CHECK(atomic.load() == weak_type(make<Counted>(std::int64_t(threads) * rounds)));
+
+    // every number exchanged in comes out once, from exchange or as the last value
+    std::atomic<std::int64_t> returned(0);
+    atomic.store(weak_type(make<Counted>(0)));
+    parallel([&](int thread) {
+        for (int round = 0; round < rounds; ++round) {
+            weak_type previous = atomic.exchange(weak_type(make<Counted>(std::int64_t(thread) * rounds + round + 1)));
+            returned += std::int64_t(previous.template value<Counted>());
+        }
+    });
+
+    std::int64_t total = std::int64_t(threads) * rounds;
+    CHECK(returned + std::int64_t(atomic.load().template value<Counted>()) == total * (total + 1) / 2);
+
+    // a different type fails and loads what is stored into expected
+    weak_type expected = make<Other>(1);
+    CHECK(!atomic.compare_exchange(expected, weak_type(make<Counted>(0))));
+    CHECK(expected == atomic.load());
+
+    // so does an invalid weak, until one is stored
+    weak_type invalid;
+    CHECK(!atomic.compare_exchange(invalid, weak_type()));
+    CHECK(invalid == atomic.load());
+
+    atomic.store(weak_type());
+    invalid = weak_type();
+    CHECK(atomic.compare_exchange(invalid, weak_type(make<Other>(2))));
+    CHECK(atomic.load() == weak_type(make<Other>(2)));
+}
+
+// a stored NaN matches an expected NaN with the same bits for every kind
+template <typename Other>
+void testNaN() {
+    typedef weak<double, Other> weak_type;
+
+    atomic_weak<double, Other> atomic(weak_type(std::nan("")));
+    weak_type expected = atomic.load();
+    CHECK(atomic.compare_exchange(expected, weak_type(1.0)));
+    CHECK(atomic.load() == weak_type(1.0));
+}
+
+}
+
+int main() {
+    testKind<std::int32_t, float>(atomic_weak_kind::word);
+
+#ifdef __GCC_HAVE_SYNC_COMPARE_AND_SWAP_16
+    testKind<std::int64_t, double>(atomic_weak_kind::double_word);
+#else
+    testKind<std::int64_t, double>(atomic_weak_kind::left_right);
+#endif
+
+    testKind<std::int64_t, std::string>(atomic_weak_kind::left_right);
+
+    testNaN<float>();
+    testNaN<std::int64_t>();
+    testNaN<std::string>();
+
+    return check_result("atomic_weak");
+}
@@ -0,0 +1,257 @@
+//
+// weak_batch against the scalar weak operators, element by element, over runs of every length and mix of types. Built
+// once for each instruction set the Makefile finds, and once with WEAK_NO_SIMD.
+//
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "weak_batch.h"
+#include "check.h"
+
+namespace {
+
+// the three vectorized types, one that never is, and one most operators don't apply to
+typedef weak<std::int32_t, float, double, std::int64_t, std::string> var;
+typedef weak_batch<std::int32_t, float, double, std::int64_t, std::string> batch;
+typedef weak_vector<std::int32_t, float, double, std::int64_t, std::string> vector;
+
+std::uint64_t state = 88172645463325252u;
+
+std::uint64_t next() {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// 0 is invalid, 1 to 5 the types. Integers are small and never 0, so no operator overflows or divides by 0.
+var make(std::size_t type) {
+    std::int32_t small = std::int32_t(next() % 2001) - 1000;
+    small = small == 0 ? 1 : small;
+
+    switch (type) {
+        case 1:
+            return small;
+        case 2: {
+            const float special[] = { 0.0f, -0.0f, std::numeric_limits<float>::infinity(), std::nanf("") };
+            return next() % 8 == 0 ? special[next() % 4] : float(small) / 8;
+        }
+        case 3: {
+            const double special[] = { 0.0, -0.0, -std::numeric_limits<double>::infinity(), std::nan("") };
+            return next() % 8 == 0 ? special[next() % 4] : double(small) / 16;
+        }
+        case 4:
+            return std::int64_t(small) * 100000;
+        case 5:
+            return std::string(next() % 3, char('a' + next() % 3));
+        default:
+            return var();
+    }
+}
+
+// same type and value, floating point numbers compared by their bits
+template <typename T, typename ... Ts>
+struct same_as {
+    void operator() (const T& val, const var& other, bool& same) const {
+        const T* otherVal = other.get_if<T>();
+        same = otherVal != nullptr && equal(val, *otherVal, std::is_floating_point<T>());
+    }
+
+    static bool equal(const T& val, const T& other, std::true_type) {
+        return std::memcmp(&val, &other, sizeof(T)) == 0 || (std::isnan(val) && std::isnan(other));
+    }
+
+    static bool equal(const T& val, const T& other, std::false_type) {
+        return val == other;
+    }
+};
+
+bool same(const var& left, const var& right) {
+    if (!left.isValid()) {
+        return !right.isValid();
+    }
+
+    bool same = false;
+    left.run<same_as>(right, same);
+    return same;
+}
+
+// left and right types for count elements: long runs of one pair, runs of a few, or a new pair every element
+void fill(std::vector<var>& left, std::vector<var>& right, std::size_t count, int shape) {
+    left.clear();
+    right.clear();
+
+    while (left.size() < count) {
+        std::size_t leftType = next() % 6, rightType = next() % 6;
+        if (shape == 0 || next() % 2 == 0) {
+            // mostly the vectorized pairs
+            leftType = 1 + next() % 3;
+            rightType = next() % 4 == 0 ? 1 + next() % 3 : leftType;
+        }
+
+        std::size_t length = shape == 0 ? 1 + next() % 200 : shape == 1 ? 1 + next() % 9 : 1;
+        for (std::size_t i = 0; i < length && left.size() < count; ++i) {
+            left.push_back(make(leftType));
+            right.push_back(make(rightType));
+        }
+    }
+}
+
+vector column(const std::vector<var>& values) {
+    vector filled;
+    for (const var& value : values) {
+        filled.push_back(value);
+    }
+    return filled;
+}
+
+typedef void (*arithmetic)(const var*, const var*, var*, std::size_t);
+typedef void (*vector_arithmetic)(const vector&, const vector&, vector&);
+typedef var (*scalar_arithmetic)(const var&, const var&);
+
+void checkArithmetic(const std::vector<var>& left, const std::vector<var>& right, arithmetic op,
+                     vector_arithmetic vectorOp, scalar_arithmetic scalar) {
+    std::size_t count = left.size();
+    std::vector<var> results(count, var(std::string("untouched")));
+    op(left.data(), right.data(), results.data(), count);
+
+    vector vectorResults;
+    vectorOp(column(left), column(right), vectorResults);
+    CHECK(vectorResults.size() == count);
+
+    // the result may be the left input
+    std::vector<var> inPlace = left;
+    op(inPlace.data(), right.data(), inPlace.data(), count);
+
+    for (std::size_t i = 0; i < count; ++i) {
+        var expected = scalar(left[i], right[i]);
+        CHECK(same(results[i], expected));
+        CHECK(i >= vectorResults.size() || same(var(vectorResults[i]), expected));
+        CHECK(same(inPlace[i], expected));
+    }
+}
+
+typedef void (*comparison)(const var*, const var*, std::uint64_t*, std::size_t);
+typedef void (*vector_comparison)(const vector&, const vector&, std::uint64_t*);
+typedef bool (*scalar_comparison)(const var&, const var&);
+
+bool bit(const std::vector<std::uint64_t>& mask, std::size_t i) {
+    return (mask[i / 64] >> (i % 64)) & 1u;
+}
+
+void checkComparison(const std::vector<var>& left, const std::vector<var>& right, comparison op,
+                     vector_comparison vectorOp, scalar_comparison scalar) {
+    std::size_t count = left.size();
+
+    // one word more than needed, all of it random, to see that bits past count are kept
+    std::vector<std::uint64_t> garbage((count + 63) / 64 + 1);
+    for (std::uint64_t& word : garbage) {
+        word = next();
+    }
+
+    std::vector<std::uint64_t> mask = garbage, vectorMask = garbage;
+    op(left.data(), right.data(), mask.data(), count);
+    vectorOp(column(left), column(right), vectorMask.data());
+
+    for (std::size_t i = 0; i < count; ++i) {
+        bool expected = scalar(left[i], right[i]);
+        CHECK(bit(mask, i) == expected);
+        CHECK(bit(vectorMask, i) == expected);
+    }
+
+    for (std::size_t i = count; i < garbage.size() * 64; ++i) {
+        CHECK(bit(mask, i) == bit(garbage, i));
+        CHECK(bit(vectorMask, i) == bit(garbage, i));
+    }
+}
+
+void checkAll(const std::vector<var>& left, const std::vector<var>& right) {
+    checkArithmetic(left, right, &batch::add, &batch::add,
+                    [](const var& val, const var& val1) -> var { return val + val1; });
+    checkArithmetic(left, right, &batch::subtract, &batch::subtract,
+                    [](const var& val, const var& val1) -> var { return val - val1; });
+    checkArithmetic(left, right, &batch::multiply, &batch::multiply,
+                    [](const var& val, const var& val1) -> var { return val * val1; });
+    checkArithmetic(left, right, &batch::divide, &batch::divide,
+                    [](const var& val, const var& val1) -> var { return val / val1; });
+
+    checkComparison(left, right, &batch::equal, &batch::equal,
+                    [](const var& val, const var& val1) { return val == val1; });
+    checkComparison(left, right, &batch::not_equal, &batch::not_equal,
+                    [](const var& val, const var& val1) { return val != val1; });
+    checkComparison(left, right, &batch::less_than, &batch::less_than,
+                    [](const var& val, const var& val1) { return val < val1; });
+    checkComparison(left, right, &batch::greater_than, &batch::greater_than,
+                    [](const var& val, const var& val1) { return val > val1; });
+    checkComparison(left, right, &batch::less_than_equal_to, &batch::less_than_equal_to,
+                    [](const var& val, const var& val1) { return val <= val1; });
+    checkComparison(left, right, &batch::greater_than_equal_to, &batch::greater_than_equal_to,
+                    [](const var& val, const var& val1) { return val >= val1; });
+}
+
+// one pair of types over every length around the vector widths and the 64 element chunks
+void testLengths() {
+    std::vector<var> left, right;
+
+    for (std::size_t type = 1; type <= 3; ++type) {
+        for (std::size_t count = 0; count <= 140; ++count) {
+            left.clear();
+            right.clear();
+            for (std::size_t i = 0; i < count; ++i) {
+                left.push_back(make(type));
+                right.push_back(make(type));
+            }
+
+            checkAll(left, right);
+        }
+    }
+}
+
+// runs that start and end anywhere within a chunk or a mask word, next to mixed pairs and invalid values
+void testRuns() {
+    std::vector<var> left, right;
+
+    for (int round = 0; round < 300; ++round) {
+        fill(left, right, next() % 400, round % 3);
+        checkAll(left, right);
+    }
+}
+
+// a weak_vector whose elements changed type keeps its columns out of order, so values are gathered
+void testScattered() {
+    std::vector<var> left, right;
+    fill(left, right, 300, 0);
+
+    vector leftColumn = column(left);
+    for (std::size_t i = 0; i < left.size(); i += 3) {
+        var changed = make(next() % 4);
+        leftColumn[i] = changed;
+        left[i] = changed;
+    }
+
+    vector sums;
+    batch::add(leftColumn, column(right), sums);
+
+    std::vector<std::uint64_t> less((left.size() + 63) / 64);
+    batch::less_than(leftColumn, column(right), less.data());
+
+    for (std::size_t i = 0; i < left.size(); ++i) {
+        CHECK(same(var(sums[i]), left[i] + right[i]));
+        CHECK(bit(less, i) == (left[i] < right[i]));
+    }
+}
+
+}
+
+int main() {
+    testLengths();
+    testRuns();
+    testScattered();
+
+    return check_result("weak_batch");
+}
@@ -0,0 +1,84 @@
+//
+// boxed_weak's pointers, and writing back through ref<T>() and run.
+//
+
+#include <cstdint>
+#include "boxed_weak.h"
+#include "check.h"
+
+namespace {
+
+typedef boxed_weak<int, double, float> boxed;
+
+template <typename T, typename ... Ts>
+struct twice {
+    void operator() (T& val) const {
+        val = val * T(2);
+    }
+};
+
+// assigns the boxed_weak while the proxy of another type is alive
+template <typename T, typename ... Ts>
+struct overwrite {
+    void operator() (T& val, boxed& owner) const {
+        val = T();
+        owner = 2.5f;
+    }
+};
+
+void testWriteBack() {
+    boxed b = 3;
+    b.run<twice>();
+    CHECK(b.isType<int>() && b.value<int>() == 6);
+
+    b = 1.25;
+    b.run<twice>();
+    CHECK(b.isType<double>() && b.value<double>() == 2.5);
+
+    b = 7;
+    b.ref<int>() = 9;
+    CHECK(b.value<int>() == 9);
+
+    static_cast<int&>(b.ref<int>()) += 1;
+    CHECK(b.value<int>() == 10);
+
+    // value<T>() is a copy on a non const boxed_weak too
+    int copy = b.value<int>();
+    copy = 0;
+    CHECK(copy == 0 && b.value<int>() == 10);
+
+    // an assignment made while the proxy lives wins over its write back
+    b.run<overwrite>(b);
+    CHECK(b.isType<float>() && b.value<float>() == 2.5f);
+
+    b += 1.0f;
+    CHECK(b.isType<float>() && b.value<float>() == 3.5f);
+}
+
+void testPointers() {
+    static const char text[] = "text";
+    int local = 5;
+
+    boxed_weak<const char*, int> b = static_cast<const char*>(text);
+    CHECK(b.isType<const char*>() && b.value<const char*>() == text);
+
+    b = static_cast<const char*>(nullptr);
+    CHECK(b.isType<const char*>() && b.value<const char*>() == nullptr);
+
+    boxed_weak<int*, double> pointer = &local;
+    CHECK(pointer.value<int*>() == &local);
+    *pointer.value<int*>() = 6;
+    CHECK(local == 6);
+
+    // every address this process hands out fits in 48 bits, or encode would have asserted
+    CHECK((reinterpret_cast<std::uintptr_t>(&local) >> 48) == 0u);
+}
+
+}
+
+int main() {
+    testWriteBack();
+    testPointers();
+
+    return check_result("boxed_weak");
+}
@@ -0,0 +1,32 @@
+//
+// The checks the tests are written with. CHECK reports a condition that doesn't hold and carries on, so one run lists
+// every failure, and main returns check_result() to fail the build.
+//
+
+#ifndef WEAK_TYPES_TESTS_CHECK_H
+#define WEAK_TYPES_TESTS_CHECK_H
+
+#include <atomic>
+#include <cstdio>
+
+inline std::atomic<int>& check_failures() {
+    static std::atomic<int> failures(0);
+    return failures;
+}
+
+inline void check_failed(const char* condition, const char* file, int line) {
+    std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, condition);
+    ++check_failures();
+}
+
+/// 0 when every check held, 1 otherwise, and prints the number of failures
+inline int check_result(const char* test) {
+    int failures = check_failures().load();
+    std::printf("%s: %s (%d failed)\n", test, failures == 0 ? "passed" : "FAILED", failures);
+    return failures == 0 ? 0 : 1;
+}
+
+// variadic, so conditions can hold commas of template arguments
+#define CHECK(...) ((__VA_ARGS__) ? (void) 0 : check_failed(#__VA_ARGS__, __FILE__, __LINE__))
+
+#endif //WEAK_TYPES_TESTS_CHECK_H
@@ -0,0 +1,454 @@
+//
+// weak itself: copies, moves and self assignment for every way a value is stored, run's dispatch to every type, the
+// operators on mixed types against the same operators on the raw values, moves in containers, and get_if, retrieve
+// and as.
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "weak.h"
+#include "check.h"
+
+namespace {
+
+std::size_t allocations = 0;
+
+}
+
+void* operator new(std::size_t size) {
+    ++allocations;
+    if (void* allocated = std::malloc(size == 0 ? 1 : size)) {
+        return allocated;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* allocated) noexcept {
+    std::free(allocated);
+}
+
+void operator delete(void* allocated, std::size_t) noexcept {
+    std::free(allocated);
+}
+
+namespace {
+
+// counts its instances and how many were copied from another. Kind tells the storage kinds apart.
+template <int Kind>
+struct tracked {
+    static int live;
+    static int copies;
+
+    int n;
+
+    explicit tracked(int n) : n(n) {
+        ++live;
+    }
+
+    tracked(const tracked& other) : n(other.n) {
+        ++live;
+        ++copies;
+    }
+
+    tracked(tracked&& other) noexcept : n(other.n) {
+        ++live;
+    }
+
+    tracked& operator=(const tracked&) = default;
+
+    ~tracked() {
+        --live;
+    }
+};
+
+template <int Kind>
+int tracked<Kind>::live = 0;
+
+template <int Kind>
+int tracked<Kind>::copies = 0;
+
+typedef tracked<0> inlined;
+typedef tracked<1> boxed;
+typedef tracked<2> counted;
+
+}
+
+template <>
+struct weak_is_inline<boxed> : std::false_type {};
+
+template <>
+struct weak_is_shared<counted> : std::true_type {};
+
+namespace {
+
+typedef weak<int, double, std::string, inlined, boxed, counted> var;
+
+// the value without detaching a shared one
+template <typename T>
+const T& look(const var& val) {
+    return val.value<T>();
+}
+
+// whether the value lives in the weak's own buffer
+bool within(const var& val, const void* address) {
+    std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(&val);
+    std::uintptr_t at = reinterpret_cast<std::uintptr_t>(address);
+    return at >= begin && at < begin + sizeof(var);
+}
+
+template <typename T>
+bool holds(const var& val, int n) {
+    return val.isType<T>() && look<T>(val).n == n;
+}
+
+template <typename T>
+void checkKind(bool inBuffer, bool shares) {
+    {
+        var original = T(5);
+        CHECK(holds<T>(original, 5));
+        CHECK(within(original, &look<T>(original)) == inBuffer);
+
+        // a copy allocates only when it needs its own block, and shares the value instead of copying it when it can
+        std::size_t before = allocations;
+        int copies = T::copies;
+        var copy = original;
+        CHECK(holds<T>(copy, 5));
+        CHECK(allocations - before == (inBuffer || shares ? 0u : 1u));
+        CHECK(T::copies - copies == (shares ? 0 : 1));
+        CHECK((&look<T>(copy) == &look<T>(original)) == shares);
+
+        // over a string and back
+        var other = std::string(40, 's');
+        other = original;
+        CHECK(holds<T>(other, 5) && holds<T>(original, 5));
+        other = std::string(40, 't');
+        CHECK(other.isType<std::string>() && look<std::string>(other) == std::string(40, 't'));
+
+        // assigning a weak to itself keeps its value
+        var& self = copy;
+        copy = self;
+        CHECK(holds<T>(copy, 5));
+        copy = std::move(self);
+        CHECK(holds<T>(copy, 5));
+
+        // moves take the value over without copying or allocating, and leave the weak they move from invalid
+        before = allocations;
+        copies = T::copies;
+        var moved = std::move(copy);
+        CHECK(holds<T>(moved, 5) && !copy.isValid());
+        other = std::move(moved);
+        CHECK(holds<T>(other, 5) && !moved.isValid());
+        var& invalid = moved;
+        moved = std::move(invalid);
+        CHECK(!moved.isValid());
+        CHECK(allocations == before && T::copies == copies);
+
+        // an invalid weak over a valid one
+        other = var();
+        CHECK(!other.isValid() && holds<T>(original, 5));
+    }
+
+    CHECK(T::live == 0);
+}
+
+void testStorage() {
+    checkKind<inlined>(true, false);
+    checkKind<boxed>(false, false);
+    checkKind<counted>(false, true);
+
+    // the buffer fits the largest alternative and the tag packs after it
+    CHECK(sizeof(weak<int, float, double>) <= 2 * sizeof(double));
+}
+
+// numbers and the temporaries of their operators never touch the allocator
+void testNoAllocation() {
+    std::size_t before = allocations;
+
+    var number = 2, other = 2.5;
+    var sum = number + other;
+    var product = sum * number;
+    product = product - other / number;
+    var copy = product;
+    copy = number;
+
+    CHECK(allocations == before);
+    CHECK(look<double>(product) == 9.0 - 1.25 && look<int>(copy) == 2);
+}
+
+// twelve alternatives without operators, told apart by N
+template <int N>
+struct slot {
+    int n;
+};
+
+typedef weak<slot<0>, slot<1>, slot<2>, slot<3>, slot<4>, slot<5>, slot<6>, slot<7>, slot<8>, slot<9>, slot<10>,
+             slot<11>> wide;
+
+// where T is in wide, and whether run passed it as non const. The non const call changes the value.
+template <typename T, typename ... Ts>
+struct which {
+    void operator() (T& val, std::size_t& index, bool& writable) const {
+        index = get_type_index_impl<T, slot<0>, slot<1>, slot<2>, slot<3>, slot<4>, slot<5>, slot<6>, slot<7>, slot<8>,
+                                    slot<9>, slot<10>, slot<11>>::value;
+        writable = true;
+        ++val.n;
+    }
+
+    void operator() (const T&, std::size_t& index, bool& writable) const {
+        index = get_type_index_impl<T, slot<0>, slot<1>, slot<2>, slot<3>, slot<4>, slot<5>, slot<6>, slot<7>, slot<8>,
+                                    slot<9>, slot<10>, slot<11>>::value;
+        writable = false;
+    }
+};
+
+template <int N>
+void checkSlot() {
+    wide val = slot<N>{ N };
+    const wide& constant = val;
+
+    std::size_t index = 0;
+    bool writable = true;
+    constant.run<which>(index, writable);
+    CHECK(index == std::size_t(N + 1) && !writable);
+    CHECK(val.value<slot<N>>().n == N);
+
+    index = 0;
+    val.run<which>(index, writable);
+    CHECK(index == std::size_t(N + 1) && writable);
+    CHECK(val.value<slot<N>>().n == N + 1);
+}
+
+// the extra template arguments of run reach the functor
+template <typename T, typename Scale>
+struct scaled {
+    void operator() (const T& val, Scale& result) const {
+        result = Scale(val) * 2;
+    }
+};
+
+template <typename Scale>
+struct scaled<std::string, Scale> {
+    void operator() (const std::string& val, Scale& result) const {
+        result = Scale(val.size());
+    }
+};
+
+template <int Kind, typename Scale>
+struct scaled<tracked<Kind>, Scale> {
+    void operator() (const tracked<Kind>& val, Scale& result) const {
+        result = Scale(val.n);
+    }
+};
+
+// every type, first to last, through both overloads of run, and nothing for an invalid weak
+void testRun() {
+    checkSlot<0>();
+    checkSlot<1>();
+    checkSlot<5>();
+    checkSlot<10>();
+    checkSlot<11>();
+
+    std::size_t index = 0;
+    bool writable = false;
+    wide invalid;
+    invalid.run<which>(index, writable);
+    static_cast<const wide&>(invalid).run<which>(index, writable);
+    CHECK(index == 0u && !writable);
+
+    const var values[] = { 3, 1.25, std::string("four"), inlined(5), boxed(6), counted(7) };
+    const double expected[] = { 6.0, 2.5, 4.0, 5.0, 6.0, 7.0 };
+    for (std::size_t i = 0; i < 6; ++i) {
+        double result = 0.0;
+        values[i].run<scaled, double>(result);
+        CHECK(result == expected[i]);
+    }
+}
+
+// moving it may throw
+struct throwing {
+    throwing() {}
+
+    throwing(throwing&&) {}
+
+    throwing(const throwing&) = default;
+};
+
+static_assert(std::is_nothrow_move_constructible<var>::value && std::is_nothrow_move_assignable<var>::value,
+              "weak moves are noexcept when its types' are");
+static_assert(!std::is_nothrow_move_constructible<weak<int, throwing>>::value &&
+              !std::is_nothrow_move_assignable<weak<int, throwing>>::value,
+              "a type that may throw on a move makes weak's moves potentially throwing");
+
+// a growing vector moves its elements, so none of them is copied
+void testContainerMoves() {
+    {
+        std::vector<var> values;
+        for (int i = 0; i < 100; ++i) {
+            values.push_back(i % 2 == 0 ? var(boxed(i)) : var(std::string(30, 'v')));
+        }
+
+        int copies = boxed::copies;
+        std::size_t before = allocations;
+        values.reserve(values.capacity() * 2);
+        CHECK(boxed::copies == copies);
+        CHECK(allocations == before + 1);
+
+        std::reverse(values.begin(), values.end());
+        CHECK(boxed::copies == copies);
+        CHECK(holds<boxed>(values[99], 0) && holds<boxed>(values[1], 98));
+    }
+
+    CHECK(boxed::live == 0);
+}
+
+typedef weak<int, double, float, char, std::string> number;
+
+// the same type and value as the raw result
+template <typename R>
+bool is(const number& val, const R& expected) {
+    return val.isType<R>() && val.value<R>() == expected;
+}
+
+template <typename T, typename V>
+void checkMixed(T left, V right) {
+    const number l = left, r = right;
+
+    CHECK(is(l + r, left + right));
+    CHECK(is(l - r, left - right));
+    CHECK(is(l * r, left * right));
+    CHECK(is(l / r, left / right));
+
+    CHECK((l == r) == (left == right));
+    CHECK((l != r) == (left != right));
+    CHECK((l < r) == (left < right));
+    CHECK((l > r) == (left > right));
+    CHECK((l <= r) == (left <= right));
+    CHECK((l >= r) == (left >= right));
+
+    // compound assignments take the type of the result
+    number assigned = l;
+    assigned += r;
+    CHECK(is(assigned, left + right));
+    assigned = l;
+    assigned -= r;
+    CHECK(is(assigned, left - right));
+    assigned = l;
+    assigned *= r;
+    CHECK(is(assigned, left * right));
+    assigned = l;
+    assigned /= r;
+    CHECK(is(assigned, left / right));
+}
+
+template <typename T>
+void checkWithAll(T left) {
+    checkMixed(left, 7);
+    checkMixed(left, -3);
+    checkMixed(left, 2.5);
+    checkMixed(left, -0.75f);
+    checkMixed(left, 'a');
+}
+
+// every pair of number types, integer results included, and strings with each other and with numbers
+void testOperators() {
+    checkWithAll(7);
+    checkWithAll(-3);
+    checkWithAll(2.5);
+    checkWithAll(1.5f);
+    checkWithAll('z');
+
+    const number abc = std::string("abc"), abd = std::string("abd");
+    CHECK(is(abc + abd, std::string("abcabd")));
+    CHECK(abc < abd && abc <= abd && abd > abc && abd >= abc && abc != abd && !(abc == abd));
+
+    // no operator takes a string and a number: arithmetic is invalid and comparisons are false
+    const number seven = 7;
+    CHECK(!(abc + seven).isValid() && !(seven * abc).isValid());
+    CHECK(!(abc == seven) && !(abc < seven) && !(seven >= abc));
+
+    number assigned = abc;
+    assigned -= seven;
+    CHECK(!assigned.isValid());
+
+    // and so does an invalid weak
+    CHECK(!(number() + seven).isValid() && !(number() == number()));
+}
+
+// T's get_if finds the value, every other type's is nullptr, const or not
+template <typename T>
+void checkGetIf(var val) {
+    const var& constant = val;
+    CHECK(constant.get_if<T>() == &constant.value<T>());
+    CHECK(val.get_if<T>() != nullptr);
+
+    CHECK((std::is_same<T, int>::value) == (constant.get_if<int>() != nullptr));
+    CHECK((std::is_same<T, double>::value) == (val.get_if<double>() != nullptr));
+    CHECK((std::is_same<T, std::string>::value) == (constant.get_if<std::string>() != nullptr));
+    CHECK((std::is_same<T, inlined>::value) == (val.get_if<inlined>() != nullptr));
+    CHECK((std::is_same<T, boxed>::value) == (constant.get_if<boxed>() != nullptr));
+    CHECK((std::is_same<T, counted>::value) == (val.get_if<counted>() != nullptr));
+
+    // types that aren't in var at all
+    CHECK(constant.get_if<float>() == nullptr && val.get_if<char>() == nullptr);
+}
+
+void testGetIf() {
+    checkGetIf<int>(3);
+    checkGetIf<double>(0.5);
+    checkGetIf<std::string>(std::string(40, 'g'));
+    checkGetIf<inlined>(inlined(1));
+    checkGetIf<boxed>(boxed(2));
+    checkGetIf<counted>(counted(3));
+
+    var invalid;
+    CHECK(invalid.get_if<int>() == nullptr && static_cast<const var&>(invalid).get_if<boxed>() == nullptr);
+
+    // writing through the pointer changes the stored value
+    var number = 4;
+    *number.get_if<int>() += 1;
+    CHECK(look<int>(number) == 5);
+}
+
+// probing and converting numbers allocates nothing, and a wrong type or an impossible conversion gives nothing
+void testRetrieve() {
+    const var number = 7, fraction = 2.5, text = std::string("seven");
+
+    std::size_t before = allocations;
+    simple_optional<int> integer = number.retrieve<int>();
+    simple_optional<double> wrong = number.retrieve<double>();
+    simple_optional<double> widened = number.as<double>();
+    simple_optional<int> truncated = fraction.as<int>();
+    simple_optional<double> none = text.as<double>();
+    simple_optional<int> copied = integer;
+    CHECK(allocations == before);
+
+    CHECK(integer && integer.value() == 7 && copied && copied.value() == 7);
+    CHECK(!wrong);
+    CHECK(widened && widened.value() == 7.0);
+    CHECK(truncated && truncated.value() == 2);
+    CHECK(!none);
+    CHECK(!var().retrieve<int>() && !var().as<double>());
+
+    simple_optional<std::string> string = text.retrieve<std::string>();
+    CHECK(string && string.value() == "seven" && !number.retrieve<std::string>());
+}
+
+}
+
+int main() {
+    testStorage();
+    testNoAllocation();
+    testRun();
+    testOperators();
+    testContainerMoves();
+    testGetIf();
+    testRetrieve();
+
+    return check_result("weak");
+}
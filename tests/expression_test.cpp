@@ -0,0 +1,112 @@
+//
+// weak_expression against the eager operators, and results whose type the weak can't hold.
+//
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include "weak_expression.h"
+#include "check.h"
+
+namespace {
+
+typedef weak<int, double, std::string> var;
+
+template <typename T, typename ... Ts>
+struct same_as {
+    void operator() (const T& val, const var& other, bool& same) const {
+        const T* otherVal = other.get_if<T>();
+        same = otherVal != nullptr && *otherVal == val;
+    }
+};
+
+bool same(const var& left, const var& right) {
+    if (!left.isValid()) {
+        return !right.isValid();
+    }
+
+    bool same = false;
+    left.run<same_as>(right, same);
+    return same;
+}
+
+// where every intermediate type is one of the weak's, the expression gives what the eager operators give
+void testAgainstEager() {
+    const var values[] = { var(), 3, -2, 0.5, 4.25, std::string("ab") };
+
+    for (const var& a : values) {
+        for (const var& b : values) {
+            for (const var& c : values) {
+                var lazy = weak_lazy(a) + b * c;
+                CHECK(same(lazy, a + b * c));
+
+                lazy = weak_lazy(a) - b / 2.0 + c;
+                CHECK(same(lazy, a - b / var(2.0) + c));
+
+                lazy = 3 * weak_lazy(b) - a * (weak_lazy(c) + 1);
+                CHECK(same(lazy, var(3) * b - a * (c + var(1))));
+
+                // no value is 0, so no integer division by 0
+                lazy = a / (weak_lazy(b) * c);
+                CHECK(same(lazy, a / (b * c)));
+            }
+        }
+    }
+}
+
+// the expression may be assigned to a weak it reads
+void testIntoOperand() {
+    var a = 2, b = 0.5;
+    a = weak_lazy(a) * a + b;
+    CHECK(a.isType<double>() && a.value<double>() == 4.5);
+
+    var text = std::string("x");
+    text = weak_lazy(text) + text + text;
+    CHECK(text.isType<std::string>() && text.value<std::string>() == "xxx");
+
+    // an invalid operand or an operation the types lack leaves it invalid
+    text = weak_lazy(text) - text;
+    CHECK(!text.isValid());
+
+    var none;
+    a = weak_lazy(a) + none;
+    CHECK(!a.isValid());
+}
+
+typedef weak<char, float, std::int16_t> narrow;
+
+// intermediate values keep their raw types, only the final one has to be one of the weak's types
+void testResultNotInTypes() {
+    narrow letter = 'a', one = 1.0f, small = std::int16_t(2);
+
+    // char + char and int16 * int16 are ints, float * double is a double, none of which narrow holds
+    narrow result = 'z';
+    result = weak_lazy(letter) + letter;
+    CHECK(!result.isValid());
+
+    result = weak_lazy(small) * small;
+    CHECK(!result.isValid());
+
+    result = weak_lazy(one) * 2.0;
+    CHECK(!result.isValid());
+
+    // an int in between is fine when the result is a float
+    result = (weak_lazy(letter) + letter) * one;
+    CHECK(result.isType<float>() && result.value<float>() == float('a' + 'a'));
+
+    result = weak_lazy(one) * 2.0f;
+    CHECK(result.isType<float>() && result.value<float>() == 2.0f);
+
+    narrow converted = weak_lazy(small) / small * one;
+    CHECK(converted.isType<float>() && converted.value<float>() == 1.0f);
+}
+
+}
+
+int main() {
+    testAgainstEager();
+    testIntoOperand();
+    testResultNotInTypes();
+
+    return check_result("weak_expression");
+}
@@ -0,0 +1,285 @@
+//
+// weak_hash's agreement with ==, and weak_hash_map's insertion, erasure and reuse of erased slots.
+//
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include "weak_hash_map.h"
+#include "check.h"
+
+namespace {
+
+// the number of allocations that succeed before one throws, or -1 for all of them
+int allocationsLeft = -1;
+
+}
+
+void* operator new(std::size_t size) {
+    if (allocationsLeft == 0) {
+        throw std::bad_alloc();
+    }
+    if (allocationsLeft > 0) {
+        --allocationsLeft;
+    }
+
+    if (void* allocated = std::malloc(size == 0 ? 1 : size)) {
+        return allocated;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* allocated) noexcept {
+    std::free(allocated);
+}
+
+void operator delete(void* allocated, std::size_t) noexcept {
+    std::free(allocated);
+}
+
+namespace {
+
+typedef weak<std::int64_t, double, float, char, std::string, const char*> key_type;
+
+// signed and unsigned integers are only consistent when the signed ones aren't negative, see weak_value_hash
+typedef weak<std::uint64_t, double, unsigned char> unsigned_key_type;
+
+// keys that compare equal hash equal
+void testHash() {
+    weak_hash hash;
+
+    const key_type equal[][3] = {
+            { std::int64_t(1), 1.0, '\x01' },
+            { std::int64_t(-7), -7.0, -7.0f },
+            { 42.0f, std::int64_t(42), 42.0 },
+            { 0.0, -0.0, std::int64_t(0) },
+            // 2^53 + 1 compares equal to the double it rounds to
+            { std::int64_t((1LL << 53) + 1), double(1LL << 53), std::int64_t((1LL << 53) + 1) },
+            { std::string("abc"), static_cast<const char*>("abc"), std::string("abc") },
+            { std::string(), static_cast<const char*>(""), std::string() },
+    };
+
+    for (const auto& keys : equal) {
+        for (const key_type& left : keys) {
+            for (const key_type& right : keys) {
+                CHECK(left == right);
+                CHECK(hash(left) == hash(right));
+            }
+        }
+    }
+
+    const unsigned_key_type unsignedEqual[][3] = {
+            { static_cast<unsigned char>(1), 1.0, std::uint64_t(1) },
+            { std::uint64_t(UINT64_MAX), double(UINT64_MAX), std::uint64_t(UINT64_MAX) },
+            { std::uint64_t((1ULL << 53) + 1), double(1ULL << 53), std::uint64_t((1ULL << 53) + 1) },
+    };
+
+    for (const auto& keys : unsignedEqual) {
+        for (const unsigned_key_type& left : keys) {
+            for (const unsigned_key_type& right : keys) {
+                CHECK(left == right);
+                CHECK(hash(left) == hash(right));
+            }
+        }
+    }
+
+    CHECK(hash(unsigned_key_type(std::uint64_t(7))) == hash(key_type(std::int64_t(7))));
+
+    CHECK(hash(key_type(std::int64_t(1))) != hash(key_type(std::int64_t(2))));
+    CHECK(hash(key_type(0.5)) != hash(key_type(std::int64_t(0))));
+    CHECK(hash(key_type(std::string("abc"))) != hash(key_type(std::string("abd"))));
+    CHECK(hash(key_type()) == 0u);
+}
+
+// a number key is found whatever type it is looked up as
+void testMixedKeys() {
+    weak_hash_map<key_type, int> map;
+    map[std::int64_t(3)] = 3;
+    map[2.5] = 25;
+    map[std::string("three")] = 30;
+
+    CHECK(map.size() == 3u);
+    CHECK(map.contains(3.0));
+    CHECK(map.contains(3.0f));
+    CHECK(map.contains(static_cast<const char*>("three")));
+    CHECK(!map.contains(std::int64_t(2)));
+
+    CHECK(!map.insert(key_type('\x03'), 4).second);
+    CHECK(map.find(3.0) -> second == 3);
+
+    map[double(1LL << 53)] = 53;
+    CHECK(map.find(std::int64_t((1LL << 53) + 1)) != map.end());
+}
+
+// keys that don't compare equal to themselves are never inserted
+void testSelfUnequalKeys() {
+    weak_hash_map<key_type, int> map;
+
+    CHECK(!map.insert(key_type(std::nan("")), 1).second);
+    CHECK(map.insert(key_type(std::nan("")), 1).first == map.end());
+    CHECK(!map.insert(key_type(), 1).second);
+
+    bool threw = false;
+    try {
+        map[std::nan("")] = 2;
+    }
+    catch (const std::invalid_argument&) {
+        threw = true;
+    }
+
+    CHECK(threw);
+    CHECK(map.empty());
+    CHECK(map.find(std::nan("")) == map.end());
+}
+
+// random inserts and erases, alternating the type of equal keys, agree with a std::map
+void testAgainstMap() {
+    weak_hash_map<key_type, std::int64_t> map;
+    std::map<std::int64_t, std::int64_t> expected;
+
+    std::uint64_t state = 12345u;
+    auto next = [&state]() {
+        state = state * 6364136223846793005u + 1442695040888963407u;
+        return state >> 33;
+    };
+
+    for (int round = 0; round < 100000; ++round) {
+        std::int64_t number = std::int64_t(next() % 512);
+        key_type key = round % 2 == 0 ? key_type(number) : key_type(double(number));
+
+        if (next() % 3 == 0) {
+            CHECK(map.erase(key) == expected.erase(number));
+        }
+        else {
+            bool inserted = map.insert(key, std::int64_t(round)).second;
+            CHECK(inserted == expected.emplace(number, std::int64_t(round)).second);
+        }
+
+        CHECK(map.size() == expected.size());
+    }
+
+    std::size_t visited = 0;
+    for (const auto& value : map) {
+        const std::int64_t* integer = value.first.get_if<std::int64_t>();
+        const double* floating = value.first.get_if<double>();
+        auto found = expected.find(integer != nullptr ? *integer : std::int64_t(*floating));
+        CHECK(found != expected.end() && found -> second == value.second);
+        ++visited;
+    }
+    CHECK(visited == expected.size());
+}
+
+// erasing and inserting different keys forever reuses the erased slots, and a key behind an erased slot is still found
+void testErasedSlots() {
+    weak_hash_map<key_type, int> map;
+    map.reserve(64);
+
+    for (std::int64_t key = 0; key < 48; ++key) {
+        map.insert(key_type(key), int(key));
+    }
+
+    for (std::int64_t key = 48; key < 100000; ++key) {
+        CHECK(map.erase(key_type(key - 48)) == 1u);
+        CHECK(map.insert(key_type(key), int(key)).second);
+        CHECK(!map.insert(key_type(key - 1), 0).second);
+        CHECK(map.size() == 48u);
+    }
+
+    for (std::int64_t key = 100000 - 48; key < 100000; ++key) {
+        auto found = map.find(key_type(double(key)));
+        CHECK(found != map.end() && found -> second == int(key));
+    }
+
+    CHECK(map.erase(key_type(std::int64_t(0))) == 0u);
+
+    map.clear();
+    CHECK(map.empty());
+    CHECK(map.begin() == map.end());
+    CHECK(map.insert(key_type(std::int64_t(1)), 1).second);
+}
+
+
+// growing fails on either buffer without losing or corrupting what the table holds
+void testGrowthThrows() {
+    for (int succeeding = 0; succeeding < 2; ++succeeding) {
+        weak_hash_map<key_type, std::string> map;
+        for (std::int64_t key = 0; key < 14; ++key) {
+            map.insert(key_type(key), std::string(40, char('a' + key)));
+        }
+
+        // the 15th key doesn't fit 16 slots at 7/8 load
+        allocationsLeft = succeeding;
+        bool threw = false;
+        try {
+            map.insert(key_type(std::int64_t(14)), std::string());
+        }
+        catch (const std::bad_alloc&) {
+            threw = true;
+        }
+        allocationsLeft = -1;
+
+        CHECK(threw);
+        CHECK(map.size() == 14u);
+        for (std::int64_t key = 0; key < 14; ++key) {
+            auto found = map.find(key_type(key));
+            CHECK(found != map.end() && found -> second == std::string(40, char('a' + key)));
+        }
+
+        CHECK(map.insert(key_type(std::int64_t(14)), std::string("fits")).second);
+        CHECK(map.size() == 15u && map.contains(key_type(std::int64_t(14))));
+    }
+}
+
+// counts how often it is constructed
+struct counted {
+    static int constructions;
+
+    int value;
+
+    counted() : value(0) {
+        ++constructions;
+    }
+
+    counted(const counted& other) : value(other.value) {
+        ++constructions;
+    }
+};
+
+int counted::constructions = 0;
+
+// operator[] and try_emplace construct a mapped value only for a new key
+void testNoMappedForExistingKeys() {
+    weak_hash_map<key_type, counted> map;
+    map[std::int64_t(1)].value = 5;
+    CHECK(counted::constructions == 1);
+
+    for (int round = 0; round < 10; ++round) {
+        map[1.0].value += 1;
+    }
+    CHECK(counted::constructions == 1);
+    CHECK(map[std::int64_t(1)].value == 15);
+
+    counted other;
+    CHECK(!map.try_emplace(key_type(std::int64_t(1)), other).second);
+    CHECK(counted::constructions == 2);
+    CHECK(map.try_emplace(key_type(std::int64_t(2)), other).second);
+    CHECK(counted::constructions == 3);
+}
+
+}
+
+int main() {
+    testHash();
+    testMixedKeys();
+    testSelfUnequalKeys();
+    testAgainstMap();
+    testErasedSlots();
+    testGrowthThrows();
+    testNoMappedForExistingKeys();
+
+    return check_result("weak_hash_map");
+}
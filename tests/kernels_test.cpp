@@ -0,0 +1,238 @@
+//
+// The operators of weak against the raw types and against weak_binary_table, the generic kernel table. Same type
+// pairs go through weak_same_type_path, compound assignments through weak_compound_table, and when built with
+// WEAK_SMALL_CODE every operator goes through the shared kernel tables instead.
+//
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "weak.h"
+#include "check.h"
+
+namespace {
+
+// has + and * with a double, but no compound assignment
+struct meters {
+    double length;
+};
+
+meters operator+(const meters& left, const meters& right) {
+    return meters{ left.length + right.length };
+}
+
+meters operator*(const meters& left, double right) {
+    return meters{ left.length * right };
+}
+
+meters operator*(double left, const meters& right) {
+    return meters{ left * right.length };
+}
+
+bool operator<(const meters& left, const meters& right) {
+    return left.length < right.length;
+}
+
+}
+
+// out of line, so its same type pairs aren't on the same type path
+template <>
+struct weak_is_inline<std::int64_t> : std::false_type {};
+
+namespace {
+
+typedef weak<int, std::int64_t, double, float, char, std::string, meters> var;
+
+// every type with a few values, and an invalid weak
+std::vector<var> values() {
+    return {
+            var(), 7, -3, std::int64_t(1) << 20, std::int64_t(-5), 2.5, -0.0, std::nan(""), 1.5f, -4.0f, 'a',
+            std::string("ab"), std::string(), meters{ 2.0 }, meters{ -1.0 }
+    };
+}
+
+// position of the type in var, and where the value is
+template <typename T, typename ... Ts>
+struct locate {
+    void operator() (const T& val, std::size_t& index, const void*& address) const {
+        index = get_type_index_impl<T, int, std::int64_t, double, float, char, std::string, meters>::value;
+        address = &val;
+    }
+};
+
+// Op through weak_binary_table, as weak without the same type path or WEAK_SMALL_CODE runs it
+template <typename Op, typename Result>
+Result fromTable(const var& left, const var& right) {
+    std::size_t leftIndex = 0, rightIndex = 0;
+    const void* leftAddress = nullptr;
+    const void* rightAddress = nullptr;
+    left.run<locate>(leftIndex, leftAddress);
+    right.run<locate>(rightIndex, rightAddress);
+
+    Result result = Result();
+    weak_binary_table<Op, Result, int, std::int64_t, double, float, char, std::string, meters>::lookup(
+            leftIndex, rightIndex)(leftAddress, rightAddress, &result);
+    return result;
+}
+
+// Op on the raw values, or Result() when the types don't have it
+template <typename V, typename T, typename Op, typename Result>
+struct raw_with {
+    void operator() (const V& right, const T& left, Result& result) const {
+        apply(left, right, result, typename Op::template defined<T, V>());
+    }
+
+    static void apply(const T& left, const V& right, Result& result, std::true_type) {
+        result = Op::apply(left, right);
+    }
+
+    static void apply(const T&, const V&, Result&, std::false_type) {}
+};
+
+template <typename T, typename Op, typename Result>
+struct raw_of {
+    void operator() (const T& left, const var& right, Result& result) const {
+        right.run<raw_with, T, Op, Result>(left, result);
+    }
+};
+
+template <typename Op, typename Result>
+Result fromRaw(const var& left, const var& right) {
+    Result result = Result();
+    left.run<raw_of, Op, Result>(right, result);
+    return result;
+}
+
+// same type and value, floating point numbers compared by their bits
+template <typename T, typename ... Ts>
+struct same_as {
+    void operator() (const T& val, const var& other, bool& same) const {
+        const T* otherVal = other.get_if<T>();
+        same = otherVal != nullptr && equal(val, *otherVal);
+    }
+
+    template <typename U>
+    static bool equal(const U& val, const U& other, typename std::enable_if<std::is_floating_point<U>::value>::type* = 0) {
+        return std::memcmp(&val, &other, sizeof(U)) == 0 || (std::isnan(val) && std::isnan(other));
+    }
+
+    template <typename U>
+    static bool equal(const U& val, const U& other, typename std::enable_if<!std::is_floating_point<U>::value>::type* = 0) {
+        return val == other;
+    }
+
+    static bool equal(const meters& val, const meters& other) {
+        return equal(val.length, other.length);
+    }
+};
+
+bool same(const var& left, const var& right) {
+    if (!left.isValid()) {
+        return !right.isValid();
+    }
+
+    bool same = false;
+    left.run<same_as>(right, same);
+    return same;
+}
+
+// left Op right, left Op= right and left Op= left all agree with the table and the raw types
+template <typename Op>
+void checkArithmetic(const var& left, const var& right, var (*op)(const var&, const var&),
+                     void (*assign)(var&, const var&)) {
+    var expected = fromRaw<Op, var>(left, right);
+    CHECK(same(fromTable<Op, var>(left, right), expected));
+    CHECK(same(op(left, right), expected));
+
+    var assigned = left;
+    assign(assigned, right);
+    CHECK(same(assigned, expected));
+
+    var self = left;
+    assign(self, self);
+    CHECK(same(self, fromRaw<Op, var>(left, left)));
+}
+
+template <typename Op>
+void checkComparison(const var& left, const var& right, bool (*op)(const var&, const var&)) {
+    bool expected = fromRaw<Op, bool>(left, right);
+    CHECK(fromTable<Op, bool>(left, right) == expected);
+    CHECK(op(left, right) == expected);
+}
+
+void testPairs() {
+    std::vector<var> all = values();
+
+    for (const var& left : all) {
+        for (const var& right : all) {
+            // integers divided by 0 would be undefined, none of the values is an integer 0
+            checkArithmetic<weak_addition>(left, right, [](const var& val, const var& val1) -> var { return val + val1; },
+                                           [](var& val, const var& val1) { val += val1; });
+            checkArithmetic<weak_subtraction>(left, right,
+                                              [](const var& val, const var& val1) -> var { return val - val1; },
+                                              [](var& val, const var& val1) { val -= val1; });
+            checkArithmetic<weak_multiplication>(left, right,
+                                                 [](const var& val, const var& val1) -> var { return val * val1; },
+                                                 [](var& val, const var& val1) { val *= val1; });
+            checkArithmetic<weak_division>(left, right,
+                                           [](const var& val, const var& val1) -> var { return val / val1; },
+                                           [](var& val, const var& val1) { val /= val1; });
+
+            checkComparison<weak_equal>(left, right, [](const var& val, const var& val1) { return val == val1; });
+            checkComparison<weak_not_equal>(left, right, [](const var& val, const var& val1) { return val != val1; });
+            checkComparison<weak_less_than>(left, right, [](const var& val, const var& val1) { return val < val1; });
+            checkComparison<weak_greater_than>(left, right,
+                                               [](const var& val, const var& val1) { return val > val1; });
+            checkComparison<weak_less_than_equal_to>(left, right,
+                                                     [](const var& val, const var& val1) { return val <= val1; });
+            checkComparison<weak_greater_than_equal_to>(left, right,
+                                                        [](const var& val, const var& val1) { return val >= val1; });
+        }
+    }
+}
+
+// the three kinds of compound assignment, each of which the pairs above run
+void testKinds() {
+    // not defined, invalidates
+    static_assert(weak_compound_kind<weak_addition, int, std::string>::value == 0, "");
+    static_assert(weak_compound_kind<weak_subtraction, std::string, std::string>::value == 0, "");
+    // a result of another type replaces the value
+    static_assert(weak_compound_kind<weak_addition, int, double>::value == 1, "");
+    static_assert(weak_compound_kind<weak_addition, char, char>::value == 1, "");
+    static_assert(weak_compound_kind<weak_multiplication, double, meters>::value == 1, "");
+    // in place, through += where the type has it and through + where it doesn't
+    static_assert(weak_compound_kind<weak_addition, double, int>::value == 2, "");
+    static_assert(weak_compound_kind<weak_addition, std::string, char>::value == 2, "");
+    static_assert(weak_compound_kind<weak_addition, meters, meters>::value == 2, "");
+    static_assert(weak_compound_kind<weak_multiplication, meters, double>::value == 2, "");
+    static_assert(!weak_addition::assignable<meters, meters>::value, "");
+
+    var length = meters{ 1.5 };
+    length *= var(2.0);
+    CHECK(length.isType<meters>() && length.value<meters>().length == 3.0);
+    length += length;
+    CHECK(length.isType<meters>() && length.value<meters>().length == 6.0);
+
+    var factor = 2.0;
+    factor *= var(meters{ 4.0 });
+    CHECK(factor.isType<meters>() && factor.value<meters>().length == 8.0);
+
+    var text = std::string("a");
+    text += var('b');
+    text += text;
+    CHECK(text.isType<std::string>() && text.value<std::string>() == "abab");
+    text -= var(1);
+    CHECK(!text.isValid());
+}
+
+}
+
+int main() {
+    testPairs();
+    testKinds();
+
+    return check_result("weak kernels");
+}
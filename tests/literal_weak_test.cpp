@@ -0,0 +1,89 @@
+//
+// literal_weak in constant expressions, checked by static_assert, and its run time side.
+//
+
+#include <cstdint>
+#include "literal_weak.h"
+#include "check.h"
+
+namespace {
+
+enum class mode : std::uint8_t { slow, fast };
+
+typedef literal_weak<int, double, char, mode> setting;
+
+constexpr setting none;
+constexpr setting three = 3;
+constexpr setting half = 0.5;
+constexpr setting letter = 'a';
+constexpr setting fast = mode::fast;
+
+constexpr setting table[] = { 3, 0.5, 'a', mode::fast, setting() };
+
+// construction and inspection
+static_assert(!none.isValid() && three.isValid(), "");
+static_assert(three.isType<int>() && !three.isType<double>() && !none.isType<int>(), "");
+static_assert(three.value<int>() == 3 && half.value<double>() == 0.5 && letter.value<char>() == 'a', "");
+static_assert(fast.isType<mode>() && fast.value<mode>() == mode::fast, "");
+static_assert(table[1].isType<double>() && !table[4].isValid(), "");
+
+// arithmetic gives the type the raw types would
+static_assert((three + three).isType<int>() && (three + three).value<int>() == 6, "");
+static_assert((three * half).isType<double>() && (three * half).value<double>() == 1.5, "");
+static_assert((letter + letter).isType<int>() && (letter + letter).value<int>() == 'a' + 'a', "");
+static_assert((half - three).value<double>() == -2.5 && (three / half).value<double>() == 6.0, "");
+static_assert((table[0] * table[1]).value<double>() == 1.5, "");
+
+// mixed comparisons compare the values
+static_assert(three == setting(3.0) && three != half && half < three && three > letter - letter, "");
+static_assert(half <= half && three >= setting(3.0) && !(three < half), "");
+static_assert(fast == setting(mode::fast) && fast != setting(mode::slow), "");
+
+// an enum class has no arithmetic and no comparison with numbers, and nothing works on an invalid literal_weak
+static_assert(!(fast + three).isValid() && !(fast * fast).isValid(), "");
+static_assert(!(fast == three) && !(fast != three) && !(fast < three), "");
+static_assert(!(none + three).isValid() && !(three - none).isValid() && !(none == none), "");
+
+template <typename T, typename ... Ts>
+struct doubled {
+    void operator() (const T& val, double& result) const {
+        result = 2 * double(val);
+    }
+};
+
+template <typename ... Ts>
+struct doubled<mode, Ts...> {
+    void operator() (const mode&, double& result) const {
+        result = -1;
+    }
+};
+
+void testRunTime() {
+    double result = 0;
+    table[1].run<doubled>(result);
+    CHECK(result == 1.0);
+    table[3].run<doubled>(result);
+    CHECK(result == -1.0);
+
+    weak<int, double, char, mode> converted = three * half;
+    CHECK(converted.isType<double>() && converted.value<double>() == 1.5);
+    CHECK(!weak<int, double, char, mode>(none).isValid());
+
+    setting changed = three;
+    changed += half;
+    CHECK(changed.isType<double>() && changed.value<double>() == 3.5);
+    changed *= setting(mode::fast);
+    CHECK(!changed.isValid());
+
+    changed.emplace('b');
+    changed.value<char>() = 'c';
+    CHECK(changed == setting('c'));
+}
+
+}
+
+int main() {
+    testRunTime();
+
+    return check_result("literal_weak");
+}
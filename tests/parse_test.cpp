@@ -0,0 +1,228 @@
+//
+// weak_parse's numbers against strtod and strtof, which types tokens go into, and weak_parse_fields.
+//
+
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "weak_parse.h"
+#include "check.h"
+
+namespace {
+
+typedef weak<std::int64_t, double, std::string> var;
+
+std::uint64_t state = 88172645463325252u;
+
+std::uint64_t next() {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+template <typename T>
+bool sameBits(T left, T right) {
+    return std::memcmp(&left, &right, sizeof(T)) == 0 || (std::isnan(left) && std::isnan(right));
+}
+
+bool integerShaped(const std::string& token) {
+    std::size_t first = !token.empty() && (token[0] == '-' || token[0] == '+') ? 1 : 0;
+    return first < token.size() && token.find_first_not_of("0123456789", first) == std::string::npos;
+}
+
+// what the token should parse to: an int64 if it is an integer strtoll takes whole, else a double if strtod takes
+// the whole token, else the text. strtod skips leading spaces and reads hexadecimal, neither of which are numbers here.
+void checkToken(const std::string& token) {
+    var parsed;
+    bool ok = weak_parse(token.data(), token.data() + token.size(), parsed);
+
+    if (token.empty()) {
+        CHECK(!ok && !parsed.isValid());
+        return;
+    }
+    CHECK(ok);
+
+    const char* start = token.c_str();
+    char* end = nullptr;
+
+    errno = 0;
+    long long integer = std::strtoll(start, &end, 10);
+    if (integerShaped(token) && errno != ERANGE && end == start + token.size()) {
+        const std::int64_t* val = parsed.get_if<std::int64_t>();
+        CHECK(val != nullptr && *val == integer);
+        if (val == nullptr || *val != integer) {
+            std::fprintf(stderr, "  token %s\n", start);
+        }
+        return;
+    }
+
+    double floating = std::strtod(start, &end);
+    bool hexadecimal = token.find_first_of("xX") != std::string::npos;
+    if (end == start + token.size() && !hexadecimal && !std::isspace(static_cast<unsigned char>(token[0]))) {
+        const double* val = parsed.get_if<double>();
+        CHECK(val != nullptr && sameBits(*val, floating));
+        if (val == nullptr || !sameBits(*val, floating)) {
+            std::fprintf(stderr, "  token %s: strtod %.17g\n", start, floating);
+        }
+        return;
+    }
+
+    const std::string* text = parsed.get_if<std::string>();
+    CHECK(text != nullptr && *text == token);
+    if (text == nullptr || *text != token) {
+        std::fprintf(stderr, "  token %s should be text\n", start);
+    }
+}
+
+void testTokens() {
+    const char* const tokens[] = {
+            "", "0", "-0", "+0", "00012", "-1", "+7",
+            "9223372036854775807", "-9223372036854775808", "9223372036854775808", "-9223372036854775809",
+            "18446744073709551616", "123456789012345678901234567890", "9007199254740993",
+            "0.0", "-0.0", ".5", "5.", "-.5", "0.1", "1e10", "1E+10", "1e-10", "2.5e0",
+            "1.7976931348623157e308", "1.7976931348623159e308", "1e309", "-1e309",
+            "4.9e-324", "2.4703282292062328e-324", "2.4703282292062327e-324", "1e-400",
+            "2.2250738585072011e-308", "2.2250738585072014e-308",
+            "9007199254740992.5", "9007199254740993.0", "0.30000000000000004",
+            // 219 digits, far more than the mantissa keeps, and 1 written with 45 zeros before its digit
+            "1797693134862315807937289714053034150799341327100378269361737789804449682927647509466490179775872070"
+            "9633028641669288791094655554785194040263065748867150582068190890200070838367627385484581771153170674"
+            "2417446193860224516.0",
+            "0.000000000000000000000000000000000000000000001e45",
+            "inf", "-inf", "INF", "Infinity", "-infinity", "nan", "NaN", "-nan",
+            "infin", "nana", "1e", "1e+", "e5", ".", "-", "+", "--1", "1.2.3", "1..2", " 1", "1 ", "1,5",
+            "0x10", "0X1p4", "abc", "true",
+    };
+
+    for (const char* token : tokens) {
+        checkToken(token);
+    }
+}
+
+// random tokens shaped like numbers, from short integers to long mantissas with large exponents
+void testRandomTokens() {
+    char buffer[64];
+
+    for (int round = 0; round < 200000; ++round) {
+        std::string token;
+        if (next() % 4 == 0) {
+            token += next() % 2 == 0 ? "-" : "+";
+        }
+
+        std::size_t digits = next() % 26;
+        for (std::size_t i = 0; i < digits; ++i) {
+            token += char('0' + next() % 10);
+        }
+
+        if (next() % 2 == 0) {
+            token += '.';
+            for (std::size_t i = next() % 20; i > 0; --i) {
+                token += char('0' + next() % 10);
+            }
+        }
+
+        if (next() % 2 == 0) {
+            std::snprintf(buffer, sizeof(buffer), "e%d", int(next() % 700) - 350);
+            token += buffer;
+        }
+
+        checkToken(token);
+    }
+
+    // the shortest and the full round trip forms of random doubles
+    for (int round = 0; round < 200000; ++round) {
+        std::uint64_t bits = next();
+        double val;
+        std::memcpy(&val, &bits, sizeof(double));
+        if (!std::isfinite(val)) {
+            continue;
+        }
+
+        std::snprintf(buffer, sizeof(buffer), round % 2 == 0 ? "%.17g" : "%.15g", val);
+        checkToken(buffer);
+    }
+}
+
+// the first floating point type gets the token when it is a float, as strtof would give it
+void testFloat() {
+    char buffer[64];
+
+    for (int round = 0; round < 100000; ++round) {
+        std::uint32_t bits = static_cast<std::uint32_t>(next());
+        float val;
+        std::memcpy(&val, &bits, sizeof(float));
+        if (!std::isfinite(val)) {
+            continue;
+        }
+
+        std::snprintf(buffer, sizeof(buffer), round % 2 == 0 ? "%.9g" : "%.20g", double(val));
+
+        weak<float, std::string> parsed;
+        CHECK(weak_parse(buffer, buffer + std::strlen(buffer), parsed));
+
+        const float* parsedVal = parsed.get_if<float>();
+        CHECK(parsedVal != nullptr && sameBits(*parsedVal, std::strtof(buffer, nullptr)));
+    }
+}
+
+void testTypes() {
+    const char token[] = "200";
+
+    // the first integer type that holds it
+    weak<std::int8_t, std::uint8_t, std::int64_t> small;
+    CHECK(weak_parse(token, token + 3, small) && small.isType<std::uint8_t>());
+
+    const char negative[] = "-1";
+    weak<std::uint8_t, std::int16_t> sign;
+    CHECK(weak_parse(negative, negative + 2, sign) && sign.isType<std::int16_t>());
+
+    // an integer no integer type holds is a floating point number, or nothing
+    const char large[] = "300";
+    weak<std::uint8_t, double> wide;
+    CHECK(weak_parse(large, large + 3, wide) && wide.isType<double>());
+
+    weak<std::uint8_t> none = std::uint8_t(1);
+    CHECK(!weak_parse(large, large + 3, none) && !none.isValid());
+
+    // bool and characters are not numbers
+    weak<bool, char, std::string> text;
+    CHECK(weak_parse(token, token + 3, text) && text.isType<std::string>());
+}
+
+void testFields() {
+    const std::string line = "1,2.5,abc,,-3\r\n4\n";
+    std::vector<var> fields;
+    weak_parse_fields<var>(line.data(), line.data() + line.size(), ',', std::back_inserter(fields));
+
+    CHECK(fields.size() == 6u);
+    if (fields.size() != 6u) {
+        return;
+    }
+
+    CHECK(fields[0].isType<std::int64_t>() && fields[0].value<std::int64_t>() == 1);
+    CHECK(fields[1].isType<double>() && fields[1].value<double>() == 2.5);
+    CHECK(fields[2].isType<std::string>() && fields[2].value<std::string>() == "abc");
+    CHECK(!fields[3].isValid());
+    CHECK(fields[4].isType<std::int64_t>() && fields[4].value<std::int64_t>() == -3);
+    CHECK(fields[5].isType<std::int64_t>() && fields[5].value<std::int64_t>() == 4);
+}
+
+}
+
+int main() {
+    testTokens();
+    testRandomTokens();
+    testFloat();
+    testTypes();
+    testFields();
+
+    return check_result("weak_parse");
+}
@@ -0,0 +1,270 @@
+//
+// Values shared through weak_is_shared: copies share one block, writes detach first, and the last owner frees it.
+//
+
+#include <memory>
+#include <utility>
+#include "weak.h"
+#include "check.h"
+
+namespace {
+
+// counts its instances and how many were copied from another
+struct tracked {
+    static int live;
+    static int copies;
+
+    int n;
+
+    explicit tracked(int n) : n(n) {
+        ++live;
+    }
+
+    tracked(const tracked& other) : n(other.n) {
+        ++live;
+        ++copies;
+    }
+
+    tracked(tracked&& other) noexcept : n(other.n) {
+        ++live;
+    }
+
+    tracked& operator=(const tracked&) = default;
+
+    tracked& operator+=(const tracked& other) {
+        n += other.n;
+        return *this;
+    }
+
+    ~tracked() {
+        --live;
+    }
+};
+
+int tracked::live = 0;
+int tracked::copies = 0;
+
+tracked operator+(const tracked& left, const tracked& right) {
+    return tracked(left.n + right.n);
+}
+
+int blocks = 0;
+int freed = 0;
+
+// counts the blocks shared values live in
+template <typename T>
+struct counting_allocator {
+    typedef T value_type;
+
+    counting_allocator() noexcept {}
+
+    template <typename U>
+    counting_allocator(const counting_allocator<U>&) noexcept {}
+
+    T* allocate(std::size_t n) {
+        ++blocks;
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* ptr, std::size_t n) noexcept {
+        ++freed;
+        std::allocator<T>().deallocate(ptr, n);
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const counting_allocator<T>&, const counting_allocator<U>&) noexcept {
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const counting_allocator<T>&, const counting_allocator<U>&) noexcept {
+    return false;
+}
+
+}
+
+template <>
+struct weak_is_shared<tracked> : std::true_type {};
+
+template <>
+struct weak_allocator<tracked> {
+    typedef counting_allocator<tracked> type;
+};
+
+namespace {
+
+typedef weak<int, tracked> var;
+
+// where the value of a weak lives, read without detaching it
+const tracked* at(const var& val) {
+    return &val.value<tracked>();
+}
+
+template <typename T, typename ... Ts>
+struct set_to {
+    void operator() (T& val, int n) const {
+        val = T(n);
+    }
+};
+
+// reads either alternative through weak_visit
+struct number {
+    int operator() (const tracked& val) const {
+        return val.n;
+    }
+
+    int operator() (const int& val) const {
+        return val;
+    }
+};
+
+// sets a tracked value through weak_visit, ignores ints
+struct set_tracked {
+    int n;
+
+    void operator() (tracked& val) const {
+        val.n = n;
+    }
+
+    void operator() (int&) const {}
+};
+
+template <typename T, typename ... Ts>
+struct read {
+    void operator() (const T&, int& reads) const {
+        ++reads;
+    }
+};
+
+void testCopies() {
+    var original = tracked(1);
+    CHECK(blocks == 1 && tracked::copies == 0);
+
+    var copy = original;
+    var assigned;
+    assigned = copy;
+
+    CHECK(tracked::copies == 0 && blocks == 1 && tracked::live == 1);
+    CHECK(at(copy) == at(original) && at(assigned) == at(original));
+
+    // const access never detaches
+    const var& constant = copy;
+    int reads = 0;
+    constant.run<read>(reads);
+    CHECK(constant.get_if<tracked>() == at(original) && constant.value<tracked>().n == 1 && reads == 1);
+    CHECK(weak_visit(number(), constant) == 1);
+    CHECK(tracked::copies == 0 && at(copy) == at(original));
+}
+
+// each non const access to a shared value copies it once, then changes only that copy
+void testDetach() {
+    var original = tracked(1);
+
+    var byValue = original;
+    byValue.value<tracked>().n = 2;
+    CHECK(tracked::copies == 1 && at(byValue) != at(original));
+
+    // no longer shared, so no second copy
+    byValue.value<tracked>().n = 3;
+    CHECK(tracked::copies == 1);
+
+    var byGetIf = original;
+    byGetIf.get_if<tracked>() -> n = 4;
+    CHECK(tracked::copies == 2 && at(byGetIf) != at(original));
+
+    var byRun = original;
+    byRun.run<set_to>(5);
+    CHECK(tracked::copies == 3 && at(byRun) != at(original));
+
+    var byVisit = original;
+    weak_visit(set_tracked{ 6 }, byVisit);
+    CHECK(tracked::copies == 4 && at(byVisit) != at(original));
+
+    CHECK(at(original) -> n == 1);
+    CHECK(byValue.value<tracked>().n == 3 && byGetIf.value<tracked>().n == 4);
+    CHECK(byRun.value<tracked>().n == 5 && byVisit.value<tracked>().n == 6);
+
+    // the one owner of a value changes it in place
+    var alone = tracked(7);
+    const tracked* before = at(alone);
+    alone.value<tracked>().n = 8;
+    CHECK(at(alone) == before);
+    alone += var(tracked(1));
+    CHECK(alone.value<tracked>().n == 9);
+}
+
+// a compound assignment replaces this weak's reference with the result, the other holders see nothing
+void testCompound() {
+    var original = tracked(10);
+    var copy = original;
+
+    copy += var(tracked(5));
+    CHECK(copy.isType<tracked>() && copy.value<tracked>().n == 15);
+    CHECK(at(original) -> n == 10 && at(copy) != at(original));
+
+    // an operation the types don't have invalidates only this weak
+    var other = original;
+    other += var(1);
+    CHECK(!other.isValid() && at(original) -> n == 10);
+
+    // with itself as the operand, while shared
+    var twice = original;
+    twice += twice;
+    CHECK(twice.value<tracked>().n == 20 && at(original) -> n == 10);
+}
+
+void testMoves() {
+    var original = tracked(1);
+    var copy = original;
+    const tracked* shared = at(original);
+    int copies = tracked::copies;
+
+    var moved = std::move(copy);
+    CHECK(at(moved) == shared && !copy.isValid());
+
+    var assigned;
+    assigned = std::move(moved);
+    CHECK(at(assigned) == shared && !moved.isValid());
+
+    // dropping one holder leaves the value to the others
+    {
+        var scoped = original;
+    }
+    CHECK(at(original) == shared && at(original) -> n == 1);
+
+    CHECK(tracked::copies == copies);
+}
+
+// the block goes with the last of its holders, once
+void testLastOwner() {
+    int before = freed;
+    {
+        var first = tracked(3);
+        int live = tracked::live;
+        {
+            var second = first;
+            {
+                var third = second;
+                first = 4;
+            }
+            CHECK(freed == before && tracked::live == live);
+        }
+        CHECK(freed == before + 1 && tracked::live == live - 1);
+    }
+    CHECK(freed == before + 1);
+}
+
+}
+
+int main() {
+    testCopies();
+    testDetach();
+    testCompound();
+    testMoves();
+    testLastOwner();
+
+    CHECK(tracked::live == 0 && freed == blocks);
+
+    return check_result("weak_is_shared");
+}
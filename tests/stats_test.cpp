@@ -0,0 +1,84 @@
+//
+// The type transitions WEAK_STATS counts for emplaces, copies and moves.
+//
+
+#define WEAK_STATS
+
+#include <string>
+#include "weak.h"
+#include "check.h"
+
+namespace {
+
+typedef weak<int, double, std::string> var;
+
+typedef weak_stats<int, double, std::string> stats;
+
+// the transitions from the type at from to the type at to since before
+std::uint64_t transitions(const stats::counts& before, std::size_t from, std::size_t to) {
+    return stats::collect().transitions[from][to] - before.transitions[from][to];
+}
+
+std::uint64_t emplaces(const stats::counts& before, std::size_t to) {
+    return stats::collect().emplaces[to] - before.emplaces[to];
+}
+
+void testCopies() {
+    var number = 1;
+    var text = std::string("text");
+
+    stats::counts before = stats::collect();
+    var copied = text;
+    CHECK(transitions(before, 0, 3) == 1u);
+
+    // an int replaced by a copy of a string changes from index 1 to 3, not from the invalid type
+    before = stats::collect();
+    var assigned = 2;
+    assigned = text;
+    CHECK(transitions(before, 0, 1) == 1u);
+    CHECK(transitions(before, 1, 3) == 1u);
+    CHECK(transitions(before, 0, 3) == 0u);
+
+    before = stats::collect();
+    assigned = number;
+    CHECK(transitions(before, 3, 1) == 1u);
+    CHECK(emplaces(before, 1) == 1u);
+
+    // assigning an invalid weak stores nothing
+    before = stats::collect();
+    assigned = var();
+    CHECK(emplaces(before, 0) == 0u);
+
+    CHECK(copied == text);
+}
+
+void testMoves() {
+    var text = std::string("text");
+
+    stats::counts before = stats::collect();
+    var moved = std::move(text);
+    CHECK(transitions(before, 0, 3) == 1u);
+    // moving a std::string out of line allocates nothing new
+    CHECK(stats::collect().allocations == before.allocations);
+
+    before = stats::collect();
+    var assigned = 2.5;
+    assigned = std::move(moved);
+    CHECK(transitions(before, 0, 2) == 1u);
+    CHECK(transitions(before, 2, 3) == 1u);
+    CHECK(emplaces(before, 3) == 1u);
+
+    before = stats::collect();
+    var number = 7;
+    assigned = std::move(number);
+    CHECK(transitions(before, 3, 1) == 1u);
+}
+
+}
+
+int main() {
+    testCopies();
+    testMoves();
+
+    return check_result("weak_stats");
+}
@@ -0,0 +1,184 @@
+//
+// weak_string at the boundary between its inline and heap storage, and appending or assigning parts of itself.
+//
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include "weak_string.h"
+#include "check.h"
+
+namespace {
+
+std::size_t allocations = 0;
+
+}
+
+void* operator new(std::size_t size) {
+    ++allocations;
+    if (void* allocated = std::malloc(size == 0 ? 1 : size)) {
+        return allocated;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* allocated) noexcept {
+    std::free(allocated);
+}
+
+void operator delete(void* allocated, std::size_t) noexcept {
+    std::free(allocated);
+}
+
+namespace {
+
+// the chars, their size and the terminating zero all agree with expected
+bool holds(const weak_string& val, const std::string& expected) {
+    return val.size() == expected.size() && std::memcmp(val.data(), expected.data(), expected.size()) == 0 &&
+           val.c_str()[expected.size()] == '\0' && val.str() == expected;
+}
+
+void testBoundary() {
+    CHECK(sizeof(weak_string) == 24u);
+
+    const std::string full(23, 'a'), over(24, 'b');
+
+    std::size_t before = allocations;
+    weak_string inlined(full);
+    CHECK(allocations == before);
+    CHECK(inlined.isInline() && inlined.capacity() == 23u && holds(inlined, full));
+
+    before = allocations;
+    weak_string heap(over);
+    CHECK(allocations == before + 1);
+    CHECK(!heap.isInline() && heap.capacity() >= 24u && holds(heap, over));
+
+    // growing one char at a time moves to the heap at the 24th
+    weak_string grown(std::string(22, 'c'));
+    grown.push_back('c');
+    CHECK(grown.isInline() && holds(grown, std::string(23, 'c')));
+    grown += 'c';
+    CHECK(!grown.isInline() && holds(grown, std::string(24, 'c')));
+
+    // and shrinking keeps the heap block, while a new short string is inline again
+    grown.assign("short", 5);
+    CHECK(!grown.isInline() && holds(grown, "short"));
+    CHECK(weak_string(grown).isInline());
+
+    weak_string empty;
+    CHECK(empty.isInline() && empty.empty() && holds(empty, ""));
+
+    weak_string zeros("a\0b", 3);
+    CHECK(holds(zeros, std::string("a\0b", 3)));
+
+    // reserving within the inline capacity does nothing, beyond it moves to the heap
+    weak_string reserved("abc");
+    reserved.reserve(23);
+    CHECK(reserved.isInline());
+    reserved.reserve(24);
+    CHECK(!reserved.isInline() && reserved.capacity() >= 24u && holds(reserved, "abc"));
+}
+
+void testSelfAppend() {
+    // inline to inline, inline to heap, exactly 23 to 46, and heap to heap with and without room
+    const std::size_t sizes[] = { 0, 1, 11, 12, 23, 24, 40 };
+
+    for (std::size_t size : sizes) {
+        std::string expected;
+        for (std::size_t i = 0; i < size; ++i) {
+            expected += char('a' + i % 26);
+        }
+
+        weak_string doubled(expected);
+        doubled += doubled;
+        CHECK(holds(doubled, expected + expected));
+        CHECK(doubled.isInline() == (2 * size <= 23));
+
+        weak_string roomy(expected);
+        roomy.reserve(4 * size + 24);
+        roomy.append(roomy.data(), roomy.size());
+        CHECK(holds(roomy, expected + expected));
+
+        // part of itself, starting inside it
+        if (size >= 3) {
+            weak_string part(expected);
+            part.append(part.data() + 1, size - 2);
+            CHECK(holds(part, expected + expected.substr(1, size - 2)));
+
+            weak_string assigned(expected);
+            assigned.assign(assigned.data() + 2, size - 3);
+            CHECK(holds(assigned, expected.substr(2, size - 3)));
+        }
+
+        weak_string copied(expected);
+        weak_string& self = copied;
+        copied = self;
+        CHECK(holds(copied, expected));
+
+        copied = std::move(self);
+        CHECK(holds(copied, expected));
+
+        CHECK(holds(weak_string(expected) + weak_string(expected), expected + expected));
+    }
+}
+
+void testMoves() {
+    weak_string heap(std::string(40, 'h'));
+
+    std::size_t before = allocations;
+    weak_string moved(std::move(heap));
+    CHECK(allocations == before);
+    CHECK(holds(moved, std::string(40, 'h')) && heap.empty() && heap.isInline());
+
+    weak_string inlined("inline");
+    moved = std::move(inlined);
+    CHECK(holds(moved, "inline") && moved.isInline() && inlined.empty());
+}
+
+void testCompare() {
+    CHECK(weak_string("abc") < weak_string("abd"));
+    CHECK(weak_string("ab") < weak_string("abc"));
+    CHECK(weak_string(std::string(24, 'z')) > weak_string(std::string(23, 'z')));
+    CHECK(weak_string(std::string(24, 'z')) == weak_string(std::string(24, 'z')));
+    CHECK(weak_string("\xff") > weak_string("a"));
+    CHECK(weak_string("abc") == "abc" && weak_string("abc") != "ab");
+
+    // with the C string on either side, and a null one as empty
+    const char* none = nullptr;
+    CHECK("abc" == weak_string("abc") && "abd" != weak_string("abc") && "ab" != weak_string("abc"));
+    CHECK(weak_string() == none && none == weak_string() && !(weak_string() != none));
+    CHECK(weak_string("a") != none && none != weak_string("a"));
+    CHECK(std::string(30, 'q').c_str() == weak_string(std::string(30, 'q')));
+}
+
+// inline up to 23 chars, so a weak holding one copies without allocating
+void testInWeak() {
+    typedef weak<int, weak_string> var;
+
+    var full = weak_string(std::string(23, 'w'));
+    std::size_t before = allocations;
+    var copy = full;
+    CHECK(allocations == before);
+    CHECK(copy.isType<weak_string>() && holds(copy.value<weak_string>(), std::string(23, 'w')));
+
+    var over = weak_string(std::string(24, 'w'));
+    before = allocations;
+    var overCopy = over;
+    CHECK(allocations == before + 1);
+    CHECK(holds(overCopy.value<weak_string>(), std::string(24, 'w')));
+
+    CHECK(full.value<weak_string>() != over.value<weak_string>());
+}
+
+}
+
+int main() {
+    testBoundary();
+    testSelfAppend();
+    testMoves();
+    testCompare();
+    testInWeak();
+
+    return check_result("weak_string");
+}
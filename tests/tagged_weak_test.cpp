@@ -0,0 +1,178 @@
+//
+// tagged_weak with as many types as its tag bits hold, and emplaces that throw.
+//
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include "tagged_weak.h"
+#include "check.h"
+
+namespace {
+
+// the number of allocations that succeed before one throws, or -1 for all of them
+int allocationsLeft = -1;
+
+}
+
+void* operator new(std::size_t size) {
+    if (allocationsLeft == 0) {
+        throw std::bad_alloc();
+    }
+    if (allocationsLeft > 0) {
+        --allocationsLeft;
+    }
+
+    if (void* allocated = std::malloc(size == 0 ? 1 : size)) {
+        return allocated;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* allocated) noexcept {
+    std::free(allocated);
+}
+
+void operator delete(void* allocated, std::size_t) noexcept {
+    std::free(allocated);
+}
+
+namespace {
+
+// a distinct one byte type for each N
+template <int N>
+struct small {
+    char c;
+};
+
+// 15 types and the invalid one need all 4 tag bits, and blocks aligned to 16
+typedef tagged_weak<small<1>, small<2>, small<3>, small<4>, small<5>, small<6>, small<7>, small<8>, small<9>,
+                    small<10>, small<11>, small<12>, std::max_align_t, double, std::string> full;
+
+static_assert(sizeof(full) == sizeof(void*), "a tagged_weak is one pointer");
+
+template <typename T, typename ... Ts>
+struct aligned {
+    void operator() (const T& val, bool& ok) const {
+        ok = reinterpret_cast<std::uintptr_t>(&val) % 16 == 0;
+    }
+};
+
+template <int N>
+void checkSmall() {
+    full val = small<N>{ char(N) };
+    bool ok = false;
+    val.template run<aligned>(ok);
+
+    CHECK(ok && val.template isType<small<N>>() && val.template value<small<N>>().c == char(N));
+}
+
+void testAllTags() {
+    checkSmall<1>();
+    checkSmall<2>();
+    checkSmall<5>();
+    checkSmall<8>();
+    checkSmall<12>();
+
+    // the last index, 15, is every tag bit set
+    full last = std::string("last");
+    CHECK(last.isType<std::string>() && last.value<std::string>() == "last");
+    CHECK(!last.isType<small<1>>() && !last.isType<small<7>>());
+
+    full widest = std::max_align_t();
+    bool ok = false;
+    widest.run<aligned>(ok);
+    CHECK(ok && widest.isType<std::max_align_t>());
+
+    full sum = full(1.5) + full(2.0);
+    CHECK(sum.isType<double>() && sum.value<double>() == 3.5);
+
+    full moved = std::move(last);
+    CHECK(!last.isValid() && moved.value<std::string>() == "last");
+
+    full copied = moved;
+    CHECK(copied.value<std::string>() == "last" && copied.get_if<std::string>() != moved.get_if<std::string>());
+
+    full& self = copied;
+    copied = self;
+    copied = std::move(self);
+    CHECK(copied.value<std::string>() == "last");
+}
+
+// throws when copied while armed
+struct fragile {
+    static bool armed;
+
+    int n;
+
+    fragile(int n) : n(n) {}
+
+    fragile(const fragile& other) : n(other.n) {
+        if (armed) {
+            throw std::runtime_error("copy");
+        }
+    }
+};
+
+bool fragile::armed = false;
+
+typedef tagged_weak<int, fragile, std::string> tagged;
+
+// a throwing constructor or allocation leaves the old value, and the sanitizers see no block leak
+void testThrowingEmplace() {
+    tagged val = std::string("kept");
+    fragile source(3);
+
+    fragile::armed = true;
+    bool threw = false;
+    try {
+        val.emplace(source);
+    }
+    catch (const std::runtime_error&) {
+        threw = true;
+    }
+    fragile::armed = false;
+
+    CHECK(threw && val.isType<std::string>() && val.value<std::string>() == "kept");
+
+    allocationsLeft = 0;
+    threw = false;
+    try {
+        val = 5;
+    }
+    catch (const std::bad_alloc&) {
+        threw = true;
+    }
+    allocationsLeft = -1;
+
+    CHECK(threw && val.isType<std::string>() && val.value<std::string>() == "kept");
+
+    // and copying a weak whose copy throws leaves the target invalid rather than half built
+    tagged holder = source;
+    tagged target = 1;
+    fragile::armed = true;
+    threw = false;
+    try {
+        target = holder;
+    }
+    catch (const std::runtime_error&) {
+        threw = true;
+    }
+    fragile::armed = false;
+
+    CHECK(threw && !target.isValid() && holder.value<fragile>().n == 3);
+
+    val.emplace(source);
+    CHECK(val.isType<fragile>() && val.value<fragile>().n == 3);
+}
+
+}
+
+int main() {
+    testAllTags();
+    testThrowingEmplace();
+
+    return check_result("tagged_weak");
+}
@@ -0,0 +1,161 @@
+//
+// weak_visit over several operands of different representations, every combination of their types, and invalid ones.
+//
+
+#include <string>
+#include <vector>
+#include "weak.h"
+#include "tagged_weak.h"
+#include "boxed_weak.h"
+#include "check.h"
+
+namespace {
+
+typedef weak<int, double, std::string> first_type;
+typedef tagged_weak<char, std::string> second_type;
+typedef boxed_weak<float, int> third_type;
+
+std::string name(int) { return "int"; }
+std::string name(double) { return "double"; }
+std::string name(float) { return "float"; }
+std::string name(char) { return "char"; }
+std::string name(const std::string&) { return "string"; }
+
+// the types it was called with, and how often
+struct record {
+    int* calls;
+
+    template <typename A, typename B, typename C>
+    std::string operator() (const A& a, const B& b, const C& c) const {
+        ++*calls;
+        return name(a) + "," + name(b) + "," + name(c);
+    }
+};
+
+// invalid first, so that index i of these is type index i
+std::vector<first_type> firsts() {
+    return { first_type(), 1, 2.0, std::string("s") };
+}
+
+std::vector<second_type> seconds() {
+    return { second_type(), 'c', std::string("t") };
+}
+
+std::vector<third_type> thirds() {
+    return { third_type(), 1.5f, 3 };
+}
+
+// every combination dispatches to the functor with those types, any invalid operand to none
+void testCombinations() {
+    const char* const firstNames[] = { "", "int", "double", "string" };
+    const char* const secondNames[] = { "", "char", "string" };
+    const char* const thirdNames[] = { "", "float", "int" };
+
+    std::vector<first_type> first = firsts();
+    std::vector<second_type> second = seconds();
+    // const, so that the functor sees the value rather than boxed_weak's write back proxy
+    const std::vector<third_type> third = thirds();
+
+    for (std::size_t i = 0; i < first.size(); ++i) {
+        for (std::size_t j = 0; j < second.size(); ++j) {
+            for (std::size_t k = 0; k < third.size(); ++k) {
+                int calls = 0;
+                std::string visited = weak_visit(record{ &calls }, first[i], second[j], third[k]);
+
+                if (i == 0 || j == 0 || k == 0) {
+                    CHECK(calls == 0 && visited.empty());
+                }
+                else {
+                    CHECK(calls == 1);
+                    CHECK(visited == std::string(firstNames[i]) + "," + secondNames[j] + "," + thirdNames[k]);
+                }
+            }
+        }
+    }
+}
+
+// adds up numbers, a result type common to int, float and double
+struct sum {
+    template <typename A, typename B>
+    auto operator() (const A& a, const B& b) const -> decltype(a + b) {
+        return a + b;
+    }
+
+    double operator() (const std::string&, float) const {
+        return -1;
+    }
+
+    double operator() (const std::string&, int) const {
+        return -2;
+    }
+};
+
+void testCommonResult() {
+    first_type number = 2, text = std::string("x"), none;
+    const third_type half = 0.5f, three = 3;
+
+    CHECK(weak_visit(sum(), number, half) == 2.5);
+    CHECK(weak_visit(sum(), number, three) == 5.0);
+    CHECK(weak_visit(sum(), text, half) == -1.0);
+    CHECK(weak_visit(sum(), text, three) == -2.0);
+    CHECK(weak_visit(sum(), none, three) == 0.0);
+    CHECK(weak_visit(sum(), number, static_cast<const third_type&>(third_type())) == 0.0);
+}
+
+// doubles both values, non const operands of each representation write back. boxed_weak passes a proxy that converts to
+// T&, so the second operand is taken as each concrete type rather than deduced.
+struct twice {
+    template <typename A>
+    static void grow(A& val) {
+        val = val + val;
+    }
+
+    static void grow(std::string& val) {
+        val += val;
+    }
+
+    template <typename A>
+    void operator() (A& a, float& b) const {
+        grow(a);
+        grow(b);
+    }
+
+    template <typename A>
+    void operator() (A& a, int& b) const {
+        grow(a);
+        grow(b);
+    }
+
+    template <typename A>
+    void operator() (A& a, std::string& b) const {
+        grow(a);
+        grow(b);
+    }
+};
+
+void testWriteBack() {
+    first_type number = 2;
+    third_type boxed = 1.5f;
+    weak_visit(twice(), number, boxed);
+    CHECK(number.value<int>() == 4 && boxed.value<float>() == 3.0f);
+
+    first_type text = std::string("ab");
+    tagged_weak<int, std::string> tagged = std::string("c");
+    weak_visit(twice(), text, tagged);
+    CHECK(text.value<std::string>() == "abab" && tagged.value<std::string>() == "cc");
+
+    // nothing changes when one is invalid
+    first_type none;
+    weak_visit(twice(), none, boxed);
+    CHECK(boxed.value<float>() == 3.0f);
+}
+
+}
+
+int main() {
+    testCombinations();
+    testCommonResult();
+    testWriteBack();
+
+    return check_result("weak_visit");
+}
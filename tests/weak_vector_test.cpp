@@ -0,0 +1,217 @@
+//
+// weak_vector against a std::vector of weak values, through changes of type that move values between columns and
+// compound assignments through its reference proxies.
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "weak_vector.h"
+#include "check.h"
+
+namespace {
+
+typedef weak<int, double, std::string> var;
+typedef weak_vector<int, double, std::string> vector;
+
+std::uint64_t state = 88172645463325252u;
+
+std::uint64_t next() {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// small numbers, never 0, and short strings, or an invalid weak
+var make() {
+    int number = int(next() % 19) - 9;
+    number = number == 0 ? 1 : number;
+
+    switch (next() % 7) {
+        case 0:
+            return var();
+        case 1:
+        case 2:
+            return number;
+        case 3:
+        case 4:
+            return number / 4.0;
+        default:
+            return std::string(next() % 4, char('a' + next() % 3));
+    }
+}
+
+template <typename T, typename ... Ts>
+struct same_as {
+    void operator() (const T& val, const var& other, bool& same) const {
+        const T* otherVal = other.get_if<T>();
+        same = otherVal != nullptr && *otherVal == val;
+    }
+};
+
+bool same(const var& left, const var& right) {
+    if (!left.isValid()) {
+        return !right.isValid();
+    }
+
+    bool same = false;
+    left.run<same_as>(right, same);
+    return same;
+}
+
+template <typename T>
+std::vector<T> sorted(std::vector<T> values) {
+    std::sort(values.begin(), values.end());
+    return values;
+}
+
+// the elements match the model, and each column holds exactly the model's values of its type
+void checkSame(const vector& values, const std::vector<var>& model) {
+    CHECK(values.size() == model.size());
+    if (values.size() != model.size()) {
+        return;
+    }
+
+    std::vector<int> ints;
+    std::vector<double> doubles;
+    std::vector<std::string> strings;
+    std::size_t position = 0;
+
+    for (vector::const_reference element : values) {
+        const var& expected = model[position++];
+        CHECK(same(var(element), expected));
+        CHECK(element.isValid() == expected.isValid());
+
+        if (const int* val = expected.get_if<int>()) {
+            ints.push_back(*val);
+        }
+        if (const double* val = expected.get_if<double>()) {
+            doubles.push_back(*val);
+        }
+        if (const std::string* val = expected.get_if<std::string>()) {
+            strings.push_back(*val);
+        }
+    }
+
+    CHECK(sorted(values.column<int>()) == sorted(ints));
+    CHECK(sorted(values.column<double>()) == sorted(doubles));
+    CHECK(sorted(values.column<std::string>()) == sorted(strings));
+}
+
+// random appends, type changes, removals and compound assignments, with operands from the vector itself
+void testAgainstModel() {
+    vector values;
+    std::vector<var> model;
+
+    for (int round = 0; round < 20000; ++round) {
+        std::size_t action = next() % 10;
+
+        if (model.empty() || action == 0) {
+            var added = make();
+            values.push_back(added);
+            model.push_back(added);
+        }
+        else if (action == 1) {
+            values.pop_back();
+            model.pop_back();
+        }
+        else {
+            std::size_t i = next() % model.size(), j = next() % model.size();
+            var operand = make();
+
+            // strings only grow, start them over now and then
+            const std::string* text = model[i].get_if<std::string>();
+            if (text != nullptr && text -> size() > 64) {
+                action = 2;
+            }
+
+            switch (action) {
+                case 2:
+                    // usually a different type, which moves the column's last value into the freed slot
+                    values[i] = operand;
+                    model[i] = operand;
+                    break;
+                case 3:
+                    values[i] = values[j];
+                    model[i] = var(model[j]);
+                    break;
+                case 4:
+                    values[i] += operand;
+                    model[i] += operand;
+                    break;
+                case 5:
+                    values[i] += values[j];
+                    model[i] += var(model[j]);
+                    break;
+                case 6:
+                    values[i] -= values[i];
+                    model[i] -= var(model[i]);
+                    break;
+                case 7:
+                    // doubles only, integers would overflow
+                    if (operand.isType<double>()) {
+                        values[i] *= operand;
+                        model[i] *= operand;
+                    }
+                    break;
+                case 8:
+                    if (operand.isType<double>()) {
+                        values[i] /= operand;
+                        model[i] /= operand;
+                    }
+                    break;
+                default:
+                    values[i].emplace(std::string("emplaced"));
+                    model[i].emplace(std::string("emplaced"));
+                    break;
+            }
+        }
+
+        if (round % 100 == 0) {
+            checkSame(values, model);
+        }
+    }
+
+    checkSame(values, model);
+}
+
+// the element whose type changes is not the last of its column, so the last value must end up in its slot
+void testSwapRemoval() {
+    vector values;
+    for (int i = 0; i < 5; ++i) {
+        values.emplace_back(i);
+    }
+    values.emplace_back(std::string("text"));
+
+    values[1] = 2.5;
+    values[0] += var(0.5);
+    values[4] -= values[5];
+
+    std::vector<var> model = { 0.5, 2.5, 2, 3, var(), std::string("text") };
+    checkSame(values, model);
+    CHECK(values.column<int>().size() == 2u && values.column<double>().size() == 2u);
+
+    // an in place compound assignment keeps the slot
+    values[2] += values[3];
+    CHECK(values[2].isType<int>() && values[2].value<int>() == 5);
+    model[2] = 5;
+    checkSame(values, model);
+
+    // through an iterator's proxy
+    for (vector::reference element : values) {
+        element *= var(2.0);
+    }
+    model = { 1.0, 5.0, 10.0, 6.0, var(), var() };
+    checkSame(values, model);
+}
+
+}
+
+int main() {
+    testAgainstModel();
+    testSwapRemoval();
+
+    return check_result("weak_vector");
+}
@@ -0,0 +1,263 @@
+//
+// Round trips through the wire format, values split across buffers, and bytes that aren't values.
+//
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "weak_wire.h"
+#include "check.h"
+
+namespace {
+
+enum class color : std::uint8_t { red, green = 200 };
+
+// type indices 1 to 10
+typedef weak<bool, std::int8_t, std::uint16_t, std::int32_t, std::int64_t, std::uint64_t, float, double, std::string,
+             color> wire_weak;
+
+std::vector<wire_weak> values() {
+    return {
+            wire_weak(), true, false,
+            std::int8_t(-128), std::int8_t(127),
+            std::uint16_t(0), std::uint16_t(65535),
+            std::numeric_limits<std::int32_t>::min(), std::int32_t(-1), std::int32_t(0),
+            std::numeric_limits<std::int32_t>::max(),
+            std::numeric_limits<std::int64_t>::min(), std::numeric_limits<std::int64_t>::max(),
+            std::numeric_limits<std::uint64_t>::max(),
+            -1.5f, std::numeric_limits<float>::infinity(),
+            1e300, -0.0, std::nan(""),
+            std::string(), std::string(300, 'w'), std::string("with\0nul", 8),
+            color::green, wire_weak(), std::string("last")
+    };
+}
+
+// whether other holds the same type and value, floating point numbers compared by their bits
+template <typename T, typename ... Ts>
+struct equal_to {
+    void operator() (const T& val, const wire_weak& other, bool& same) const {
+        const T* otherVal = other.get_if<T>();
+        same = otherVal != nullptr && equal(val, *otherVal, std::is_floating_point<T>());
+    }
+
+    static bool equal(const T& val, const T& other, std::true_type) {
+        return std::memcmp(&val, &other, sizeof(T)) == 0;
+    }
+
+    static bool equal(const T& val, const T& other, std::false_type) {
+        return val == other;
+    }
+};
+
+bool same(const wire_weak& left, const wire_weak& right) {
+    if (!left.isValid()) {
+        return !right.isValid();
+    }
+
+    bool same = false;
+    left.run<equal_to>(right, same);
+    return same;
+}
+
+// the whole encoding of values(), and where each value ends in it
+std::vector<unsigned char> encoded(std::vector<std::size_t>& ends) {
+    std::vector<wire_weak> all = values();
+    std::vector<unsigned char> bytes(4096);
+
+    weak_wire_encoder encoder(bytes.data(), bytes.size());
+    for (const wire_weak& value : all) {
+        CHECK(encoder.write(value));
+        ends.push_back(encoder.size());
+    }
+
+    bytes.resize(encoder.size());
+    return bytes;
+}
+
+void testRoundTrip() {
+    std::vector<wire_weak> all = values();
+    std::vector<unsigned char> bytes(4096);
+
+    weak_wire_encoder encoder(bytes.data(), bytes.size());
+    CHECK(encoder.write(all.begin(), all.end()) == all.end());
+
+    std::vector<wire_weak> decoded(all.size());
+    weak_wire_decoder decoder(bytes.data(), encoder.size());
+    weak_wire_status status = weak_wire_status::malformed;
+
+    CHECK(decoder.read(decoded.begin(), decoded.end(), status) == decoded.end());
+    CHECK(status == weak_wire_status::ok);
+    CHECK(decoder.remaining() == 0u);
+
+    for (std::size_t i = 0; i < all.size(); ++i) {
+        CHECK(same(all[i], decoded[i]));
+    }
+
+    // small values stay small
+    unsigned char small[4];
+    weak_wire_encoder compact(small, sizeof(small));
+    CHECK(compact.write(wire_weak(std::int32_t(-1))) && compact.size() == 2u);
+    CHECK(compact.write(wire_weak(true)) && compact.size() == 4u);
+    CHECK(compact.remaining() == 0u);
+}
+
+// a buffer too small for a value is left as it was, and writing goes on in the next buffer
+void testEncoderFull() {
+    std::vector<std::size_t> ends;
+    std::vector<unsigned char> whole = encoded(ends);
+    std::vector<wire_weak> all = values();
+
+    for (std::size_t capacity = 0; capacity <= whole.size(); ++capacity) {
+        std::vector<unsigned char> first(capacity + 1, 0xAA), second(whole.size());
+
+        weak_wire_encoder encoder(first.data(), capacity);
+        std::vector<wire_weak>::iterator next = encoder.write(all.begin(), all.end());
+
+        std::size_t written = static_cast<std::size_t>(next - all.begin());
+        CHECK(encoder.size() == (written == 0 ? 0u : ends[written - 1]));
+        CHECK(written == all.size() || ends[written] > capacity);
+        CHECK(first[capacity] == 0xAA);
+
+        std::size_t size = encoder.size();
+        encoder.reset(second.data(), second.size());
+        CHECK(encoder.write(next, all.end()) == all.end());
+
+        first.resize(size);
+        first.insert(first.end(), second.begin(), second.begin() + encoder.size());
+        CHECK(first == whole);
+    }
+}
+
+// every cut of the encoding decodes the values before it, stops at the value it splits and picks up from there
+void testIncomplete() {
+    std::vector<std::size_t> ends;
+    std::vector<unsigned char> whole = encoded(ends);
+    std::vector<wire_weak> all = values();
+
+    for (std::size_t cut = 0; cut <= whole.size(); ++cut) {
+        // a copy of just the cut bytes, so the sanitizers catch any read past them
+        std::vector<unsigned char> part(whole.begin(), whole.begin() + cut);
+        weak_wire_decoder decoder(part.data(), part.size());
+
+        std::vector<wire_weak> decoded(all.size());
+        weak_wire_status status = weak_wire_status::ok;
+        std::size_t count = static_cast<std::size_t>(decoder.read(decoded.begin(), decoded.end(), status) -
+                                                     decoded.begin());
+
+        std::size_t boundary = count == 0 ? 0u : ends[count - 1];
+        CHECK(count == all.size() || ends[count] > cut);
+        CHECK(status == (count == all.size() ? weak_wire_status::ok : weak_wire_status::incomplete));
+        CHECK(decoder.rest() == part.data() + boundary);
+        CHECK(decoder.remaining() == cut - boundary);
+
+        decoder.reset(whole.data() + boundary, whole.size() - boundary);
+        CHECK(decoder.read(decoded.begin() + count, decoded.end(), status) == decoded.end());
+        CHECK(status == weak_wire_status::ok);
+
+        for (std::size_t i = 0; i < all.size(); ++i) {
+            CHECK(same(all[i], decoded[i]));
+        }
+    }
+}
+
+// bytes that can't be a value are malformed and aren't consumed
+void testMalformed() {
+    const std::vector<std::vector<unsigned char>> malformed = {
+            // no 11th type
+            { 11 },
+            { 0xFF, 0x01 },
+            // a bool other than 0 or 1
+            { 1, 2 },
+            // 2^21 - 1 doesn't fit a std::uint16_t
+            { 3, 0xFF, 0xFF, 0x7F },
+            // the zigzag of 2^31 doesn't fit a std::int32_t
+            { 4, 0x80, 0x80, 0x80, 0x80, 0x10 },
+            // a tenth varint byte above 1 overflows 64 bits
+            { 5, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x02 },
+            // so does an eleventh byte
+            { 6, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x81, 0x01 },
+    };
+
+    for (const std::vector<unsigned char>& bytes : malformed) {
+        weak_wire_decoder decoder(bytes.data(), bytes.size());
+        wire_weak into = std::string("unchanged");
+
+        CHECK(decoder.read(into) == weak_wire_status::malformed);
+        CHECK(same(into, wire_weak(std::string("unchanged"))));
+        CHECK(decoder.rest() == bytes.data());
+        CHECK(decoder.remaining() == bytes.size());
+    }
+
+    // the largest values of those types are fine
+    const std::vector<unsigned char> largest[] = {
+            { 3, 0xFF, 0xFF, 0x03 },
+            { 4, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F },
+            { 6, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01 },
+    };
+
+    for (const std::vector<unsigned char>& bytes : largest) {
+        weak_wire_decoder decoder(bytes.data(), bytes.size());
+        wire_weak into;
+
+        CHECK(decoder.read(into) == weak_wire_status::ok);
+        CHECK(decoder.remaining() == 0u);
+    }
+
+    // a string of 2^40 chars can't be in memory where std::size_t is 32 bits, elsewhere the chars may still come
+    const std::vector<unsigned char> huge = { 9, 0x80, 0x80, 0x80, 0x80, 0x80, 0x20, 'a' };
+    weak_wire_decoder decoder(huge.data(), huge.size());
+    wire_weak into;
+
+    bool fits = std::numeric_limits<std::size_t>::max() >= (std::uint64_t(1) << 40);
+    CHECK(decoder.read(into) == (fits ? weak_wire_status::incomplete : weak_wire_status::malformed));
+    CHECK(decoder.remaining() == huge.size() && !into.isValid());
+}
+
+template <typename T, typename ... Ts>
+struct describe {
+    void operator() (const T&, std::string& description, const void*) const {
+        description = "number";
+    }
+};
+
+template <typename ... Ts>
+struct describe<weak_wire_string, Ts...> {
+    void operator() (const weak_wire_string& val, std::string& description, const void* buffer) const {
+        // a view into the buffer, not a copy
+        CHECK(val.data > static_cast<const char*>(buffer));
+        description = val.str();
+    }
+};
+
+void testVisit() {
+    unsigned char bytes[64];
+    weak_wire_encoder encoder(bytes, sizeof(bytes));
+    CHECK(encoder.write(wire_weak(std::string("hello"))));
+    CHECK(encoder.write(wire_weak(std::int64_t(5))));
+
+    weak_wire_decoder decoder(bytes, encoder.size());
+    std::string description;
+
+    CHECK(decoder.visit<wire_weak, describe>(description, static_cast<const void*>(bytes)) == weak_wire_status::ok);
+    CHECK(description == "hello");
+    CHECK(decoder.visit<wire_weak, describe>(description, static_cast<const void*>(bytes)) == weak_wire_status::ok);
+    CHECK(description == "number");
+    CHECK(decoder.visit<wire_weak, describe>(description, static_cast<const void*>(bytes)) ==
+          weak_wire_status::incomplete);
+}
+
+}
+
+int main() {
+    testRoundTrip();
+    testEncoderFull();
+    testIncomplete();
+    testMalformed();
+    testVisit();
+
+    return check_result("weak_wire");
+}
@@ -8,9 +8,26 @@
 #include "stdlib.h"
 #include "type_traits"
 #include <utility>
+#include <cstdint>
+#include <atomic>
+#include <new>
+#include <memory>
 #include "strong_typedef.h"
 #include "has_operator.h"
 
+// Alternatives larger than WEAK_MAX_INLINE_SIZE bytes are stored on the heap and only a pointer to them is kept inside
+// the weak. The default of 0 stores every alternative inline.
+#ifndef WEAK_MAX_INLINE_SIZE
+#define WEAK_MAX_INLINE_SIZE 0
+#endif
+
+// Define WEAK_LAZY_OPERATORS to have the arithmetic operators return expression templates, see weak_expression.h.
+
+// Define WEAK_SMALL_CODE to share operator kernels between operators and index them with compact tables, trading a
+// little speed for much smaller code, see the shared kernels section.
+
+// Define WEAK_STATS to count emplaces, type changes, operations and allocations of every weak, see weak_stats.h.
+
 
 template <class T>
 class simple_optional {
@@ -18,337 +35,1184 @@ class simple_optional {
     // no assignments
     simple_optional& operator=(const simple_optional&) = delete;
 
-    T* ptr;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
 
-public:
+    bool engaged;
 
-    simple_optional() : ptr(nullptr){
+    void reset() {
+        if (engaged) {
+            value().~T();
+            engaged = false;
+        }
+    }
 
+public:
 
-    }
+    simple_optional() : engaged(false){
 
-    simple_optional(const T& val) : ptr(new T(val)){}
+    }
 
-    simple_optional(const T&& val) : ptr(new T(val)){}
+    simple_optional(const T& val) : engaged(false){
+        emplace(val);
+    }
 
-    simple_optional(const simple_optional& other) {
-        simple_optional(std::move(other));
+    simple_optional(T&& val) : engaged(false){
+        emplace(std::move(val));
     }
 
-    simple_optional(const simple_optional&& other) {
+    simple_optional(const simple_optional& other) : engaged(false){
         if (other) {
-            ptr = new T(other.value());
-        }
-        else {
-            ptr = nullptr;
+            emplace(other.value());
         }
     }
 
-    ~simple_optional() {
-        if (ptr != nullptr) {
-            delete ptr;
-            ptr = nullptr;
+    simple_optional(simple_optional&& other) noexcept(std::is_nothrow_move_constructible<T>::value) : engaged(false){
+        if (other) {
+            emplace(std::move(other.value()));
         }
     }
 
-    void emplace(const T&& val) {
+    ~simple_optional() {
+        reset();
+    }
 
-        if (ptr != nullptr) {
-            delete ptr;
-        }
+    void emplace(T&& val) {
+        reset();
 
-        ptr = new T(val);
+        ::new (&storage) T(std::move(val));
+        engaged = true;
     }
 
     void emplace(const T& val) {
-        emplace(std::move(val));
+        reset();
+
+        ::new (&storage) T(val);
+        engaged = true;
     }
 
-    constexpr T& value_or(T&& orVal) const & {
-        return ptr != nullptr ? *ptr : orVal;
+    T value_or(T orVal) const & {
+        return engaged ? value() : orVal;
     }
 
-    constexpr T& value_or(T& orVal) const & {
-        return ptr != nullptr ? *ptr : orVal;
+    T& value() & {
+        return *reinterpret_cast<T*>(&storage);
     }
 
-    constexpr T& value() const &{
-        return *ptr;
+    const T& value() const &{
+        return *reinterpret_cast<const T*>(&storage);
     }
 
-    constexpr operator bool() const {
-        return ptr != nullptr;
+    operator bool() const {
+        return engaged;
     }
 };
 
-//=== get_type_index ==//
-template <typename T, typename... Ts>
-struct get_type_index_impl;
+//=== storage ===//
 
-// base case
-// type not found
+// Specialize to force a type in or out of the inline buffer regardless of WEAK_MAX_INLINE_SIZE.
 template <typename T>
-struct get_type_index_impl<T> : std::integral_constant<std::size_t, 0>
+struct weak_is_inline : std::integral_constant<bool, WEAK_MAX_INLINE_SIZE == 0 || sizeof(T) <= WEAK_MAX_INLINE_SIZE>
 {};
 
-// second case
-// type is at the beginning
-template <typename T, typename ... Tail>
-struct get_type_index_impl<T, T, Tail...> : std::integral_constant<std::size_t, 1>
+// Specialize to keep a T in a reference counted block shared by the copies of a weak, so copying the weak only adds a
+// reference. Changing the value through a weak that shares it with others copies it first. Overrides weak_is_inline.
+template <typename T>
+struct weak_is_shared : std::false_type
 {};
 
-// induction step
-// type not found at the beginning
-// the idea here is that if the type is at the beginning ^ will get called (No Head)
-template <typename T, typename Head, typename... Tail>
-struct get_type_index_impl<T, Head, Tail...> : std::integral_constant<std::size_t,
-        get_type_index_impl<T, Tail...>::value == 0u ?
-        0u :
-        1 + get_type_index_impl<T, Tail...>::value>
+// Allocator used for alternatives that are not stored inline. Specialize to use another std compatible allocator, such
+// as the ones in weak_allocator.h. Allocators are default constructed for every allocation, so all instances must be
+// interchangeable.
+template <typename T>
+struct weak_allocator {
+    typedef std::allocator<T> type;
+};
+
+// Constructs, copies, destroys and locates a T inside a weak's storage buffer.
+template <typename T, bool Inline = weak_is_inline<T>::value, bool Shared = weak_is_shared<T>::value>
+struct weak_storage;
+
+// stored directly in the buffer
+template <typename T>
+struct weak_storage<T, true, false> {
+    static constexpr std::size_t size = sizeof(T);
+    static constexpr std::size_t align = alignof(T);
+
+    /// bytes construct allocates, and copy unless the value is shared
+    static constexpr std::size_t heap_bytes = 0;
+
+    template <typename ... Args>
+    static void construct(void* buffer, Args&&... args) {
+        ::new (buffer) T(std::forward<Args>(args)...);
+    }
+
+    static void copy(void* buffer, const void* from) {
+        construct(buffer, *get(from));
+    }
+
+    static constexpr bool nothrow_move = std::is_nothrow_move_constructible<T>::value;
+
+    static void destroy(void* buffer) {
+        static_cast<T*>(buffer)->~T();
+    }
+
+    // moves the value in from into buffer and destroys what is left in from
+    static void move(void* buffer, void* from) noexcept(nothrow_move) {
+        construct(buffer, std::move(*get(from)));
+        destroy(from);
+    }
+
+    static T* get(void* buffer) {
+        return static_cast<T*>(buffer);
+    }
+
+    static const T* get(const void* buffer) {
+        return static_cast<const T*>(buffer);
+    }
+
+    /// the value to change, never shared
+    static T* detach(void* buffer) {
+        return get(buffer);
+    }
+
+    static bool shared(const void*) noexcept {
+        return false;
+    }
+};
+
+// stored on the heap through weak_allocator<T>, the buffer holds a pointer to it
+template <typename T>
+struct weak_storage<T, false, false> {
+    typedef typename std::allocator_traits<typename weak_allocator<T>::type>::template rebind_alloc<T> allocator_type;
+    typedef std::allocator_traits<allocator_type> allocator_traits;
+
+    static constexpr std::size_t size = sizeof(T*);
+    static constexpr std::size_t align = alignof(T*);
+
+    static constexpr std::size_t heap_bytes = sizeof(T);
+
+    template <typename ... Args>
+    static void construct(void* buffer, Args&&... args) {
+        allocator_type allocator;
+
+        // gives the memory back if the constructor throws
+        struct guard {
+            allocator_type& allocator;
+            T* ptr;
+
+            ~guard() {
+                if (ptr != nullptr) {
+                    allocator_traits::deallocate(allocator, ptr, 1);
+                }
+            }
+        } allocated = { allocator, allocator_traits::allocate(allocator, 1) };
+
+        allocator_traits::construct(allocator, allocated.ptr, std::forward<Args>(args)...);
+
+        ::new (buffer) T*(allocated.ptr);
+        allocated.ptr = nullptr;
+    }
+
+    static void copy(void* buffer, const void* from) {
+        construct(buffer, *get(from));
+    }
+
+    static constexpr bool nothrow_move = true;
+
+    static void destroy(void* buffer) {
+        allocator_type allocator;
+        T* ptr = get(buffer);
+
+        allocator_traits::destroy(allocator, ptr);
+        allocator_traits::deallocate(allocator, ptr, 1);
+    }
+
+    // takes over the pointer in from, from must not be destroyed afterwards
+    static void move(void* buffer, void* from) noexcept {
+        ::new (buffer) T*(*static_cast<T**>(from));
+    }
+
+    static T* get(void* buffer) {
+        return *static_cast<T**>(buffer);
+    }
+
+    static const T* get(const void* buffer) {
+        return *static_cast<T* const*>(buffer);
+    }
+
+    static T* detach(void* buffer) {
+        return get(buffer);
+    }
+
+    static bool shared(const void*) noexcept {
+        return false;
+    }
+};
+
+// stored on the heap behind a reference count, the buffer holds a pointer to the value. Copies share the value and the
+// last one to be destroyed frees it. The count is atomic, so weak values sharing a value can be on different threads.
+template <typename T, bool Inline>
+struct weak_storage<T, Inline, true> {
+
+    struct counter {
+        std::atomic<std::size_t> references;
+    };
+
+    // the value follows the counter, at the first offset aligned for it
+    static constexpr std::size_t offset = (sizeof(counter) + alignof(T) - 1) / alignof(T) * alignof(T);
+
+    typedef typename std::aligned_storage<offset + sizeof(T),
+            (alignof(T) > alignof(counter) ? alignof(T) : alignof(counter))>::type block;
+
+    typedef typename std::allocator_traits<typename weak_allocator<T>::type>::template rebind_alloc<block>
+            allocator_type;
+    typedef std::allocator_traits<allocator_type> allocator_traits;
+
+    static counter* countOf(const void* buffer) {
+        return reinterpret_cast<counter*>(reinterpret_cast<unsigned char*>(const_cast<T*>(get(buffer))) - offset);
+    }
+
+    static constexpr std::size_t size = sizeof(T*);
+    static constexpr std::size_t align = alignof(T*);
+
+    static constexpr std::size_t heap_bytes = sizeof(block);
+
+    template <typename ... Args>
+    static void construct(void* buffer, Args&&... args) {
+        allocator_type allocator;
+
+        // gives the memory back if the constructor throws
+        struct guard {
+            allocator_type& allocator;
+            block* ptr;
+
+            ~guard() {
+                if (ptr != nullptr) {
+                    allocator_traits::deallocate(allocator, ptr, 1);
+                }
+            }
+        } allocated = { allocator, allocator_traits::allocate(allocator, 1) };
+
+        unsigned char* bytes = reinterpret_cast<unsigned char*>(allocated.ptr);
+        T* value = ::new (bytes + offset) T(std::forward<Args>(args)...);
+        ::new (bytes) counter{{1u}};
+
+        ::new (buffer) T*(value);
+        allocated.ptr = nullptr;
+    }
+
+    /// adds a reference to the value in from instead of copying it
+    static void copy(void* buffer, const void* from) noexcept {
+        countOf(from) -> references.fetch_add(1u, std::memory_order_relaxed);
+        ::new (buffer) T*(const_cast<T*>(get(from)));
+    }
+
+    static constexpr bool nothrow_move = true;
+
+    /// drops a reference, the value is destroyed with the last one
+    static void destroy(void* buffer) {
+        counter* count = countOf(buffer);
+
+        if (count -> references.fetch_sub(1u, std::memory_order_acq_rel) == 1u) {
+            allocator_type allocator;
+
+            get(buffer) -> ~T();
+            count -> ~counter();
+            allocator_traits::deallocate(allocator, reinterpret_cast<block*>(count), 1);
+        }
+    }
+
+    // takes over the pointer in from, from must not be destroyed afterwards
+    static void move(void* buffer, void* from) noexcept {
+        ::new (buffer) T*(*static_cast<T**>(from));
+    }
+
+    static T* get(void* buffer) {
+        return *static_cast<T**>(buffer);
+    }
+
+    static const T* get(const void* buffer) {
+        return *static_cast<T* const*>(buffer);
+    }
+
+    /// the value to change, copied into a block of its own first if other weak values share it
+    static T* detach(void* buffer) {
+        if (shared(buffer)) {
+            T* copied;
+            construct(&copied, *get(buffer));
+
+            destroy(buffer);
+            ::new (buffer) T*(copied);
+        }
+
+        return get(buffer);
+    }
+
+    /// true when other weak values hold the value too
+    static bool shared(const void* buffer) noexcept {
+        // acquire pairs with the release of other owners dropping their references, so changing a value this one owns
+        // alone can't overlap their last reads of it
+        return countOf(buffer) -> references.load(std::memory_order_acquire) != 1u;
+    }
+};
+
+//=== binary operations ===//
+
+// Which binary operations are defined for a T on the left and a V on the right, one bit per operation. Computed once per
+// pair of types and shared by every operation, instead of each operation asking has_operator.h separately.
+template <typename T, typename V>
+struct weak_operators : std::integral_constant<unsigned,
+        has_addition<T, V>::value << 0 |
+        has_subtraction<T, V>::value << 1 |
+        has_multiplication<T, V>::value << 2 |
+        has_division<T, V>::value << 3 |
+        has_equal<T, V>::value << 4 |
+        has_not_equal<T, V>::value << 5 |
+        has_less_than<T, V>::value << 6 |
+        has_greater_than<T, V>::value << 7 |
+        has_less_than_equal_to<T, V>::value << 8 |
+        has_greater_than_equal_to<T, V>::value << 9>
 {};
 
+// Each operation has its bit in weak_operators.
+struct weak_addition {
+    static constexpr unsigned bit = 1u << 0;
 
-template <std::size_t N, typename ... Ts>
-struct get_type_from_index;
+    template <typename T, typename V>
+    struct defined : std::integral_constant<bool, (weak_operators<T, V>::value & bit) != 0u> {};
 
-template <std::size_t N>
-struct get_type_from_index<N> {
-    using type = void;
+    template <typename T, typename V>
+    static constexpr auto apply(const T& val, const V& val1) -> decltype(val + val1) {
+        return val + val1;
+    }
+
+    template <typename T, typename V>
+    struct assignable : has_addition_assignment<T, V> {};
+
+    template <typename T, typename V>
+    static void assign(T& val, const V& val1) {
+        val += val1;
+    }
 };
 
-template <typename T, typename ... Ts>
-struct get_type_from_index<0, T, Ts...> {
-    using type = T;
+struct weak_subtraction {
+    static constexpr unsigned bit = 1u << 1;
+
+    template <typename T, typename V>
+    struct defined : std::integral_constant<bool, (weak_operators<T, V>::value & bit) != 0u> {};
+
+    template <typename T, typename V>
+    static constexpr auto apply(const T& val, const V& val1) -> decltype(val - val1) {
+        return val - val1;
+    }
+
+    template <typename T, typename V>
+    struct assignable : has_subtraction_assignment<T, V> {};
+
+    template <typename T, typename V>
+    static void assign(T& val, const V& val1) {
+        val -= val1;
+    }
 };
 
-template <std::size_t N, typename T, typename ... Ts>
-struct get_type_from_index<N, T, Ts...> {
-    using type = typename get_type_from_index<N-1, Ts...>::type;
+struct weak_multiplication {
+    static constexpr unsigned bit = 1u << 2;
+
+    template <typename T, typename V>
+    struct defined : std::integral_constant<bool, (weak_operators<T, V>::value & bit) != 0u> {};
+
+    template <typename T, typename V>
+    static constexpr auto apply(const T& val, const V& val1) -> decltype(val * val1) {
+        return val * val1;
+    }
+
+    template <typename T, typename V>
+    struct assignable : has_multiplication_assignment<T, V> {};
+
+    template <typename T, typename V>
+    static void assign(T& val, const V& val1) {
+        val *= val1;
+    }
 };
 
-// Wrapper struct to allow running functions on a specific Var for it's underlying type
-// Function is a function, Var is a weak class, Types is a weak_types object, and args is a list of argument types to call the function with
-// a struct to store a list of weak types
+struct weak_division {
+    static constexpr unsigned bit = 1u << 3;
 
-template <typename ... Types>
-struct weak_types { };
+    template <typename T, typename V>
+    struct defined : std::integral_constant<bool, (weak_operators<T, V>::value & bit) != 0u> {};
 
-template <typename T>
-struct weak_type {
-    // initialize
-    constexpr weak_type(){}
+    template <typename T, typename V>
+    static constexpr auto apply(const T& val, const V& val1) -> decltype(val / val1) {
+        return val / val1;
+    }
+
+    template <typename T, typename V>
+    struct assignable : has_division_assignment<T, V> {};
+
+    template <typename T, typename V>
+    static void assign(T& val, const V& val1) {
+        val /= val1;
+    }
 };
 
-template <typename ... Types>
-class weak;
+struct weak_equal {
+    static constexpr unsigned bit = 1u << 4;
 
-template <typename ... Types>
-class weak {
+    template <typename T, typename V>
+    struct defined : std::integral_constant<bool, (weak_operators<T, V>::value & bit) != 0u> {};
 
-    class type_id : public strong_typedef<type_id, std::size_t>, comparison<type_id> {
+    template <typename T, typename V>
+    static constexpr bool apply(const T& val, const V& val1) {
+        return val == val1;
+    }
+};
 
-    public:
+struct weak_not_equal {
+    static constexpr unsigned bit = 1u << 5;
 
-        // make sure that the type is valid
-        template <typename T>
-        static constexpr bool valid(weak_type<T>) {
-            return get_type_index_impl<T, Types...>::value != 0u;
-        }
+    template <typename T, typename V>
+    struct defined : std::integral_constant<bool, (weak_operators<T, V>::value & bit) != 0u> {};
 
-        //empty type_id
-        constexpr type_id() noexcept : strong_typedef<type_id, std::size_t>(0u){};
+    template <typename T, typename V>
+    static constexpr bool apply(const T& val, const V& val1) {
+        return val != val1;
+    }
+};
 
-        //type_id initializer
-        template <typename T>
-        constexpr type_id(weak_type<T>) noexcept : type_id(get_type_index_impl<T, Types...>::value){
+struct weak_less_than {
+    static constexpr unsigned bit = 1u << 6;
 
-        };
+    template <typename T, typename V>
+    struct defined : std::integral_constant<bool, (weak_operators<T, V>::value & bit) != 0u> {};
 
-        //initializer with a value for the other initializers to use
-        explicit constexpr type_id(std::size_t value) : strong_typedef<type_id, std::size_t>(value)
-        {};
+    template <typename T, typename V>
+    static constexpr bool apply(const T& val, const V& val1) {
+        return val < val1;
+    }
+};
 
-    };
+struct weak_greater_than {
+    static constexpr unsigned bit = 1u << 7;
 
-    type_id current_type;
+    template <typename T, typename V>
+    struct defined : std::integral_constant<bool, (weak_operators<T, V>::value & bit) != 0u> {};
 
-    void* storage;
+    template <typename T, typename V>
+    static constexpr bool apply(const T& val, const V& val1) {
+        return val > val1;
+    }
+};
 
-    template < template<typename Type, typename ... Ts> class Functor, typename ... Ts>
-    class using_weak {
+struct weak_less_than_equal_to {
+    static constexpr unsigned bit = 1u << 8;
 
-        template <typename T, typename ... Args>
-        static auto call(weak<Types...>&& ptr, Args&&... args) -> decltype(Functor<T, Ts...>()(std::forward<weak<Types...>>(ptr).template value<T>(), std::forward<Args>(args)...)) {
-            return Functor<T, Ts...>()(std::forward<weak<Types...>>(ptr).template value<T>(), std::forward<Args>(args)...);
-        };
+    template <typename T, typename V>
+    struct defined : std::integral_constant<bool, (weak_operators<T, V>::value & bit) != 0u> {};
 
-        template <typename T, typename ... Args>
-        static auto constCall(const weak<Types...>&& ptr, Args&&... args) -> decltype(Functor<T, Ts...>()(std::forward<const weak<Types...>>(ptr).template value<T>(), std::forward<Args>(args)...)) {
-            return Functor<T, Ts...>()(std::forward<const weak<Types...>>(ptr).template value<T>(), std::forward<Args>(args)...);
-        };
+    template <typename T, typename V>
+    static constexpr bool apply(const T& val, const V& val1) {
+        return val <= val1;
+    }
+};
 
-    public:
-        // out of types, do nothing
-        template <typename ... Args>
-        static void with(weak_types<>, weak<Types...>&&, Args&&...) {};
+struct weak_greater_than_equal_to {
+    static constexpr unsigned bit = 1u << 9;
 
-        template <typename ... Args>
-        static void with(weak_types<>, const weak<Types...>&&, Args&&...) {};
+    template <typename T, typename V>
+    struct defined : std::integral_constant<bool, (weak_operators<T, V>::value & bit) != 0u> {};
 
-        template <typename Head, typename ... Tail, typename ... Args>
-        static void with(weak_types<Head, Tail...>, weak<Types...>&& ptr, Args&&... args){
-            if (ptr.current_type == type_id(weak_type<Head>{})) {
-                //the type is Head, execute function with value as head
-                call<Head>(std::forward<weak<Types...>>(ptr), std::forward<Args>(args)...);
-            }
-            else {
-                // keep going down the type list.
-                with(weak_types<Tail...>{}, std::forward<weak<Types...>>(ptr), std::forward<Args>(args)...);
-            }
-        };
+    template <typename T, typename V>
+    static constexpr bool apply(const T& val, const V& val1) {
+        return val >= val1;
+    }
+};
 
-        template <typename Head, typename ... Tail, typename ... Args>
-        static void with(weak_types<Head, Tail...>, const weak<Types...>&& ptr, Args&&... args){
-            if (ptr.current_type == type_id(weak_type<Head>{})) {
-                //the type is Head, execute function with value as head
-                constCall<Head>(std::forward<const weak<Types...>>(ptr), std::forward<Args>(args)...);
-            }
-            else {
-                // keep going down the type list.
-                with(weak_types<Tail...>{}, std::forward<const weak<Types...>>(ptr), std::forward<Args>(args)...);
-            }
-        };
+// position of each operation, for code that handles several operations in one place
+template <typename Op>
+struct weak_operation_id;
+
+template <> struct weak_operation_id<weak_addition> : std::integral_constant<std::size_t, 0> {};
+template <> struct weak_operation_id<weak_subtraction> : std::integral_constant<std::size_t, 1> {};
+template <> struct weak_operation_id<weak_multiplication> : std::integral_constant<std::size_t, 2> {};
+template <> struct weak_operation_id<weak_division> : std::integral_constant<std::size_t, 3> {};
+template <> struct weak_operation_id<weak_equal> : std::integral_constant<std::size_t, 4> {};
+template <> struct weak_operation_id<weak_not_equal> : std::integral_constant<std::size_t, 5> {};
+template <> struct weak_operation_id<weak_less_than> : std::integral_constant<std::size_t, 6> {};
+template <> struct weak_operation_id<weak_greater_than> : std::integral_constant<std::size_t, 7> {};
+template <> struct weak_operation_id<weak_less_than_equal_to> : std::integral_constant<std::size_t, 8> {};
+template <> struct weak_operation_id<weak_greater_than_equal_to> : std::integral_constant<std::size_t, 9> {};
+
+constexpr std::size_t weak_operation_count = 10;
+
+// Type erased kernel for Op on a T and a V, stores the result through result.
+// Does nothing when Op is not defined for T and V.
+template <typename Op, typename T, typename V, typename Result, typename enable = void>
+struct weak_binary_kernel {
+    static void apply(const void*, const void*, Result*) {}
+};
+
+template <typename Op, typename T, typename V, typename Result>
+struct weak_binary_kernel<Op, T, V, Result, typename std::enable_if<Op::template defined<T, V>::value>::type> {
+    static void apply(const void* val, const void* val1, Result* result) {
+        *result = Op::apply(*static_cast<const T*>(val), *static_cast<const V*>(val1));
+    }
+};
+
+// (left type, right type) -> kernel matrix for one binary operation on weak<Types...>, indexed like weak::index() so row
+// and column 0 are the invalid type
+template <typename Op, typename Result, typename ... Types>
+class weak_binary_table {
+
+    typedef void (*kernel)(const void*, const void*, Result*);
+
+    struct row {
+        kernel cells[sizeof...(Types) + 1];
     };
 
+    static void none(const void*, const void*, Result*) {}
+
+    template <typename T>
+    static constexpr kernel noneFor() {
+        return &none;
+    }
+
+    // pairs Op is not defined for all share none, so only the defined pairs instantiate a kernel
+    template <typename L, typename R>
+    static constexpr kernel cell(std::false_type) {
+        return &none;
+    }
+
+    template <typename L, typename R>
+    static constexpr kernel cell(std::true_type) {
+        return &weak_binary_kernel<Op, L, R, Result>::apply;
+    }
+
+    template <typename L>
+    static constexpr row makeRow() {
+        return row{{ &none, cell<L, Types>(typename Op::template defined<L, Types>())... }};
+    }
+
 public:
+    static kernel lookup(std::size_t left, std::size_t right) {
+        static const row rows[] = {
+                row{{ &none, noneFor<Types>()... }},
+                makeRow<Types>()...
+        };
 
-    weak(){
-        // initialize with invalid type
-        current_type = type_id();
-        storage = nullptr;
+        return rows[left].cells[right];
+    }
+};
+
+// Compound assignment of Op to a Derived holding a T, from a V. When the result of Op is a T, it is stored into the
+// existing value in place, through T's compound assignment operator if it has one, otherwise the result replaces the
+// value in the Derived. The Derived becomes invalid when Op is not defined for T and V.
+template <typename Op, typename T, typename V, bool Defined = Op::template defined<T, V>::value>
+struct weak_compound_kind : std::integral_constant<int, 0>
+{};
+
+template <typename Op, typename T, typename V>
+struct weak_compound_kind<Op, T, V, true> : std::integral_constant<int, std::is_same<T,
+        typename std::decay<decltype(Op::apply(std::declval<const T&>(), std::declval<const V&>()))>::type>::value ? 2 : 1>
+{};
+
+template <typename Op, typename T, typename V, typename Derived, int Kind = weak_compound_kind<Op, T, V>::value>
+struct weak_compound_kernel {
+    static void apply(void*, const void*, Derived* self) {
+        *self = Derived();
+    }
+};
+
+template <typename Op, typename T, typename V, typename Derived>
+struct weak_compound_kernel<Op, T, V, Derived, 1> {
+    static void apply(void* val, const void* val1, Derived* self) {
+        *self = Op::apply(*static_cast<const T*>(val), *static_cast<const V*>(val1));
+    }
+};
+
+template <typename Op, typename T, typename V, typename Derived>
+struct weak_compound_kernel<Op, T, V, Derived, 2> {
+    static void apply(void* val, const void* val1, Derived*) {
+        assign(*static_cast<T*>(val), *static_cast<const V*>(val1), typename Op::template assignable<T, V>());
+    }
+
+    static void assign(T& val, const V& val1, std::true_type) {
+        Op::assign(val, val1);
+    }
+
+    static void assign(T& val, const V& val1, std::false_type) {
+        val = Op::apply(val, val1);
+    }
+};
+
+// (left type, right type) -> compound assignment kernel matrix for one operation, laid out like weak_binary_table
+template <typename Op, typename Derived, typename ... Types>
+class weak_compound_table {
+
+    typedef void (*kernel)(void*, const void*, Derived*);
+
+    struct row {
+        kernel cells[sizeof...(Types) + 1];
     };
 
-    //// Constructor, Deconstructor, Copy, Move ////
+    static void invalidate(void*, const void*, Derived* self) {
+        *self = Derived();
+    }
+
     template <typename T>
-    weak(T val) : weak() {
+    static constexpr kernel invalidateFor() {
+        return &invalidate;
+    }
 
-        storage = nullptr;
+    // pairs Op is not defined for all share invalidate
+    template <typename L, typename R>
+    static constexpr kernel cell(std::false_type) {
+        return &invalidate;
+    }
 
-        emplace(val);
+    template <typename L, typename R>
+    static constexpr kernel cell(std::true_type) {
+        return &weak_compound_kernel<Op, L, R, Derived>::apply;
     }
 
-    /// Destructor
-    ~weak(){
-        // run functor on object
-        if (storage != nullptr) {
-            run<destroy>(&storage);
+    template <typename L>
+    static constexpr row makeRow() {
+        return row{{ &invalidate, cell<L, Types>(typename Op::template defined<L, Types>())... }};
+    }
+
+public:
+    static kernel lookup(std::size_t left, std::size_t right) {
+        static const row rows[] = {
+                row{{ &invalidate, invalidateFor<Types>()... }},
+                makeRow<Types>()...
+        };
+
+        return rows[left].cells[right];
+    }
+};
+
+template <std::size_t ... Values>
+struct static_max;
+
+template <>
+struct static_max<> : std::integral_constant<std::size_t, 1>
+{};
+
+template <std::size_t Head, std::size_t ... Tail>
+struct static_max<Head, Tail...> : std::integral_constant<std::size_t,
+        (Head > static_max<Tail...>::value) ? Head : static_max<Tail...>::value>
+{};
+
+template <bool ... Values>
+struct static_all;
+
+template <>
+struct static_all<> : std::true_type
+{};
+
+template <bool Head, bool ... Tail>
+struct static_all<Head, Tail...> : std::integral_constant<bool, Head && static_all<Tail...>::value>
+{};
+
+// the smallest unsigned integer type that can hold Max
+template <std::size_t Max>
+struct smallest_unsigned {
+    typedef typename std::conditional<Max <= UINT8_MAX, std::uint8_t,
+            typename std::conditional<Max <= UINT16_MAX, std::uint16_t,
+            typename std::conditional<Max <= UINT32_MAX, std::uint32_t, std::size_t>::type>::type>::type type;
+};
+
+// 0, 1, ..., N - 1, built by halving so that the instantiation depth is logarithmic in N
+template <std::size_t ... Indices>
+struct weak_index_sequence {
+    typedef weak_index_sequence type;
+};
+
+template <typename Left, typename Right>
+struct weak_concat_sequence;
+
+template <std::size_t ... Left, std::size_t ... Right>
+struct weak_concat_sequence<weak_index_sequence<Left...>, weak_index_sequence<Right...>>
+        : weak_index_sequence<Left..., (sizeof...(Left) + Right)...>
+{};
+
+template <std::size_t N>
+struct weak_make_index_sequence : weak_concat_sequence<typename weak_make_index_sequence<N / 2>::type,
+                                                       typename weak_make_index_sequence<N - N / 2>::type>
+{};
+
+template <>
+struct weak_make_index_sequence<0> : weak_index_sequence<>
+{};
+
+template <>
+struct weak_make_index_sequence<1> : weak_index_sequence<0>
+{};
+
+// Op on two values of the same type, the common case of int + int or double + double. For arithmetic types stored
+// inline, the type is found by comparing index with each of theirs and Op runs inline instead of through a kernel
+// pointer. apply returns false for the other types, which are left to weak_binary_table.
+template <typename Op, typename Result, typename Indices, typename ... Types>
+struct weak_same_type_path;
+
+template <typename Op, typename Result, std::size_t ... Indices, typename ... Types>
+struct weak_same_type_path<Op, Result, weak_index_sequence<Indices...>, Types...> {
+
+    template <typename T>
+    struct fast : std::integral_constant<bool, std::is_arithmetic<T>::value && weak_is_inline<T>::value &&
+                                               !weak_is_shared<T>::value && Op::template defined<T, T>::value>
+    {};
+
+    template <typename T, std::size_t Index>
+    static bool attempt(std::true_type, std::size_t index, const void* val, const void* val1, Result* result) {
+        if (index != Index) {
+            return false;
         }
+
+        *result = Op::apply(*static_cast<const T*>(val), *static_cast<const T*>(val1));
+        return true;
     }
 
-    /// Copy Constructor
-    weak(const weak<Types...>& ptr) {
-        // run the copier
-        storage = nullptr;
-        ptr.template run<copy>(this);
+    template <typename T, std::size_t Index>
+    static bool attempt(std::false_type, std::size_t, const void*, const void*, Result*) {
+        return false;
     }
 
-    weak(const weak<Types...>&& val) {
-        val.template run<copy>(this);
+    static bool apply(std::size_t index, const void* val, const void* val1, Result* result) {
+        bool handled = false;
+        bool expand[] = { false, (handled = handled ||
+                attempt<Types, Indices + 1>(typename fast<Types>::type(), index, val, val1, result))... };
+        (void) expand;
+
+        return handled;
     }
+};
 
-    weak<Types...>& operator=(const weak<Types...>&& ptr) {
+//=== get_type_index ==//
 
-        // assign with underlying value
-        // check for self assignment
-        if (this == &ptr) {
-            return *this;
-        }
+// position of the first true in matches[begin, end), starting at 1, or 0 if there is none. Splits the range in halves,
+// so the depth of the constant evaluation is logarithmic in the number of types.
+constexpr std::size_t weak_find_first(const bool* matches, std::size_t begin, std::size_t end);
 
-        ptr.template run<copy>(this);
+constexpr std::size_t weak_find_first_or(std::size_t found, const bool* matches, std::size_t begin, std::size_t end) {
+    return found != 0u ? found : weak_find_first(matches, begin, end);
+}
 
-        return *this;
+constexpr std::size_t weak_find_first(const bool* matches, std::size_t begin, std::size_t end) {
+    return end - begin == 0u ? 0u :
+           end - begin == 1u ? (matches[begin] ? begin + 1 : 0u) :
+           weak_find_first_or(weak_find_first(matches, begin, begin + (end - begin) / 2),
+                              matches, begin + (end - begin) / 2, end);
+}
+
+template <typename T, typename ... Ts>
+struct weak_type_matches {
+    // the trailing false keeps the array from being empty
+    static constexpr bool values[] = { std::is_same<T, Ts>::value..., false };
+};
+
+template <typename T, typename ... Ts>
+constexpr bool weak_type_matches<T, Ts...>::values[];
+
+// position of T in Ts..., starting at 1, or 0 if T is not one of them. A single instantiation regardless of where T is.
+template <typename T, typename... Ts>
+struct get_type_index_impl : std::integral_constant<std::size_t,
+        weak_find_first(weak_type_matches<T, Ts...>::values, 0u, sizeof...(Ts))>
+{};
+
+// each type of Ts... as a distinct base tagged with its position, so the type at N is found by overload resolution
+// instead of by recursing N times
+template <std::size_t N, typename T>
+struct weak_indexed {
+    typedef T type;
+};
+
+template <typename Indices, typename ... Ts>
+struct weak_indexer;
+
+template <std::size_t ... Indices, typename ... Ts>
+struct weak_indexer<weak_index_sequence<Indices...>, Ts...> : weak_indexed<Indices, Ts>...
+{};
+
+template <std::size_t N, typename T>
+weak_indexed<N, T> weak_select(const weak_indexed<N, T>&);
+
+// the type at position N of Ts..., starting at 0, or void if N is out of range
+template <std::size_t N, typename ... Ts>
+struct get_type_from_index {
+    using type = typename decltype(weak_select<(N < sizeof...(Ts) ? N : sizeof...(Ts))>(
+            std::declval<const weak_indexer<typename weak_make_index_sequence<sizeof...(Ts) + 1>::type, Ts..., void>&>()
+    ))::type;
+};
+
+// Wrapper struct to allow running functions on a specific Var for it's underlying type
+// Function is a function, Var is a weak class, Types is a weak_types object, and args is a list of argument types to call the function with
+// a struct to store a list of weak types
+
+template <typename ... Types>
+struct weak_types { };
+
+template <typename T>
+struct weak_type {
+    // initialize
+    constexpr weak_type(){}
+};
+
+//=== shared kernels ===//
+
+#ifdef WEAK_SMALL_CODE
+// The operations that store a Result, one bit each as in weak_operators: the arithmetic operations when Result is a
+// weak, the comparisons when it is a bool.
+template <typename Result>
+struct weak_shared_operations : std::integral_constant<unsigned, std::is_same<Result, bool>::value ?
+        weak_equal::bit | weak_not_equal::bit | weak_less_than::bit | weak_greater_than::bit |
+        weak_less_than_equal_to::bit | weak_greater_than_equal_to::bit :
+        weak_addition::bit | weak_subtraction::bit | weak_multiplication::bit | weak_division::bit>
+{};
+
+// One kernel for every operation on a T and a V that stores a Result, picked by weak_operation_id, instead of a kernel
+// per operation.
+template <typename Result, typename T, typename V>
+struct weak_shared_kernel {
 
+    template <typename Op>
+    static void run(std::true_type, const void* val, const void* val1, Result* result) {
+        *result = Op::apply(*static_cast<const T*>(val), *static_cast<const V*>(val1));
     }
 
-    weak<Types...>& operator=(const weak<Types...>& ptr) {
+    template <typename Op>
+    static void run(std::false_type, const void*, const void*, Result*) {}
 
-        // assign with underlying value
-        // check for self assignment
+    template <typename Op>
+    static void run(const void* val, const void* val1, Result* result) {
+        run<Op>(std::integral_constant<bool, (weak_shared_operations<Result>::value & Op::bit) != 0u &&
+                                             Op::template defined<T, V>::value>(), val, val1, result);
+    }
 
-        if (this == &ptr) {
-            return *this;
+    static void apply(std::size_t operation, const void* val, const void* val1, Result* result) {
+        switch (operation) {
+            case weak_operation_id<weak_addition>::value: run<weak_addition>(val, val1, result); break;
+            case weak_operation_id<weak_subtraction>::value: run<weak_subtraction>(val, val1, result); break;
+            case weak_operation_id<weak_multiplication>::value: run<weak_multiplication>(val, val1, result); break;
+            case weak_operation_id<weak_division>::value: run<weak_division>(val, val1, result); break;
+            case weak_operation_id<weak_equal>::value: run<weak_equal>(val, val1, result); break;
+            case weak_operation_id<weak_not_equal>::value: run<weak_not_equal>(val, val1, result); break;
+            case weak_operation_id<weak_less_than>::value: run<weak_less_than>(val, val1, result); break;
+            case weak_operation_id<weak_greater_than>::value: run<weak_greater_than>(val, val1, result); break;
+            case weak_operation_id<weak_less_than_equal_to>::value: run<weak_less_than_equal_to>(val, val1, result); break;
+            case weak_operation_id<weak_greater_than_equal_to>::value: run<weak_greater_than_equal_to>(val, val1, result); break;
+            default: break;
         }
+    }
+};
 
-        ptr.template run<copy>(this);
+// number of trues in matches[begin, end), split in halves like weak_find_first
+constexpr std::size_t weak_count(const bool* matches, std::size_t begin, std::size_t end) {
+    return end - begin == 0u ? 0u :
+           end - begin == 1u ? (matches[begin] ? 1u : 0u) :
+           weak_count(matches, begin, begin + (end - begin) / 2) + weak_count(matches, begin + (end - begin) / 2, end);
+}
+
+constexpr std::size_t weak_find_nth(const bool* matches, std::size_t n, std::size_t begin, std::size_t end);
+
+constexpr std::size_t weak_find_nth_in(const bool* matches, std::size_t n, std::size_t begin, std::size_t middle,
+                                       std::size_t end, std::size_t before) {
+    return n < before ? weak_find_nth(matches, n, begin, middle) : weak_find_nth(matches, n - before, middle, end);
+}
+
+// position of the true at n, counting from 0, in matches[begin, end)
+constexpr std::size_t weak_find_nth(const bool* matches, std::size_t n, std::size_t begin, std::size_t end) {
+    return end - begin <= 1u ? begin :
+           weak_find_nth_in(matches, n, begin, begin + (end - begin) / 2, end,
+                            weak_count(matches, begin, begin + (end - begin) / 2));
+}
+
+// matches[begin, end) as the low bits of a word, at most 64 of them
+constexpr std::uint64_t weak_bits(const bool* matches, std::size_t begin, std::size_t end) {
+    return end - begin == 0u ? 0u :
+           end - begin == 1u ? (matches[begin] ? 1u : 0u) :
+           weak_bits(matches, begin, begin + (end - begin) / 2) |
+           weak_bits(matches, begin + (end - begin) / 2, end) << ((end - begin) / 2);
+}
+
+constexpr std::size_t weak_popcount(std::uint64_t bits) {
+    return bits == 0u ? 0u : 1u + weak_popcount(bits & (bits - 1u));
+}
+
+// total of the set bits in words[begin, end)
+constexpr std::size_t weak_popcount(const std::uint64_t* words, std::size_t begin, std::size_t end) {
+    return end - begin == 0u ? 0u :
+           end - begin == 1u ? weak_popcount(words[begin]) :
+           weak_popcount(words, begin, begin + (end - begin) / 2) + weak_popcount(words, begin + (end - begin) / 2, end);
+}
+
+// whether a weak_shared_kernel<Result> is needed for the pair of types at Left and Right of Types..., which are indexed
+// like weak::index() so that 0 is the invalid type
+template <typename Result, std::size_t Left, std::size_t Right, typename ... Types>
+struct weak_shared_cell : std::integral_constant<bool, (weak_operators<
+        typename get_type_from_index<Left - 1, Types...>::type,
+        typename get_type_from_index<Right - 1, Types...>::type>::value & weak_shared_operations<Result>::value) != 0u>
+{};
 
-        return *this;
+template <typename Result, std::size_t Right, typename ... Types>
+struct weak_shared_cell<Result, 0, Right, Types...> : std::false_type
+{};
+
+template <typename Result, std::size_t Left, typename ... Types>
+struct weak_shared_cell<Result, Left, 0, Types...> : std::false_type
+{};
+
+template <typename Result, typename ... Types>
+struct weak_shared_cell<Result, 0, 0, Types...> : std::false_type
+{};
+
+// (left type, right type) -> weak_shared_kernel matrix, laid out like weak_binary_table but shared by every operation
+// that stores a Result, so a weak has one table for arithmetic and one for comparisons instead of one per operation.
+// Each cell is the smallest unsigned that numbers the kernels of the pairs some operation is defined for, 0 for all the
+// others, so the pointers are only stored once per defined pair.
+template <typename Result, typename ... Types>
+class weak_shared_table {
+
+    typedef void (*kernel)(std::size_t, const void*, const void*, Result*);
+
+    static constexpr std::size_t width = sizeof...(Types) + 1;
+
+    template <typename Cells>
+    struct layout;
+
+    template <std::size_t ... Cells>
+    struct layout<weak_index_sequence<Cells...>> {
+        static constexpr bool defined[] = { weak_shared_cell<Result, Cells / width, Cells % width, Types...>::value... };
+    };
+
+    typedef layout<typename weak_make_index_sequence<width * width>::type> cells;
+
+    static constexpr std::size_t count = weak_count(cells::defined, 0u, width * width);
+
+    typedef typename smallest_unsigned<count>::type number;
+
+    static void none(std::size_t, const void*, const void*, Result*) {}
+
+    template <std::size_t Cell>
+    static constexpr kernel kernelAt() {
+        return &weak_shared_kernel<Result,
+                typename get_type_from_index<Cell / width - 1, Types...>::type,
+                typename get_type_from_index<Cell % width - 1, Types...>::type>::apply;
     }
 
-    template <typename T>
-    weak<Types...>& operator=(const T&& val){
+    // each row of cells::defined as words of 64 bits, so that cells are numbered by counting bits
+    static constexpr std::size_t words = (width + 63u) / 64u;
 
-        // otherwise assign normally
-        emplace(val);
+    template <std::size_t Word>
+    static constexpr std::uint64_t wordAt() {
+        return weak_bits(cells::defined, Word / words * width + Word % words * 64u,
+                         Word % words + 1u == words ? (Word / words + 1u) * width : Word / words * width + (Word % words + 1u) * 64u);
+    }
 
-        return *this;
+    template <typename Words>
+    struct bits;
+
+    template <std::size_t ... Words>
+    struct bits<weak_index_sequence<Words...>> {
+        static constexpr std::uint64_t values[] = { wordAt<Words>()... };
+    };
+
+    typedef bits<typename weak_make_index_sequence<width * words>::type> rows;
+
+    // number of defined cells in the rows before each row
+    template <typename Rows>
+    struct offsets;
+
+    template <std::size_t ... Rows>
+    struct offsets<weak_index_sequence<Rows...>> {
+        static constexpr std::size_t values[] = { weak_popcount(rows::values, 0u, Rows * words)... };
+    };
+
+    typedef offsets<typename weak_make_index_sequence<width>::type> before;
+
+    // 1 + the number of defined cells before Cell
+    template <std::size_t Cell>
+    static constexpr number numberAt() {
+        return cells::defined[Cell] ? static_cast<number>(1u + before::values[Cell / width] +
+                weak_popcount(rows::values, Cell / width * words, Cell / width * words + Cell % width / 64u) +
+                weak_popcount(rows::values[Cell / width * words + Cell % width / 64u] &
+                              ((std::uint64_t(1u) << Cell % width % 64u) - 1u))) : number(0);
     }
 
-    template <typename T>
-    weak<Types...>& operator=(const T& ptr) {
+    template <std::size_t ... Cells>
+    static const number* numbers(weak_index_sequence<Cells...>) {
+        static const number table[] = { numberAt<Cells>()... };
+        return table;
+    }
 
-        emplace(ptr);
+    template <std::size_t ... Kernels>
+    static const kernel* kernels(weak_index_sequence<Kernels...>) {
+        static const kernel table[] = { &none, kernelAt<weak_find_nth(cells::defined, Kernels, 0u, width * width)>()... };
+        return table;
+    }
 
-        return *this;
+public:
+    static kernel lookup(std::size_t left, std::size_t right) {
+        return kernels(typename weak_make_index_sequence<count>::type())[
+                numbers(typename weak_make_index_sequence<width * width>::type())[left * width + right]];
     }
+};
 
-    template <typename T>
-    void emplace(const T val) {
-        using t = typename std::decay<T>::type;
-        /// ensure that the type is valid at compile time
-        static_assert(type_id::valid(weak_type<t>{}), "Cannot store with non-weak type.");
+template <typename Result, typename ... Types>
+template <std::size_t ... Cells>
+constexpr bool weak_shared_table<Result, Types...>::layout<weak_index_sequence<Cells...>>::defined[];
+
+template <typename Result, typename ... Types>
+template <std::size_t ... Words>
+constexpr std::uint64_t weak_shared_table<Result, Types...>::bits<weak_index_sequence<Words...>>::values[];
+
+template <typename Result, typename ... Types>
+template <std::size_t ... Rows>
+constexpr std::size_t weak_shared_table<Result, Types...>::offsets<weak_index_sequence<Rows...>>::values[];
+#endif
+
+/// Runs Op on values of the types at left and right of Types..., indexed like weak::index(), with one indexed call.
+/// Leaves result untouched if Op is not defined for the types. Under WEAK_SMALL_CODE the call goes through
+/// weak_shared_table instead of weak_binary_table.
+template <typename Op, typename Result, typename ... Types>
+void weak_binary_apply(std::size_t left, std::size_t right, const void* val, const void* val1, Result* result) {
+#ifdef WEAK_SMALL_CODE
+    weak_shared_table<Result, Types...>::lookup(left, right)(weak_operation_id<Op>::value, val, val1, result);
+#else
+    weak_binary_table<Op, Result, Types...>::lookup(left, right)(val, val1, result);
+#endif
+}
+
+//=== weak_interface ===//
+
+template <typename Weak, typename Node>
+class weak_expression;
+
+template <typename Weak>
+struct weak_leaf;
+
+template <typename Op, typename Left, typename Right>
+struct weak_node;
+
+template <typename Weak>
+struct weak_visit_operand;
+
+// The stored T of a representation, for code that may change it. Representations that don't store a T, such as
+// boxed_weak, provide ref<T>(), a proxy that writes back, and the others value<T>().
+template <typename T, typename Weak>
+auto weak_access(Weak& ptr, int) -> decltype(ptr.template ref<T>()) {
+    return ptr.template ref<T>();
+}
+
+template <typename T, typename Weak>
+auto weak_access(Weak& ptr, long) -> decltype(ptr.template value<T>()) {
+    return ptr.template value<T>();
+}
+
+// The part of weak's interface that only needs the current type and the stored value, shared by weak and its other
+// representations such as tagged_weak. Derived befriends weak_interface and provides:
+//     std::size_t index() const     position of the current type in Types..., starting at 1. 0 when invalid.
+//     value<T>()                    the stored T, const and non const
+//     ref<T>()                      optionally, what non const run and weak_visit pass instead of value<T>()
+//     binary<Op>(other, result)     runs Op on this and other, leaves result untouched if Op is not defined for them
+template <typename Derived, typename ... Types>
+class weak_interface {
+
+    Derived& self() noexcept {
+        return static_cast<Derived&>(*this);
+    }
 
-        current_type = type_id(weak_type<t>());
+    const Derived& self() const noexcept {
+        return static_cast<const Derived&>(*this);
+    }
 
-        if (storage != nullptr) {
-            run<destroy>(&storage);
-        }
+    template <typename Weak>
+    friend struct weak_visit_operand;
 
-        storage = new t(val);
+    // lets weak_visit read the current type of any representation
+    std::size_t position() const noexcept {
+        return self().index();
     }
 
-    const type_id& type() const noexcept
-    {
-        return current_type;
+    template < template<typename Type, typename ... Ts> class Functor, typename ... Ts>
+    class using_weak {
+
+        template <typename T, typename ... Args>
+        static void call(Derived& ptr, Args&&... args) {
+            Functor<T, Ts...>()(weak_access<T>(ptr, 0), std::forward<Args>(args)...);
+        };
+
+        template <typename T, typename ... Args>
+        static void constCall(const Derived& ptr, Args&&... args) {
+            Functor<T, Ts...>()(ptr.template value<T>(), std::forward<Args>(args)...);
+        };
+
+        // invalid type, do nothing
+        template <typename ... Args>
+        static void none(Derived&, Args&&...) {};
+
+        template <typename ... Args>
+        static void constNone(const Derived&, Args&&...) {};
+
+    public:
+        // jump straight to the call for the current type, slot 0 is the invalid type
+        template <typename ... Args>
+        static void with(Derived& ptr, Args&&... args){
+            static void (* const table[])(Derived&, Args&&...) = {
+                    &none<Args...>, &call<Types, Args...>...
+            };
+
+            table[ptr.index()](ptr, std::forward<Args>(args)...);
+        };
+
+        template <typename ... Args>
+        static void with(const Derived& ptr, Args&&... args){
+            static void (* const table[])(const Derived&, Args&&...) = {
+                    &constNone<Args...>, &constCall<Types, Args...>...
+            };
+
+            table[ptr.index()](ptr, std::forward<Args>(args)...);
+        };
+    };
+
+protected:
+
+    ///// returns true if the current type is Type
+    template <typename Type>
+    bool check() const noexcept {
+        // types that are not in Types... share the invalid index, but are never stored
+        return get_type_index_impl<Type, Types...>::value != 0u &&
+               self().index() == get_type_index_impl<Type, Types...>::value;
     }
 
-    bool isValid() {
-        return !(current_type == type_id());
+public:
+
+    bool isValid() const {
+        return self().index() != 0u;
     }
 
     template <typename Type>
-    bool isType() {
-        return current_type == type_id(weak_type<Type>{});
+    bool isType() const {
+        return check<Type>();
     }
 
     template <template<typename Type, typename ... Ts> class Functor, typename ... Ts, typename ... Args>
     void run(Args&&... args) {
-        using_weak<Functor, Ts...>::with(weak_types<Types...>{}, std::move(*this), std::forward<Args>(args)...);
+        using_weak<Functor, Ts...>::with(self(), std::forward<Args>(args)...);
     };
 
     template <template<typename Type, typename ... Ts> class Functor, typename ... Ts, typename ... Args>
     void run(Args&&... args) const {
-        using_weak<Functor, Ts...>::with(weak_types<Types...>{}, std::move(*this), std::forward<Args>(args)...);
+        using_weak<Functor, Ts...>::with(self(), std::forward<Args>(args)...);
     };
 
     template <typename T>
     simple_optional<T> retrieve() const {
-        if (check(weak_type<T>{})) {
-            return simple_optional<T>(value<T>());
+        if (check<T>()) {
+            return simple_optional<T>(self().template value<T>());
         }
         else return simple_optional<T>();
     };
 
-
     template <typename T>
     simple_optional<T> as() const {
 
@@ -358,487 +1222,658 @@ public:
         return castedMaybe;
     }
 
-    template <typename T>
-    T&& value() const {
-        return std::move(*reinterpret_cast<T*>(storage));
-    };
-
 private:
 
-    ///// returns the underlying pointer if the type is correct. Otherwise returns a nullptr;
-    template <typename Type>
-    bool check(weak_type<Type> check_type) const {
-        return current_type == check_type;
-    }
-
-    //// Functors to destroy, copy, move, assign without knowing the underlying value
-    template <typename T>
-    struct destroy {
-        void operator() (T val, void** storage) {
-            delete (T*)*storage;
-            *storage = nullptr;
-        }
-    };
-
-    template <typename T>
-    struct copy {
-        void operator() (T val, weak<Types...>* thisWeak) const {
-            // copy the underlying value
-            if (thisWeak -> storage == nullptr) {
-                thisWeak -> emplace(val);
-            }
-
-
-        }
-    };
-
     template <typename T, typename V, typename enable=void>
     struct cast;
 
     template <typename T, typename V>
     struct cast<T, V, typename std::enable_if<std::is_convertible<T, V>::value>::type> {
-        void operator() (T val, simple_optional<V>& returnVal) {
+        void operator() (const T& val, simple_optional<V>& returnVal) {
                 returnVal.emplace(V(val));
         };
     };
 
     template <typename T, typename V>
     struct cast<T, V, typename std::enable_if<!std::is_convertible<T, V>::value>::type> {
-        void operator() (T val, simple_optional<V>& returnVal) {
+        void operator() (const T&, simple_optional<V>&) {
 
         };
     };
 
+    template <typename Op>
+    using lazy = weak_expression<Derived, weak_node<Op, weak_leaf<Derived>, weak_leaf<Derived>>>;
+
 public:
     ///// Arithmetic Operators /////
 
-    /// Addition
-    /// Weak types
-
-    /// rvalue
-    weak<Types...> operator+ (const weak<Types...>&& other) const {
-
-        weak<Types...> added;
-
-        run<addTop>(&other, &added);
-
-        return added;
+#ifdef WEAK_LAZY_OPERATORS
+    lazy<weak_addition> operator+ (const Derived& other) const {
+        return lazy<weak_addition>({ { &self() }, { &other } });
     }
 
-    /// lvalue
-    weak<Types...> operator+ (const weak<Types...>& other) const {
-
-
-        weak<Types...> added;
-
-        run<addTop>(&other, &added);
+    lazy<weak_subtraction> operator- (const Derived& other) const {
+        return lazy<weak_subtraction>({ { &self() }, { &other } });
+    }
 
-        return added;
+    lazy<weak_multiplication> operator* (const Derived& other) const {
+        return lazy<weak_multiplication>({ { &self() }, { &other } });
     }
 
-    /// Subtraction
-    /// Weak Types
-    weak<Types...> operator- (const weak<Types...>& other) const {
-        weak<Types...> subtracted;
+    lazy<weak_division> operator/ (const Derived& other) const {
+        return lazy<weak_division>({ { &self() }, { &other } });
+    }
+#else
+    /// Addition
+    Derived operator+ (const Derived& other) const {
+        Derived added;
 
-        other.run<subtractTop>(this, &subtracted);
+        self().template binary<weak_addition>(other, &added);
 
-        return subtracted;
+        return added;
     }
 
     /// Subtraction
-    /// Weak Types
-    weak<Types...> operator- (const weak<Types...>&& other) const {
-        weak<Types...> subtracted;
+    Derived operator- (const Derived& other) const {
+        Derived subtracted;
 
-        other.run<subtractTop>(this, &subtracted);
+        self().template binary<weak_subtraction>(other, &subtracted);
 
         return subtracted;
     }
 
     /// Multiplication
-    /// Weak Types
-
-    weak<Types...> operator* (const weak<Types...>& other) const {
-
-        weak<Types...> multiplied;
-
-        run<multTop>(&other, &multiplied);
-
-        return multiplied;
-
-    }
+    Derived operator* (const Derived& other) const {
+        Derived multiplied;
 
-    weak<Types...> operator* (const weak<Types...>&& other) const {
-
-        weak<Types...> multiplied;
-
-        run<multTop>(&other, &multiplied);
+        self().template binary<weak_multiplication>(other, &multiplied);
 
         return multiplied;
     }
 
     /// Division
-    /// Weak Types
-    weak<Types...> operator / (const weak<Types...>& other) const {
-        weak<Types...> divided;
-        other.run<divideTop>(this, &divided);
-
-        return divided;
-    }
+    Derived operator/ (const Derived& other) const {
+        Derived divided;
 
-    weak<Types...> operator / (const weak<Types...>&& other) const {
-        weak<Types...> divided;
-        other.run<divideTop>(this, &divided);
+        self().template binary<weak_division>(other, &divided);
 
         return divided;
     }
+#endif
 
     // comparison operators
-    bool operator==(const weak<Types...>& other) const {
+    bool operator==(const Derived& other) const {
         bool result = false;
 
-        run<equalTop>(&other, &result);
+        self().template binary<weak_equal>(other, &result);
 
         return result;
     }
 
-    bool operator !=(const weak<Types...>& other) const {
+    bool operator !=(const Derived& other) const {
         bool result = false;
 
-        run<notEqualTop>(&other, &result);
+        self().template binary<weak_not_equal>(other, &result);
 
         return result;
     }
 
-    bool operator < (const weak<Types...>& other) const {
+    bool operator < (const Derived& other) const {
         bool result = false;
 
-        other.run<lessTop>(this, &result);
+        self().template binary<weak_less_than>(other, &result);
 
         return result;
     }
 
-    bool operator < (const weak<Types...>&& other) const {
+    bool operator > (const Derived& other) const {
         bool result = false;
 
-        other.run<lessTop>(this, &result);
+        self().template binary<weak_greater_than>(other, &result);
 
         return result;
     }
 
-    bool operator > (const weak<Types...>& other) const {
+    bool operator <= (const Derived& other) const {
         bool result = false;
 
-        other.run<greaterTop>(this, &result);
+        self().template binary<weak_less_than_equal_to>(other, &result);
 
         return result;
     }
 
-    bool operator > (const weak<Types...>&& other) const {
+    bool operator >= (const Derived& other) const {
         bool result = false;
 
-        other.run<greaterTop>(this, &result);
+        self().template binary<weak_greater_than_equal_to>(other, &result);
 
         return result;
     }
 
-    bool operator <= (const weak<Types...>& other) const {
-        bool result = false;
+    Derived& operator +=(const Derived& other) {
+        self().template compound<weak_addition>(other);
+        return self();
+    };
 
-        other.run<lessThanEqualToTop>(this, &result);
+    Derived& operator -=(const Derived& other) {
+        self().template compound<weak_subtraction>(other);
+        return self();
+    };
 
-        return result;
+    Derived& operator *=(const Derived& other) {
+        self().template compound<weak_multiplication>(other);
+        return self();
     }
 
-    bool operator <= (const weak<Types...>&& other) const {
-        bool result = false;
+    Derived& operator /=(const Derived& other) {
+        self().template compound<weak_division>(other);
+        return self();
+    }
 
-        other.run<lessThanEqualToTop>(this, &result);
+protected:
 
-        return result;
+    /// this = this Op other. Derived can hide this with one that updates the stored value in place.
+    template <typename Op>
+    void compound(const Derived& other) {
+        Derived result;
+        self().template binary<Op>(other, &result);
+        self() = std::move(result);
     }
+};
 
-    bool operator >= (const weak<Types...>& other) const {
-        bool result = false;
+//=== weak_visit ===//
 
-        other.run<greaterThanEqualToTop>(this, &result);
-        return result;
-    }
+template <typename Derived, typename ... Types>
+weak_types<Types...> weak_alternatives(const weak_interface<Derived, Types...>&);
 
-    bool operator >= (const weak<Types...>&& other) const {
-        bool result = false;
+// The types of one operand of weak_visit, which is any representation deriving from weak_interface. Types are indexed
+// like index(), so 0 is the invalid type.
+template <typename Weak>
+struct weak_visit_operand {
+    template <typename Types>
+    struct count_of;
 
-        other.run<greaterThanEqualToTop>(this, &result);
-        return result;
-    }
+    template <typename ... Types>
+    struct count_of<weak_types<Types...>> : std::integral_constant<std::size_t, sizeof...(Types) + 1> {};
 
-    weak<Types...>& operator +=(const weak<Types...>& other) {
-        *this = *this+other;
-        return *this;
-    };
+    template <std::size_t Index, typename Types>
+    struct type_of;
 
-    weak<Types...>& operator -=(const weak<Types...>& other) {
-        *this = *this-other;
-        return *this;
+    template <std::size_t Index, typename ... Types>
+    struct type_of<Index, weak_types<Types...>> {
+        typedef typename get_type_from_index<(Index == 0 ? sizeof...(Types) : Index - 1), Types...>::type type;
     };
 
-    weak<Types...>& operator *=(const weak<Types...>& other) {
-        *this = *this * other;
-        return *this;
-    }
+    typedef decltype(weak_alternatives(std::declval<const Weak&>())) alternatives;
 
-    weak<Types...>& operator /=(const weak<Types...>& other) {
-        *this = *this / other;
-        return *this;
+    static constexpr std::size_t count = count_of<alternatives>::value;
+
+    template <std::size_t Index>
+    using type = typename type_of<Index, alternatives>::type;
+
+    template <typename Derived, typename ... Types>
+    static std::size_t index(const weak_interface<Derived, Types...>& operand) noexcept {
+        return operand.position();
     }
+};
 
-private:
+// Every combination of the types of Weaks... has a cell, laid out row major so that the cell of the operands' indexes
+// i, j, k... is at i * strides[0] + j * strides[1] + k. Strides is the sequence of strides, size the number of cells.
+template <typename ... Weaks>
+struct weak_visit_layout;
 
+template <>
+struct weak_visit_layout<> {
+    typedef weak_index_sequence<> strides;
+    static constexpr std::size_t size = 1;
+};
 
-    template <typename T>
-    struct equalTop {
-        void operator() (T val, const weak<Types...>* other, bool* result) {
-            other -> run<equalBottom, T>(val, result);
-        }
+template <typename Weak, typename ... Rest>
+struct weak_visit_layout<Weak, Rest...> {
+    template <typename Tail>
+    struct prepend;
+
+    template <std::size_t ... Tail>
+    struct prepend<weak_index_sequence<Tail...>> {
+        typedef weak_index_sequence<weak_visit_layout<Rest...>::size, Tail...> type;
     };
 
-    template <typename T, typename V, typename enable = void>
-    struct equalBottom;
+    typedef typename prepend<typename weak_visit_layout<Rest...>::strides>::type strides;
+    static constexpr std::size_t size = weak_visit_operand<Weak>::count * weak_visit_layout<Rest...>::size;
+};
 
-    template <typename T, typename V>
-    struct equalBottom<T, V, typename std::enable_if<has_equal<T, V>::value>::type> {
-        void operator() (T val, V val1, bool* result) {
-            *result = val == val1;
-        }
-    };
+// calls Functor with the values of Weaks... for the combination of types at Cell, or does nothing and returns a value
+// initialized Result when one of them is invalid
+template <typename Strides, typename Functor, typename ... Weaks>
+struct weak_visit_cell;
 
-    template <typename T, typename V>
-    struct equalBottom<T, V, typename std::enable_if<!has_equal<T, V>::value>::type>{
-        void operator() (T val, V val1, bool* result){
+template <std::size_t ... Strides, typename Functor, typename ... Weaks>
+struct weak_visit_cell<weak_index_sequence<Strides...>, Functor, Weaks...> {
 
-        };
-    };
+    template <std::size_t Cell>
+    struct at {
+        static constexpr bool valid = static_all<((Cell / Strides) % weak_visit_operand<Weaks>::count != 0)...>::value;
 
+        // invalid cells stand in with the first type of every operand, which keeps the result type well formed
+        typedef decltype(std::declval<Functor&>()(weak_access<
+                typename weak_visit_operand<Weaks>::template type<valid ? (Cell / Strides) % weak_visit_operand<Weaks>::count : 1>
+        >(std::declval<Weaks&>(), 0)...)) result;
 
-    template <typename T>
-    struct notEqualTop {
-        void operator() (T val, const weak<Types...>* other, bool* result) {
-            other -> run<notEqualBottom, T>(val, result);
+        template <typename Result>
+        static Result call(Functor& functor, Weaks&... weaks) {
+            return dispatch<Result>(std::integral_constant<bool, valid>(), functor, weaks...);
         }
-    };
 
-    template <typename T, typename V, typename enable = void>
-    struct notEqualBottom;
+        template <typename Result>
+        static Result dispatch(std::true_type, Functor& functor, Weaks&... weaks) {
+            return static_cast<Result>(functor(weak_access<
+                    typename weak_visit_operand<Weaks>::template type<(Cell / Strides) % weak_visit_operand<Weaks>::count>
+            >(weaks, 0)...));
+        }
 
-    template <typename T, typename V>
-    struct notEqualBottom<T, V, typename std::enable_if<has_not_equal<T, V>::value>::type> {
-        void operator() (T val, V val1, bool* result) {
-            *result = val != val1;
+        template <typename Result>
+        static Result dispatch(std::false_type, Functor&, Weaks&...) {
+            return Result();
         }
     };
+};
 
-    template <typename T, typename V>
-    struct notEqualBottom<T, V, typename std::enable_if<!has_not_equal<T, V>::value>::type> {
-        void operator() (T val, V val1, bool* result){
+template <typename Cells, typename Functor, typename ... Weaks>
+struct weak_visitor;
+
+template <std::size_t ... Cells, typename Functor, typename ... Weaks>
+struct weak_visitor<weak_index_sequence<Cells...>, Functor, Weaks...> {
+    typedef weak_visit_layout<Weaks...> layout;
+    typedef weak_visit_cell<typename layout::strides, Functor, Weaks...> cells;
+
+    typedef typename std::common_type<typename cells::template at<Cells>::result...>::type result;
 
+    template <std::size_t ... Strides>
+    static std::size_t locate(weak_index_sequence<Strides...>, const Weaks&... weaks) noexcept {
+        std::size_t cell = 0;
+        std::size_t expand[] = { 0u, (cell += weak_visit_operand<Weaks>::index(weaks) * Strides)... };
+        (void) expand;
+        return cell;
+    }
+
+    static result visit(Functor& functor, Weaks&... weaks) {
+        static result (* const table[])(Functor&, Weaks&...) = {
+                &cells::template at<Cells>::template call<result>...
         };
-    };
 
-    /// Addition implementation
-    template <typename T>
-    struct addTop {
-        void operator() (T val, const weak<Types...>* other, weak<Types...>* adding) {
-            other -> run<addBottom, T>(val, adding);
-        }
-    };
+        return table[locate(typename layout::strides(), weaks...)](functor, weaks...);
+    }
+};
 
-    template <typename T, typename V, typename enable = void>
-    struct addBottom;
+// the weak_visitor for a call to weak_visit, with one cell per combination of types
+template <typename Functor, typename ... Weaks>
+struct weak_visit_of {
+    typedef weak_visitor<typename weak_make_index_sequence<weak_visit_layout<Weaks...>::size>::type, Functor, Weaks...> type;
+};
 
-    template <typename T, typename V>
-    struct addBottom<T, V, typename std::enable_if<has_addition<T, V>::value>::type> {
-        void operator() (T val, V val1, weak<Types...>* adding) {
-            adding -> emplace(val + val1);
-        }
-    };
+/// Calls functor with the values of all the weaks, each as its current type, through one table of every combination of
+/// their types. Returns the common type of what functor returns for all combinations, or a value initialized one
+/// without calling functor when any weak is invalid. Weaks can be of different weak types and representations.
+template <typename Functor, typename ... Weaks>
+typename weak_visit_of<typename std::remove_reference<Functor>::type,
+        typename std::remove_reference<Weaks>::type...>::type::result weak_visit(Functor&& functor, Weaks&&... weaks) {
+    return weak_visit_of<typename std::remove_reference<Functor>::type,
+            typename std::remove_reference<Weaks>::type...>::type::visit(functor, weaks...);
+}
 
+//=== weak ===//
 
-    template <typename T, typename V>
-    struct addBottom<T, V, typename std::enable_if<!has_addition<T, V>::value>::type> {
-        void operator() (T val, V val1, weak<Types...>* adding){};
-    };
+template <typename ... Types>
+class weak;
 
-    /// Addition implementation
-    template <typename T>
-    struct subtractTop {
-        void operator() (T val, const weak<Types...>* other, weak<Types...>* adding) {
+#ifdef WEAK_STATS
+template <typename ... Types>
+class weak_stats;
+#endif
 
-            other -> run<subtractBottom, T>(val, adding);
-        }
-    };
+template <typename ... Types>
+class weak : public weak_interface<weak<Types...>, Types...> {
 
-    template <typename T, typename V, typename enable = void>
-    struct subtractBottom;
+    friend class weak_interface<weak<Types...>, Types...>;
 
-    template <typename T, typename V>
-    struct subtractBottom<T, V, typename std::enable_if<has_subtraction<T, V>::value>::type> {
+    // the type index fits in a byte for up to 255 alternatives
+    typedef typename smallest_unsigned<sizeof...(Types)>::type tag_type;
+
+    class type_id : public strong_typedef<type_id, tag_type>, comparison<type_id> {
+
+    public:
 
-        void operator() (T val, V val1, weak<Types...>* adding) {
-            adding -> emplace(val-val1);
+        // make sure that the type is valid
+        template <typename T>
+        static constexpr bool valid(weak_type<T>) {
+            return get_type_index_impl<T, Types...>::value != 0u;
         }
-    };
 
+        //empty type_id
+        constexpr type_id() noexcept : strong_typedef<type_id, tag_type>(0u){};
 
-    template <typename T, typename V>
-    struct subtractBottom<T, V, typename std::enable_if<!has_subtraction<T, V>::value>::type> {
-        void operator() (T val, V val1, weak<Types...>* adding){};
-    };
+        //type_id initializer
+        template <typename T>
+        constexpr type_id(weak_type<T>) noexcept : type_id(get_type_index_impl<T, Types...>::value){
 
-    /// Multiplication implementation
-    template <typename T>
-    struct multTop {
-        void operator() (T val, const weak<Types...>* other, weak<Types...>* multiplying) {
-            other -> run<multBottom, T>(val, multiplying);
-        }
-    };
+        };
 
-    template <typename T, typename V, typename enable=void>
-    struct multBottom;
+        //initializer with a value for the other initializers to use
+        explicit constexpr type_id(std::size_t value) : strong_typedef<type_id, tag_type>(static_cast<tag_type>(value))
+        {};
 
-    template <typename T, typename V>
-    struct multBottom<T, V, typename std::enable_if<has_multiplication<T, V>::value>::type> {
-        void operator() (T val, V val1, weak<Types...>* multiplying) {
-            multiplying -> emplace(val * val1);
-        }
     };
 
-    template <typename T, typename V>
-    struct multBottom<T, V, typename std::enable_if<!has_multiplication<T, V>::value>::type> {
-        void operator() (T val, V val1, weak<Types...>* multiplying){
+    typename std::aligned_storage<static_max<weak_storage<Types>::size...>::value,
+            static_max<weak_storage<Types>::align...>::value>::type storage;
 
-        }
-    };
+    // after the storage so that a small tag packs into the padding at the end instead of in front of the value
+    type_id current_type;
+
+    static constexpr bool nothrow_move = static_all<weak_storage<Types>::nothrow_move...>::value;
 
+    static constexpr bool shares = !static_all<!weak_is_shared<Types>::value...>::value;
+
+    // only enabled for the types in Types..., so that proxies holding a weak value convert through weak(const weak&)
     template <typename T>
-    struct divideTop {
-        void operator() (T val, const weak<Types...>* numerator, weak<Types...>* dividing ) {
-            numerator -> run<divideBottom, T>(val, dividing);
-        }
+    using alternative = typename std::enable_if<type_id::valid(weak_type<typename std::decay<T>::type>{})>::type;
+
+    template <typename ... Ts>
+    friend class weak_vector;
+
+    template <typename ... Ts>
+    friend class weak_batch;
+
+    template <typename W>
+    friend struct atomic_weak_bits;
+
+    /// position of the current type in Types..., starting at 1. 0 when invalid.
+    std::size_t index() const noexcept {
+        return static_cast<const tag_type&>(current_type);
+    }
+
+public:
+
+    weak(){
+        // initialize with invalid type
+        current_type = type_id();
     };
 
-    template <typename T, typename V, typename enable=void>
-    struct divideBottom;
+    //// Constructor, Deconstructor, Copy, Move ////
+    template <typename T, typename = alternative<T>>
+    weak(T val) : weak() {
+        emplace(std::move(val));
+    }
+
+    /// Destructor
+    ~weak(){
+        reset();
+    }
 
-    template< typename  T, typename V>
-    struct divideBottom<T, V, typename std::enable_if<has_division<T, V>::value>::type>  {
-        void operator() (T val, V val2, weak<Types...>* dividing) {
-            dividing -> emplace(val/val2);
+    /// Copy Constructor
+    weak(const weak<Types...>& ptr) : weak() {
+        // run the copier
+        ptr.template run<copy>(&ptr.storage, this);
+#ifdef WEAK_STATS
+        stored(0u, true);
+#endif
+    }
+
+    /// Move Constructor
+    /// takes over the value of val and leaves val invalid
+    weak(weak<Types...>&& val) noexcept(nothrow_move) : weak() {
+        constant(val).template run<move>(&val.storage, this);
+        val.current_type = type_id();
+#ifdef WEAK_STATS
+        stored(0u, false);
+#endif
+    }
+
+    weak<Types...>& operator=(weak<Types...>&& ptr) noexcept(nothrow_move) {
+
+        // assign with underlying value
+        // check for self assignment
+        if (this == &ptr) {
+            return *this;
         }
-    };
 
-    template< typename  T, typename V>
-    struct divideBottom<T, V, typename std::enable_if<!has_division<T, V>::value>::type>  {
-        void operator() (T val, V val2, weak<Types...>* dividing) {
+#ifdef WEAK_STATS
+        std::size_t from = index();
+#endif
+
+        reset();
+        constant(ptr).template run<move>(&ptr.storage, this);
+        ptr.current_type = type_id();
+
+#ifdef WEAK_STATS
+        stored(from, false);
+#endif
+        return *this;
+
+    }
+
+    weak<Types...>& operator=(const weak<Types...>& ptr) {
+
+        // assign with underlying value
+        // check for self assignment
 
+        if (this == &ptr) {
+            return *this;
         }
-    };
+
+#ifdef WEAK_STATS
+        std::size_t from = index();
+#endif
+
+        reset();
+        ptr.template run<copy>(&ptr.storage, this);
+
+#ifdef WEAK_STATS
+        stored(from, true);
+#endif
+        return *this;
+    }
+
+    template <typename T, typename = alternative<T>>
+    weak<Types...>& operator=(const T&& val){
+
+        // otherwise assign normally
+        emplace(val);
+
+        return *this;
+    }
+
+    template <typename T, typename = alternative<T>>
+    weak<Types...>& operator=(const T& ptr) {
+
+        emplace(ptr);
+
+        return *this;
+    }
+
+    /// evaluates an expression from weak_expression.h straight into this weak
+    template <typename Node>
+    weak<Types...>& operator=(const weak_expression<weak<Types...>, Node>& expression) {
+        expression.evaluate(*this);
+
+        return *this;
+    }
 
     template <typename T>
-    struct lessTop {
-        void operator() (T val, const weak<Types...>* _this, bool* result) {
-            _this->run<lessBottom, T>(val, result);
-        }
-    };
+    void emplace(T val) {
+        using t = typename std::decay<T>::type;
+        /// ensure that the type is valid at compile time
+        static_assert(type_id::valid(weak_type<t>{}), "Cannot store with non-weak type.");
 
-    template <typename T, typename V, typename enable = void>
-    struct lessBottom;
+#ifdef WEAK_STATS
+        weak_stats<Types...>::emplaced(index(), get_type_index_impl<t, Types...>::value, weak_storage<t>::heap_bytes);
+#endif
 
-    template <typename T, typename V>
-    struct lessBottom<T, V, typename std::enable_if<has_less_than<T, V>::value>::type> {
-        void operator() (T val, V val2, bool* result) {
-            *result = val2 > val;
-        }
-    };
+        // val is a copy, so it is safe to destroy the old value even if val was read from it
+        reset();
 
-    template <typename T, typename V>
-    struct lessBottom<T, V, typename std::enable_if<!has_less_than<T, V>::value>::type> {
-        void operator() (T val, V val2, bool* result) {
+        weak_storage<t>::construct(&storage, std::move(val));
 
-        }
+        current_type = type_id(weak_type<t>());
+    }
+
+    const type_id& type() const noexcept
+    {
+        return current_type;
+    }
+
+    /// pointer to the stored value if it is a T, nullptr otherwise
+    template <typename T>
+    T* get_if() noexcept {
+        return this -> template check<T>() ? &value<T>() : nullptr;
+    }
+
+    template <typename T>
+    const T* get_if() const noexcept {
+        return this -> template check<T>() ? &value<T>() : nullptr;
+    }
+
+    /// a shared value is copied first if other weak values hold it too
+    template <typename T>
+    T& value() {
+        return *weak_storage<T>::detach(&storage);
     };
 
     template <typename T>
-    struct greaterTop {
-        void operator() (T val, const weak<Types...>* _this, bool* result) {
-            _this->run<greaterBottom, T>(val, result);
-        }
+    const T& value() const {
+        return *weak_storage<T>::get(&storage);
     };
 
-    template <typename T, typename V, typename enable = void>
-    struct greaterBottom;
+private:
 
-    template <typename T, typename V>
-    struct greaterBottom<T, V, typename std::enable_if<has_greater_than<T, V>::value>::type> {
-        void operator() (T val, V val2, bool* result) {
-            *result = val > val2;
-        }
-    };
+    // functors that only move or drop the stored value run through the const run, whose value<T>() doesn't copy a
+    // shared value first
+    static const weak<Types...>& constant(const weak<Types...>& val) noexcept {
+        return val;
+    }
 
-    template <typename T, typename V>
-    struct greaterBottom<T, V, typename std::enable_if<!has_greater_than<T, V>::value>::type> {
-        void operator() (T val, V val2, bool* result) {
+    /// destroys the stored value and leaves the weak invalid
+    void reset() {
+        // slot 0 is the invalid type. Numbers and other trivial inline values need no call to destroy them.
+        static const bool trivial[] = {
+                true, (std::is_trivially_destructible<Types>::value && weak_is_inline<Types>::value &&
+                       !weak_is_shared<Types>::value)...
+        };
 
+        if (!trivial[index()]) {
+            constant(*this).template run<destroy>(&storage);
         }
-    };
+        current_type = type_id();
+    }
 
+    //// Functors to destroy, copy, move, assign without knowing the underlying value
     template <typename T>
-    struct lessThanEqualToTop {
-        void operator() (T val, const weak<Types...>* _this, bool* result) {
-            _this->run<lessThanEqualToBottom, T>(val, result);
+    struct destroy {
+        void operator() (const T&, void* storage) {
+            weak_storage<T>::destroy(storage);
         }
     };
 
-    template <typename T, typename V, typename enable = void>
-    struct lessThanEqualToBottom;
+    template <typename T>
+    struct move {
+        void operator() (const T&, void* from, weak<Types...>* thisWeak) const noexcept(weak_storage<T>::nothrow_move) {
+            weak_storage<T>::move(&thisWeak -> storage, from);
+            thisWeak -> current_type = type_id(weak_type<T>());
+        }
+    };
 
-    template <typename T, typename V>
-    struct lessThanEqualToBottom<T, V, typename std::enable_if<has_less_than_equal_to<T, V>::value>::type> {
-        void operator() (T val, V val2, bool* result) {
-            *result = val <= val2;
+    template <typename T>
+    struct copy {
+        void operator() (const T&, const void* from, weak<Types...>* thisWeak) const {
+            // copy the underlying value, or share it
+            weak_storage<T>::copy(&thisWeak -> storage, from);
+            thisWeak -> current_type = type_id(weak_type<T>());
         }
     };
 
-    template <typename T, typename V>
-    struct lessThanEqualToBottom<T, V, typename std::enable_if<!has_less_than_equal_to<T, V>::value>::type> {
-        void operator() (T val, V val2, bool* result) {
+#ifdef WEAK_STATS
+    /// counts a copy or move that left this weak holding a value, and the type from that it held before it
+    void stored(std::size_t from, bool copied) const {
+        // slot 0 is the invalid type. Moves and copies of a shared value allocate nothing.
+        static const std::size_t bytes[] = {
+                0u, (weak_is_shared<Types>::value ? 0u : weak_storage<Types>::heap_bytes)...
+        };
 
+        if (index() != 0) {
+            weak_stats<Types...>::emplaced(from, index(), copied ? bytes[index()] : 0u);
         }
-    };
+    }
+#endif
 
     template <typename T>
-    struct greaterThanEqualToTop {
-        void operator() (T val, const weak<Types...>* _this, bool* result) {
-            _this->run<greaterThanEqualToBottom, T>(val, result);
+    struct sharedWith {
+        void operator() (const T&, const void* storage, bool& others) const noexcept {
+            others = weak_storage<T>::shared(storage);
         }
     };
 
-    template <typename T, typename V, typename enable = void>
-    struct greaterThanEqualToBottom;
+    /// true when the stored value is shared with other weak values, which must not see it change
+    bool shared() const noexcept {
+        // slot 0 is the invalid type
+        static const bool counted[] = { false, weak_is_shared<Types>::value... };
 
-    template <typename T, typename V>
-    struct greaterThanEqualToBottom<T, V, typename std::enable_if<has_greater_than_equal_to<T, V>::value>::type> {
-        void operator() (T val, V val2, bool* result) {
-            *result = val >= val;
+        bool others = false;
+        if (counted[index()]) {
+            this -> template run<sharedWith>(&storage, others);
         }
-    };
+        return others;
+    }
 
-    template <typename T, typename V>
-    struct greaterThanEqualToBottom<T, V, typename std::enable_if<!has_greater_than_equal_to<T, V>::value>::type> {
-        void operator() (T val, V val2, bool* result) {
+    /// address of the stored value, out of line and shared alternatives keep a pointer to it at the start of the buffer
+    const void* address() const noexcept {
+        // slot 0 is the invalid type
+        static const bool onHeap[] = { false, (!weak_is_inline<Types>::value || weak_is_shared<Types>::value)... };
+
+        return onHeap[index()] ? *reinterpret_cast<void* const*>(&storage) : static_cast<const void*>(&storage);
+    }
 
+    /// runs Op on this and other with one indexed call, leaves result untouched if Op is not defined for the types
+    template <typename Op, typename Result>
+    void binary(const weak<Types...>& other, Result* result) const {
+#ifdef WEAK_STATS
+        weak_stats<Types...>::template operated<Op>(index(), other.index());
+#endif
+#ifndef WEAK_SMALL_CODE
+        if (index() == other.index() &&
+            weak_same_type_path<Op, Result, typename weak_make_index_sequence<sizeof...(Types)>::type, Types...>::apply(
+                    index(), &storage, &other.storage, result)) {
+            return;
         }
-    };
+#endif
+
+        weak_binary_apply<Op, Result, Types...>(index(), other.index(), address(), other.address(), result);
+    }
+
+#ifndef WEAK_SMALL_CODE
+    /// this = this Op other, in place when the result has the current type and no other weak value shares it
+    template <typename Op>
+    void compound(const weak<Types...>& other) {
+        if (shares && shared()) {
+            // the result replaces this weak's reference, the other holders keep the value as it was
+            weak_interface<weak<Types...>, Types...>::template compound<Op>(other);
+            return;
+        }
+
+#ifdef WEAK_STATS
+        weak_stats<Types...>::template operated<Op>(index(), other.index());
+#endif
+        weak_compound_table<Op, weak<Types...>, Types...>::lookup(index(), other.index())(
+                const_cast<void*>(address()), other.address(), this);
+    }
+#endif
 };
 
+#ifdef WEAK_LAZY_OPERATORS
+#include "weak_expression.h"
+#endif
+
+#ifdef WEAK_STATS
+#include "weak_stats.h"
+#endif
+
 #endif //WEAK_H
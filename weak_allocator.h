@@ -0,0 +1,282 @@
+//
+// Allocators for weak alternatives that are stored out of line, see weak_allocator<T> in weak.h.
+//
+
+#ifndef WEAK_TYPES_WEAK_ALLOCATOR_H
+#define WEAK_TYPES_WEAK_ALLOCATOR_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+//=== pool ===//
+
+// A per thread list of freed blocks of Size bytes. Blocks are only handed back to the global allocator by release() or
+// when the thread exits. The main thread's list is destroyed before static objects are, so local() returns nullptr from
+// then on, and blocks a static weak frees go straight to the global allocator.
+template <std::size_t Size>
+class weak_free_list {
+
+    struct node {
+        node* next;
+    };
+
+    static_assert(Size >= sizeof(node), "Blocks must be able to hold a free list node.");
+
+    node* head;
+
+    weak_free_list() : head(nullptr) {}
+
+    weak_free_list(const weak_free_list&) = delete;
+    weak_free_list& operator=(const weak_free_list&) = delete;
+
+public:
+
+    ~weak_free_list() {
+        release();
+        destroyed() = true;
+    }
+
+    /// the calling thread's list, nullptr once it is destroyed
+    static weak_free_list* local() noexcept {
+        if (destroyed()) {
+            return nullptr;
+        }
+
+        static thread_local weak_free_list list;
+        return &list;
+    }
+
+    void* allocate() {
+        if (head == nullptr) {
+            return ::operator new(Size);
+        }
+
+        node* block = head;
+        head = block -> next;
+        return block;
+    }
+
+    void deallocate(void* block) noexcept {
+        node* freed = static_cast<node*>(block);
+        freed -> next = head;
+        head = freed;
+    }
+
+    void release() noexcept {
+        while (head != nullptr) {
+            node* next = head -> next;
+            ::operator delete(head);
+            head = next;
+        }
+    }
+
+private:
+
+    // trivially destructible, so it can still be read after the list is gone
+    static bool& destroyed() noexcept {
+        static thread_local bool flag = false;
+        return flag;
+    }
+};
+
+// Recycles single objects through a free list owned by the calling thread. Types of similar size share a list.
+template <typename T>
+class weak_pool_allocator {
+
+    // blocks come from ::operator new, which only aligns to max_align_t before C++17
+    static_assert(alignof(T) <= alignof(std::max_align_t), "weak_pool_allocator can't allocate over aligned types.");
+
+    // round up to a multiple of two pointers so that similar sized types share blocks
+    static constexpr std::size_t block_size =
+            (sizeof(T) + 2 * sizeof(void*) - 1) / (2 * sizeof(void*)) * (2 * sizeof(void*));
+
+    typedef weak_free_list<block_size> free_list;
+
+public:
+    typedef T value_type;
+
+    weak_pool_allocator() noexcept {}
+
+    template <typename U>
+    weak_pool_allocator(const weak_pool_allocator<U>&) noexcept {}
+
+    T* allocate(std::size_t n) {
+        if (n != 1) {
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+
+        free_list* list = free_list::local();
+        return static_cast<T*>(list != nullptr ? list -> allocate() : ::operator new(block_size));
+    }
+
+    void deallocate(T* ptr, std::size_t n) noexcept {
+        if (n != 1) {
+            ::operator delete(ptr);
+            return;
+        }
+
+        free_list* list = free_list::local();
+        if (list == nullptr) {
+            ::operator delete(ptr);
+            return;
+        }
+
+        list -> deallocate(ptr);
+    }
+
+    /// gives the blocks cached by the calling thread back to the global allocator
+    static void release() noexcept {
+        free_list* list = free_list::local();
+        if (list != nullptr) {
+            list -> release();
+        }
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const weak_pool_allocator<T>&, const weak_pool_allocator<U>&) noexcept {
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const weak_pool_allocator<T>&, const weak_pool_allocator<U>&) noexcept {
+    return false;
+}
+
+//=== arena ===//
+
+// A monotonic arena. Allocation bumps a pointer through large chunks, nothing is freed until release() or the arena's
+// destruction, which free everything at once.
+class weak_arena {
+
+    struct chunk {
+        chunk* next;
+        std::size_t size;
+    };
+
+    chunk* chunks;
+
+    char* cursor;
+
+    char* end;
+
+    std::size_t chunkSize;
+
+    static weak_arena*& active() {
+        static thread_local weak_arena* arena = nullptr;
+        return arena;
+    }
+
+    static char* alignUp(char* ptr, std::size_t align) {
+        std::uintptr_t address = reinterpret_cast<std::uintptr_t>(ptr);
+        return ptr + ((align - address % align) % align);
+    }
+
+public:
+
+    explicit weak_arena(std::size_t chunkSize = 4096) : chunks(nullptr), cursor(nullptr), end(nullptr),
+                                                         chunkSize(chunkSize) {}
+
+    weak_arena(const weak_arena&) = delete;
+    weak_arena& operator=(const weak_arena&) = delete;
+
+    ~weak_arena() {
+        release();
+    }
+
+    void* allocate(std::size_t size, std::size_t align) {
+        char* start = alignUp(cursor, align);
+
+        if (cursor == nullptr || start + size > end) {
+            std::size_t needed = sizeof(chunk) + size + align;
+            std::size_t allocated = needed > chunkSize ? needed : chunkSize;
+
+            chunk* added = static_cast<chunk*>(::operator new(allocated));
+            added -> next = chunks;
+            added -> size = allocated;
+            chunks = added;
+
+            cursor = reinterpret_cast<char*>(added + 1);
+            end = reinterpret_cast<char*>(added) + allocated;
+            start = alignUp(cursor, align);
+        }
+
+        cursor = start + size;
+        return start;
+    }
+
+    /// frees everything allocated from the arena. Values still alive in it must not be used or destroyed afterwards.
+    void release() noexcept {
+        while (chunks != nullptr) {
+            chunk* next = chunks -> next;
+            ::operator delete(chunks);
+            chunks = next;
+        }
+
+        cursor = nullptr;
+        end = nullptr;
+    }
+
+    /// the arena weak_arena_allocator allocates from on this thread. There must be a scope on this thread, otherwise
+    /// this asserts, or throws std::bad_alloc when assertions are off, since nothing would ever free the memory.
+    static weak_arena& current() {
+        assert(active() != nullptr && "weak_arena_allocator used outside a weak_arena::scope");
+
+        if (active() == nullptr) {
+            throw std::bad_alloc();
+        }
+
+        return *active();
+    }
+
+    /// makes an arena current on this thread for the lifetime of the scope
+    class scope {
+
+        weak_arena* previous;
+
+    public:
+        explicit scope(weak_arena& arena) : previous(active()) {
+            active() = &arena;
+        }
+
+        scope(const scope&) = delete;
+        scope& operator=(const scope&) = delete;
+
+        ~scope() {
+            active() = previous;
+        }
+    };
+};
+
+// Allocates from weak_arena::current(), so values using it can only be created within a weak_arena::scope. Deallocation
+// does nothing, the memory comes back when the arena is released.
+template <typename T>
+class weak_arena_allocator {
+public:
+    typedef T value_type;
+
+    weak_arena_allocator() noexcept {}
+
+    template <typename U>
+    weak_arena_allocator(const weak_arena_allocator<U>&) noexcept {}
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(weak_arena::current().allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, std::size_t) noexcept {}
+};
+
+template <typename T, typename U>
+bool operator==(const weak_arena_allocator<T>&, const weak_arena_allocator<U>&) noexcept {
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const weak_arena_allocator<T>&, const weak_arena_allocator<U>&) noexcept {
+    return false;
+}
+
+#endif //WEAK_TYPES_WEAK_ALLOCATOR_H
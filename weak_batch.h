@@ -0,0 +1,746 @@
+//
+// Element-wise operators over arrays of weak values and weak_vectors.
+//
+
+#ifndef WEAK_TYPES_WEAK_BATCH_H
+#define WEAK_TYPES_WEAK_BATCH_H
+
+#include <cstdint>
+#include "weak.h"
+#include "weak_vector.h"
+
+// Define WEAK_NO_SIMD to always use the scalar loops.
+#ifndef WEAK_NO_SIMD
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#endif
+
+//=== simd ===//
+
+// Vector registers for T on the target, picked at build time. enabled is false when there is no vector support for T.
+// Comparisons return one bit per lane, lane 0 in bit 0.
+template <typename T>
+struct weak_simd {
+    static constexpr bool enabled = false;
+    static constexpr bool has_mul = false;
+    static constexpr bool has_div = false;
+};
+
+#ifndef WEAK_NO_SIMD
+
+#if defined(__AVX__)
+
+template <>
+struct weak_simd<float> {
+    typedef __m256 reg;
+
+    static constexpr bool enabled = true;
+    static constexpr bool has_mul = true;
+    static constexpr bool has_div = true;
+    static constexpr std::size_t lanes = 8;
+
+    static reg load(const float* values) { return _mm256_loadu_ps(values); }
+    static void store(float* values, reg val) { _mm256_storeu_ps(values, val); }
+
+    static reg add(reg val, reg val1) { return _mm256_add_ps(val, val1); }
+    static reg sub(reg val, reg val1) { return _mm256_sub_ps(val, val1); }
+    static reg mul(reg val, reg val1) { return _mm256_mul_ps(val, val1); }
+    static reg div(reg val, reg val1) { return _mm256_div_ps(val, val1); }
+
+    static int eq(reg val, reg val1) { return _mm256_movemask_ps(_mm256_cmp_ps(val, val1, _CMP_EQ_OQ)); }
+    static int ne(reg val, reg val1) { return _mm256_movemask_ps(_mm256_cmp_ps(val, val1, _CMP_NEQ_UQ)); }
+    static int lt(reg val, reg val1) { return _mm256_movemask_ps(_mm256_cmp_ps(val, val1, _CMP_LT_OQ)); }
+    static int gt(reg val, reg val1) { return _mm256_movemask_ps(_mm256_cmp_ps(val, val1, _CMP_GT_OQ)); }
+    static int le(reg val, reg val1) { return _mm256_movemask_ps(_mm256_cmp_ps(val, val1, _CMP_LE_OQ)); }
+    static int ge(reg val, reg val1) { return _mm256_movemask_ps(_mm256_cmp_ps(val, val1, _CMP_GE_OQ)); }
+};
+
+template <>
+struct weak_simd<double> {
+    typedef __m256d reg;
+
+    static constexpr bool enabled = true;
+    static constexpr bool has_mul = true;
+    static constexpr bool has_div = true;
+    static constexpr std::size_t lanes = 4;
+
+    static reg load(const double* values) { return _mm256_loadu_pd(values); }
+    static void store(double* values, reg val) { _mm256_storeu_pd(values, val); }
+
+    static reg add(reg val, reg val1) { return _mm256_add_pd(val, val1); }
+    static reg sub(reg val, reg val1) { return _mm256_sub_pd(val, val1); }
+    static reg mul(reg val, reg val1) { return _mm256_mul_pd(val, val1); }
+    static reg div(reg val, reg val1) { return _mm256_div_pd(val, val1); }
+
+    static int eq(reg val, reg val1) { return _mm256_movemask_pd(_mm256_cmp_pd(val, val1, _CMP_EQ_OQ)); }
+    static int ne(reg val, reg val1) { return _mm256_movemask_pd(_mm256_cmp_pd(val, val1, _CMP_NEQ_UQ)); }
+    static int lt(reg val, reg val1) { return _mm256_movemask_pd(_mm256_cmp_pd(val, val1, _CMP_LT_OQ)); }
+    static int gt(reg val, reg val1) { return _mm256_movemask_pd(_mm256_cmp_pd(val, val1, _CMP_GT_OQ)); }
+    static int le(reg val, reg val1) { return _mm256_movemask_pd(_mm256_cmp_pd(val, val1, _CMP_LE_OQ)); }
+    static int ge(reg val, reg val1) { return _mm256_movemask_pd(_mm256_cmp_pd(val, val1, _CMP_GE_OQ)); }
+};
+
+#elif defined(__SSE2__)
+
+template <>
+struct weak_simd<float> {
+    typedef __m128 reg;
+
+    static constexpr bool enabled = true;
+    static constexpr bool has_mul = true;
+    static constexpr bool has_div = true;
+    static constexpr std::size_t lanes = 4;
+
+    static reg load(const float* values) { return _mm_loadu_ps(values); }
+    static void store(float* values, reg val) { _mm_storeu_ps(values, val); }
+
+    static reg add(reg val, reg val1) { return _mm_add_ps(val, val1); }
+    static reg sub(reg val, reg val1) { return _mm_sub_ps(val, val1); }
+    static reg mul(reg val, reg val1) { return _mm_mul_ps(val, val1); }
+    static reg div(reg val, reg val1) { return _mm_div_ps(val, val1); }
+
+    static int eq(reg val, reg val1) { return _mm_movemask_ps(_mm_cmpeq_ps(val, val1)); }
+    static int ne(reg val, reg val1) { return _mm_movemask_ps(_mm_cmpneq_ps(val, val1)); }
+    static int lt(reg val, reg val1) { return _mm_movemask_ps(_mm_cmplt_ps(val, val1)); }
+    static int gt(reg val, reg val1) { return _mm_movemask_ps(_mm_cmpgt_ps(val, val1)); }
+    static int le(reg val, reg val1) { return _mm_movemask_ps(_mm_cmple_ps(val, val1)); }
+    static int ge(reg val, reg val1) { return _mm_movemask_ps(_mm_cmpge_ps(val, val1)); }
+};
+
+template <>
+struct weak_simd<double> {
+    typedef __m128d reg;
+
+    static constexpr bool enabled = true;
+    static constexpr bool has_mul = true;
+    static constexpr bool has_div = true;
+    static constexpr std::size_t lanes = 2;
+
+    static reg load(const double* values) { return _mm_loadu_pd(values); }
+    static void store(double* values, reg val) { _mm_storeu_pd(values, val); }
+
+    static reg add(reg val, reg val1) { return _mm_add_pd(val, val1); }
+    static reg sub(reg val, reg val1) { return _mm_sub_pd(val, val1); }
+    static reg mul(reg val, reg val1) { return _mm_mul_pd(val, val1); }
+    static reg div(reg val, reg val1) { return _mm_div_pd(val, val1); }
+
+    static int eq(reg val, reg val1) { return _mm_movemask_pd(_mm_cmpeq_pd(val, val1)); }
+    static int ne(reg val, reg val1) { return _mm_movemask_pd(_mm_cmpneq_pd(val, val1)); }
+    static int lt(reg val, reg val1) { return _mm_movemask_pd(_mm_cmplt_pd(val, val1)); }
+    static int gt(reg val, reg val1) { return _mm_movemask_pd(_mm_cmpgt_pd(val, val1)); }
+    static int le(reg val, reg val1) { return _mm_movemask_pd(_mm_cmple_pd(val, val1)); }
+    static int ge(reg val, reg val1) { return _mm_movemask_pd(_mm_cmpge_pd(val, val1)); }
+};
+
+#endif
+
+#if defined(__AVX2__)
+
+template <>
+struct weak_simd<std::int32_t> {
+    typedef __m256i reg;
+
+    static constexpr bool enabled = true;
+    static constexpr bool has_mul = true;
+    static constexpr bool has_div = false;
+    static constexpr std::size_t lanes = 8;
+
+    static reg load(const std::int32_t* values) { return _mm256_loadu_si256(reinterpret_cast<const reg*>(values)); }
+    static void store(std::int32_t* values, reg val) { _mm256_storeu_si256(reinterpret_cast<reg*>(values), val); }
+
+    static reg add(reg val, reg val1) { return _mm256_add_epi32(val, val1); }
+    static reg sub(reg val, reg val1) { return _mm256_sub_epi32(val, val1); }
+    static reg mul(reg val, reg val1) { return _mm256_mullo_epi32(val, val1); }
+
+    static int bits(reg val) { return _mm256_movemask_ps(_mm256_castsi256_ps(val)); }
+
+    static int eq(reg val, reg val1) { return bits(_mm256_cmpeq_epi32(val, val1)); }
+    static int ne(reg val, reg val1) { return ~eq(val, val1) & 0xFF; }
+    static int lt(reg val, reg val1) { return bits(_mm256_cmpgt_epi32(val1, val)); }
+    static int gt(reg val, reg val1) { return bits(_mm256_cmpgt_epi32(val, val1)); }
+    static int le(reg val, reg val1) { return ~gt(val, val1) & 0xFF; }
+    static int ge(reg val, reg val1) { return ~lt(val, val1) & 0xFF; }
+};
+
+#elif defined(__SSE2__)
+
+template <>
+struct weak_simd<std::int32_t> {
+    typedef __m128i reg;
+
+    static constexpr bool enabled = true;
+#if defined(__SSE4_1__)
+    static constexpr bool has_mul = true;
+#else
+    static constexpr bool has_mul = false;
+#endif
+    static constexpr bool has_div = false;
+    static constexpr std::size_t lanes = 4;
+
+    static reg load(const std::int32_t* values) { return _mm_loadu_si128(reinterpret_cast<const reg*>(values)); }
+    static void store(std::int32_t* values, reg val) { _mm_storeu_si128(reinterpret_cast<reg*>(values), val); }
+
+    static reg add(reg val, reg val1) { return _mm_add_epi32(val, val1); }
+    static reg sub(reg val, reg val1) { return _mm_sub_epi32(val, val1); }
+#if defined(__SSE4_1__)
+    static reg mul(reg val, reg val1) { return _mm_mullo_epi32(val, val1); }
+#endif
+
+    static int bits(reg val) { return _mm_movemask_ps(_mm_castsi128_ps(val)); }
+
+    static int eq(reg val, reg val1) { return bits(_mm_cmpeq_epi32(val, val1)); }
+    static int ne(reg val, reg val1) { return ~eq(val, val1) & 0xF; }
+    static int lt(reg val, reg val1) { return bits(_mm_cmplt_epi32(val, val1)); }
+    static int gt(reg val, reg val1) { return bits(_mm_cmpgt_epi32(val, val1)); }
+    static int le(reg val, reg val1) { return ~gt(val, val1) & 0xF; }
+    static int ge(reg val, reg val1) { return ~lt(val, val1) & 0xF; }
+};
+
+#endif
+
+#endif //WEAK_NO_SIMD
+
+// Maps a weak operation to its weak_simd instruction. enabled<S> is false when S cannot vectorize the operation.
+template <typename Op>
+struct weak_simd_op {
+    template <typename S>
+    struct enabled : std::false_type {};
+};
+
+template <>
+struct weak_simd_op<weak_addition> {
+    template <typename S>
+    struct enabled : std::integral_constant<bool, S::enabled> {};
+
+    template <typename S>
+    static typename S::reg apply(typename S::reg val, typename S::reg val1) { return S::add(val, val1); }
+};
+
+template <>
+struct weak_simd_op<weak_subtraction> {
+    template <typename S>
+    struct enabled : std::integral_constant<bool, S::enabled> {};
+
+    template <typename S>
+    static typename S::reg apply(typename S::reg val, typename S::reg val1) { return S::sub(val, val1); }
+};
+
+template <>
+struct weak_simd_op<weak_multiplication> {
+    template <typename S>
+    struct enabled : std::integral_constant<bool, S::enabled && S::has_mul> {};
+
+    template <typename S>
+    static typename S::reg apply(typename S::reg val, typename S::reg val1) { return S::mul(val, val1); }
+};
+
+template <>
+struct weak_simd_op<weak_division> {
+    template <typename S>
+    struct enabled : std::integral_constant<bool, S::enabled && S::has_div> {};
+
+    template <typename S>
+    static typename S::reg apply(typename S::reg val, typename S::reg val1) { return S::div(val, val1); }
+};
+
+template <>
+struct weak_simd_op<weak_equal> {
+    template <typename S>
+    struct enabled : std::integral_constant<bool, S::enabled> {};
+
+    template <typename S>
+    static int apply(typename S::reg val, typename S::reg val1) { return S::eq(val, val1); }
+};
+
+template <>
+struct weak_simd_op<weak_not_equal> {
+    template <typename S>
+    struct enabled : std::integral_constant<bool, S::enabled> {};
+
+    template <typename S>
+    static int apply(typename S::reg val, typename S::reg val1) { return S::ne(val, val1); }
+};
+
+template <>
+struct weak_simd_op<weak_less_than> {
+    template <typename S>
+    struct enabled : std::integral_constant<bool, S::enabled> {};
+
+    template <typename S>
+    static int apply(typename S::reg val, typename S::reg val1) { return S::lt(val, val1); }
+};
+
+template <>
+struct weak_simd_op<weak_greater_than> {
+    template <typename S>
+    struct enabled : std::integral_constant<bool, S::enabled> {};
+
+    template <typename S>
+    static int apply(typename S::reg val, typename S::reg val1) { return S::gt(val, val1); }
+};
+
+template <>
+struct weak_simd_op<weak_less_than_equal_to> {
+    template <typename S>
+    struct enabled : std::integral_constant<bool, S::enabled> {};
+
+    template <typename S>
+    static int apply(typename S::reg val, typename S::reg val1) { return S::le(val, val1); }
+};
+
+template <>
+struct weak_simd_op<weak_greater_than_equal_to> {
+    template <typename S>
+    struct enabled : std::integral_constant<bool, S::enabled> {};
+
+    template <typename S>
+    static int apply(typename S::reg val, typename S::reg val1) { return S::ge(val, val1); }
+};
+
+// Runs Op over contiguous arrays of T, with vector instructions when weak_simd_op<Op> supports T.
+template <typename Op, typename T, bool = weak_simd_op<Op>::template enabled<weak_simd<T>>::value>
+struct weak_simd_kernel {
+    static void apply(const T* left, const T* right, T* result, std::size_t count) {
+        for (std::size_t i = 0; i < count; i++) {
+            result[i] = Op::apply(left[i], right[i]);
+        }
+    }
+
+    // bit i of the result is Op on left[i] and right[i]
+    static std::uint64_t compare(const T* left, const T* right, std::size_t count) {
+        std::uint64_t bits = 0;
+
+        for (std::size_t i = 0; i < count; i++) {
+            bits |= std::uint64_t(Op::apply(left[i], right[i])) << i;
+        }
+
+        return bits;
+    }
+};
+
+template <typename Op, typename T>
+struct weak_simd_kernel<Op, T, true> {
+    typedef weak_simd<T> simd;
+
+    static void apply(const T* left, const T* right, T* result, std::size_t count) {
+        std::size_t i = 0;
+
+        for (; i + simd::lanes <= count; i += simd::lanes) {
+            simd::store(result + i,
+                        weak_simd_op<Op>::template apply<simd>(simd::load(left + i), simd::load(right + i)));
+        }
+
+        weak_simd_kernel<Op, T, false>::apply(left + i, right + i, result + i, count - i);
+    }
+
+    static std::uint64_t compare(const T* left, const T* right, std::size_t count) {
+        std::uint64_t bits = 0;
+        std::size_t i = 0;
+
+        for (; i + simd::lanes <= count; i += simd::lanes) {
+            std::uint64_t lanes = static_cast<unsigned>(
+                    weak_simd_op<Op>::template apply<simd>(simd::load(left + i), simd::load(right + i)));
+            bits |= lanes << i;
+        }
+
+        if (i < count) {
+            bits |= weak_simd_kernel<Op, T, false>::compare(left + i, right + i, count - i) << i;
+        }
+
+        return bits;
+    }
+};
+
+//=== batches ===//
+
+// Element-wise versions of the weak operators. The inputs are split into runs whose elements have the same pair of
+// types, the kernel for each run is looked up once, and runs of two floats, doubles or int32s go through
+// weak_simd_kernel. Results have the same types as the scalar operators would give.
+// Arithmetic writes a weak per element. Comparisons write one bit per element, bit i in mask[i / 64], so mask needs
+// (count + 63) / 64 words.
+// Arrays must have the same length, result may be one of the inputs.
+template <typename ... Types>
+class weak_batch {
+
+    typedef weak<Types...> value_type;
+
+    // elements handled per vectorized chunk, one mask word
+    static constexpr std::size_t chunk = 64;
+
+    //// inputs
+
+    struct weak_array {
+        const value_type* values;
+
+        std::size_t index(std::size_t i) const {
+            return values[i].index();
+        }
+
+        const void* address(std::size_t i) const {
+            return values[i].address();
+        }
+
+        template <typename T>
+        const T* contiguous(std::size_t, std::size_t) const {
+            return nullptr;
+        }
+
+        template <typename T>
+        const T& get(std::size_t i) const {
+            return values[i].template value<T>();
+        }
+    };
+
+    struct vector_array {
+        const weak_vector<Types...>* values;
+
+        std::size_t index(std::size_t i) const {
+            return values -> tags[i];
+        }
+
+        const void* address(std::size_t i) const {
+            return values -> address(i);
+        }
+
+        /// values of elements first to first + count if they are next to each other in their column
+        template <typename T>
+        const T* contiguous(std::size_t first, std::size_t count) const {
+            for (std::size_t i = 1; i < count; i++) {
+                if (values -> slots[first + i] != values -> slots[first] + i) {
+                    return nullptr;
+                }
+            }
+
+            return &get<T>(first);
+        }
+
+        template <typename T>
+        const T& get(std::size_t i) const {
+            return values -> template columnOf<T>().values[values -> slots[i]];
+        }
+    };
+
+    //// outputs
+
+    struct weak_sink {
+        value_type* values;
+
+        void put(std::size_t i, value_type&& val) {
+            values[i] = std::move(val);
+        }
+
+        template <typename T>
+        void put(std::size_t i, const T& val) {
+            values[i].emplace(val);
+        }
+    };
+
+    // appends in order
+    struct vector_sink {
+        weak_vector<Types...>* values;
+
+        void put(std::size_t, value_type&& val) {
+            values -> push_back(val);
+        }
+
+        template <typename T>
+        void put(std::size_t, const T& val) {
+            values -> emplace_back(val);
+        }
+    };
+
+    struct mask_sink {
+        std::uint64_t* mask;
+
+        void put(std::size_t i, bool val) {
+            std::uint64_t bit = std::uint64_t(1) << (i % 64);
+            mask[i / 64] = val ? mask[i / 64] | bit : mask[i / 64] & ~bit;
+        }
+
+        // bits for elements first to first + count, which are within one mask word
+        void put(std::size_t first, std::size_t count, std::uint64_t bits) {
+            std::uint64_t keep = count == 64 ? 0 : ~(((std::uint64_t(1) << count) - 1) << (first % 64));
+            mask[first / 64] = (mask[first / 64] & keep) | (bits << (first % 64));
+        }
+    };
+
+    //// runs
+
+    /// runs of arithmetic, mixed runs go through the operator's kernel matrix and same type runs of vectorizable types
+    /// through weak_simd_kernel
+    template <typename Op, typename Left, typename Right, typename Sink>
+    struct arithmetic_runs {
+        typedef Left left_type;
+        typedef Right right_type;
+        typedef Sink sink_type;
+
+        template <typename T>
+        struct vectorized : weak_simd_op<Op>::template enabled<weak_simd<T>> {};
+
+        static void mixed(const Left& left, const Right& right, Sink& sink, std::size_t first, std::size_t last) {
+            auto kernel = weak_binary_table<Op, value_type, Types...>::lookup(left.index(first), right.index(first));
+
+            for (std::size_t i = first; i < last; i++) {
+                value_type result;
+                kernel(left.address(i), right.address(i), &result);
+                sink.put(i, std::move(result));
+            }
+        }
+
+        template <typename T>
+        static void same(const Left& left, const Right& right, Sink& sink, std::size_t first, std::size_t last) {
+            T leftValues[chunk];
+            T rightValues[chunk];
+            T results[chunk];
+
+            for (std::size_t start = first; start < last; start += chunk) {
+                std::size_t count = last - start < chunk ? last - start : chunk;
+
+                // gather unless the values already sit next to each other
+                const T* leftChunk = left.template contiguous<T>(start, count);
+                const T* rightChunk = right.template contiguous<T>(start, count);
+
+                for (std::size_t i = 0; leftChunk == nullptr && i < count; i++) {
+                    leftValues[i] = left.template get<T>(start + i);
+                }
+
+                for (std::size_t i = 0; rightChunk == nullptr && i < count; i++) {
+                    rightValues[i] = right.template get<T>(start + i);
+                }
+
+                weak_simd_kernel<Op, T>::apply(leftChunk != nullptr ? leftChunk : leftValues,
+                                               rightChunk != nullptr ? rightChunk : rightValues, results, count);
+
+                for (std::size_t i = 0; i < count; i++) {
+                    sink.put(start + i, results[i]);
+                }
+            }
+        }
+    };
+
+    template <typename Op, typename Left, typename Right, typename Sink>
+    struct compare_runs {
+        typedef Left left_type;
+        typedef Right right_type;
+        typedef Sink sink_type;
+
+        template <typename T>
+        struct vectorized : weak_simd_op<Op>::template enabled<weak_simd<T>> {};
+
+        static void mixed(const Left& left, const Right& right, Sink& sink, std::size_t first, std::size_t last) {
+            auto kernel = weak_binary_table<Op, bool, Types...>::lookup(left.index(first), right.index(first));
+
+            for (std::size_t i = first; i < last; i++) {
+                bool result = false;
+                kernel(left.address(i), right.address(i), &result);
+                sink.put(i, result);
+            }
+        }
+
+        template <typename T>
+        static void same(const Left& left, const Right& right, Sink& sink, std::size_t first, std::size_t last) {
+            T leftValues[chunk];
+            T rightValues[chunk];
+
+            for (std::size_t start = first; start < last; ) {
+                // stay within one mask word
+                std::size_t count = chunk - start % chunk;
+                count = last - start < count ? last - start : count;
+
+                const T* leftChunk = left.template contiguous<T>(start, count);
+                const T* rightChunk = right.template contiguous<T>(start, count);
+
+                for (std::size_t i = 0; leftChunk == nullptr && i < count; i++) {
+                    leftValues[i] = left.template get<T>(start + i);
+                }
+
+                for (std::size_t i = 0; rightChunk == nullptr && i < count; i++) {
+                    rightValues[i] = right.template get<T>(start + i);
+                }
+
+                std::uint64_t bits = weak_simd_kernel<Op, T>::compare(
+                        leftChunk != nullptr ? leftChunk : leftValues,
+                        rightChunk != nullptr ? rightChunk : rightValues, count);
+
+                sink.put(start, count, bits);
+                start += count;
+            }
+        }
+    };
+
+    /// splits the inputs into runs of one pair of types and hands each run to Runs
+    template <typename Runs,
+              typename Left = typename Runs::left_type,
+              typename Right = typename Runs::right_type,
+              typename Sink = typename Runs::sink_type>
+    struct runs {
+
+        typedef void (*handler)(const Left&, const Right&, Sink&, std::size_t, std::size_t);
+
+        template <typename T, bool = Runs::template vectorized<T>::value>
+        struct same {
+            static constexpr handler value() {
+                return &Runs::mixed;
+            }
+        };
+
+        template <typename T>
+        struct same<T, true> {
+            static constexpr handler value() {
+                return &Runs::template same<T>;
+            }
+        };
+
+        static void apply(const Left& left, const Right& right, Sink& sink, std::size_t count) {
+            // slot 0 handles mixed pairs and invalid values
+            static const handler table[] = { &Runs::mixed, same<Types>::value()... };
+
+            for (std::size_t first = 0; first < count; ) {
+                std::size_t leftIndex = left.index(first);
+                std::size_t rightIndex = right.index(first);
+
+                std::size_t last = first + 1;
+                while (last < count && left.index(last) == leftIndex && right.index(last) == rightIndex) {
+                    last++;
+                }
+
+                table[leftIndex == rightIndex ? leftIndex : 0](left, right, sink, first, last);
+                first = last;
+            }
+        }
+    };
+
+    template <typename Op>
+    static void arithmetic(const value_type* left, const value_type* right, value_type* result, std::size_t count) {
+        weak_sink sink = { result };
+        runs<arithmetic_runs<Op, weak_array, weak_array, weak_sink>>::apply(
+                weak_array{ left }, weak_array{ right }, sink, count);
+    }
+
+    template <typename Op>
+    static void arithmetic(const weak_vector<Types...>& left, const weak_vector<Types...>& right,
+                           weak_vector<Types...>& result) {
+        // result may be one of the inputs, so fill a new vector
+        weak_vector<Types...> filled;
+        filled.reserve(left.size());
+
+        vector_sink sink = { &filled };
+        runs<arithmetic_runs<Op, vector_array, vector_array, vector_sink>>::apply(
+                vector_array{ &left }, vector_array{ &right }, sink, left.size());
+
+        result = std::move(filled);
+    }
+
+    template <typename Op>
+    static void compare(const value_type* left, const value_type* right, std::uint64_t* mask, std::size_t count) {
+        mask_sink sink = { mask };
+        runs<compare_runs<Op, weak_array, weak_array, mask_sink>>::apply(
+                weak_array{ left }, weak_array{ right }, sink, count);
+    }
+
+    template <typename Op>
+    static void compare(const weak_vector<Types...>& left, const weak_vector<Types...>& right, std::uint64_t* mask) {
+        mask_sink sink = { mask };
+        runs<compare_runs<Op, vector_array, vector_array, mask_sink>>::apply(
+                vector_array{ &left }, vector_array{ &right }, sink, left.size());
+    }
+
+public:
+
+    ///// Arithmetic /////
+
+    static void add(const value_type* left, const value_type* right, value_type* result, std::size_t count) {
+        arithmetic<weak_addition>(left, right, result, count);
+    }
+
+    static void add(const weak_vector<Types...>& left, const weak_vector<Types...>& right,
+                    weak_vector<Types...>& result) {
+        arithmetic<weak_addition>(left, right, result);
+    }
+
+    static void subtract(const value_type* left, const value_type* right, value_type* result, std::size_t count) {
+        arithmetic<weak_subtraction>(left, right, result, count);
+    }
+
+    static void subtract(const weak_vector<Types...>& left, const weak_vector<Types...>& right,
+                         weak_vector<Types...>& result) {
+        arithmetic<weak_subtraction>(left, right, result);
+    }
+
+    static void multiply(const value_type* left, const value_type* right, value_type* result, std::size_t count) {
+        arithmetic<weak_multiplication>(left, right, result, count);
+    }
+
+    static void multiply(const weak_vector<Types...>& left, const weak_vector<Types...>& right,
+                         weak_vector<Types...>& result) {
+        arithmetic<weak_multiplication>(left, right, result);
+    }
+
+    static void divide(const value_type* left, const value_type* right, value_type* result, std::size_t count) {
+        arithmetic<weak_division>(left, right, result, count);
+    }
+
+    static void divide(const weak_vector<Types...>& left, const weak_vector<Types...>& right,
+                       weak_vector<Types...>& result) {
+        arithmetic<weak_division>(left, right, result);
+    }
+
+    ///// Comparisons /////
+
+    static void equal(const value_type* left, const value_type* right, std::uint64_t* mask, std::size_t count) {
+        compare<weak_equal>(left, right, mask, count);
+    }
+
+    static void equal(const weak_vector<Types...>& left, const weak_vector<Types...>& right, std::uint64_t* mask) {
+        compare<weak_equal>(left, right, mask);
+    }
+
+    static void not_equal(const value_type* left, const value_type* right, std::uint64_t* mask, std::size_t count) {
+        compare<weak_not_equal>(left, right, mask, count);
+    }
+
+    static void not_equal(const weak_vector<Types...>& left, const weak_vector<Types...>& right, std::uint64_t* mask) {
+        compare<weak_not_equal>(left, right, mask);
+    }
+
+    static void less_than(const value_type* left, const value_type* right, std::uint64_t* mask, std::size_t count) {
+        compare<weak_less_than>(left, right, mask, count);
+    }
+
+    static void less_than(const weak_vector<Types...>& left, const weak_vector<Types...>& right, std::uint64_t* mask) {
+        compare<weak_less_than>(left, right, mask);
+    }
+
+    static void greater_than(const value_type* left, const value_type* right, std::uint64_t* mask,
+                             std::size_t count) {
+        compare<weak_greater_than>(left, right, mask, count);
+    }
+
+    static void greater_than(const weak_vector<Types...>& left, const weak_vector<Types...>& right,
+                             std::uint64_t* mask) {
+        compare<weak_greater_than>(left, right, mask);
+    }
+
+    static void less_than_equal_to(const value_type* left, const value_type* right, std::uint64_t* mask,
+                                   std::size_t count) {
+        compare<weak_less_than_equal_to>(left, right, mask, count);
+    }
+
+    static void less_than_equal_to(const weak_vector<Types...>& left, const weak_vector<Types...>& right,
+                                   std::uint64_t* mask) {
+        compare<weak_less_than_equal_to>(left, right, mask);
+    }
+
+    static void greater_than_equal_to(const value_type* left, const value_type* right, std::uint64_t* mask,
+                                      std::size_t count) {
+        compare<weak_greater_than_equal_to>(left, right, mask, count);
+    }
+
+    static void greater_than_equal_to(const weak_vector<Types...>& left, const weak_vector<Types...>& right,
+                                      std::uint64_t* mask) {
+        compare<weak_greater_than_equal_to>(left, right, mask);
+    }
+};
+
+#endif //WEAK_TYPES_WEAK_BATCH_H
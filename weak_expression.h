@@ -0,0 +1,289 @@
+//
+// Expression templates for weak arithmetic, evaluated in one pass when assigned to a weak.
+//
+
+#ifndef WEAK_TYPES_WEAK_EXPRESSION_H
+#define WEAK_TYPES_WEAK_EXPRESSION_H
+
+#include "weak.h"
+
+//=== continuations ===//
+
+// Expressions are evaluated by passing each value, with its real type, on to a continuation. Every weak in the expression
+// is dispatched once, and the intermediate results are plain values of the underlying types instead of weak temporaries.
+// Each continuation also has invalid(), called instead when a weak is invalid or an operation is not defined.
+
+// stores the final value in a weak
+template <typename Weak>
+struct weak_assign_continuation {
+    Weak* into;
+
+    template <typename T>
+    void operator() (const T& val) const {
+        assign(val, std::is_constructible<Weak, const T&>());
+    }
+
+    template <typename T>
+    void assign(const T& val, std::true_type) const {
+        *into = val;
+    }
+
+    // the result is not one of the weak's types
+    template <typename T>
+    void assign(const T&, std::false_type) const {
+        *into = Weak();
+    }
+
+    void invalid() const {
+        *into = Weak();
+    }
+};
+
+// has the left value of Op, runs Op once the right value is known
+template <typename Op, typename Left, typename Continuation>
+struct weak_right_continuation {
+    const Left& left;
+    const Continuation& next;
+
+    template <typename Right>
+    void operator() (const Right& right) const {
+        apply(right, typename Op::template defined<Left, Right>());
+    }
+
+    template <typename Right>
+    void apply(const Right& right, std::true_type) const {
+        next(Op::apply(left, right));
+    }
+
+    template <typename Right>
+    void apply(const Right&, std::false_type) const {
+        next.invalid();
+    }
+
+    void invalid() const {
+        next.invalid();
+    }
+};
+
+// evaluates the right side of Op once the left value is known
+template <typename Op, typename RightNode, typename Continuation>
+struct weak_left_continuation {
+    const RightNode& right;
+    const Continuation& next;
+
+    template <typename Left>
+    void operator() (const Left& left) const {
+        right.eval(weak_right_continuation<Op, Left, Continuation>{ left, next });
+    }
+
+    void invalid() const {
+        next.invalid();
+    }
+};
+
+//=== nodes ===//
+
+// a weak in the expression, referenced until the expression is evaluated
+template <typename Weak>
+struct weak_leaf {
+    const Weak* value;
+
+    template <typename T, typename Continuation>
+    struct call {
+        void operator() (const T& val, const Continuation& next) const {
+            next(val);
+        }
+    };
+
+    template <typename Continuation>
+    void eval(const Continuation& next) const {
+        if (!value -> isValid()) {
+            next.invalid();
+            return;
+        }
+
+        value -> template run<call, Continuation>(next);
+    }
+};
+
+// an arithmetic constant, its type is known so it isn't dispatched
+template <typename T>
+struct weak_constant {
+    T value;
+
+    template <typename Continuation>
+    void eval(const Continuation& next) const {
+        next(value);
+    }
+};
+
+template <typename Op, typename Left, typename Right>
+struct weak_node {
+    Left left;
+    Right right;
+
+    template <typename Continuation>
+    void eval(const Continuation& next) const {
+        left.eval(weak_left_continuation<Op, Right, Continuation>{ right, next });
+    }
+};
+
+//=== weak_expression ===//
+
+// The result of arithmetic on weak_lazy(w), or of the operators of weak when WEAK_LAZY_OPERATORS is defined. It keeps
+// references to the weak values it was built from, so it must be assigned to a Weak before the end of the full
+// expression it was created in. Each distinct combination of types of its weak values instantiates its own evaluation,
+// so it is meant for short formulas.
+template <typename Weak, typename Node>
+class weak_expression {
+
+    template <typename W, typename N>
+    friend class weak_expression;
+
+    template <typename T>
+    using arithmetic = typename std::enable_if<std::is_arithmetic<T>::value>::type;
+
+    template <typename Op, typename Right>
+    using combined = weak_expression<Weak, weak_node<Op, Node, Right>>;
+
+public:
+    typedef Weak weak_type;
+
+    Node node;
+
+    explicit weak_expression(const Node& node) : node(node) {}
+
+    /// evaluates the expression into into, which may be one of the weak values it was built from
+    void evaluate(Weak& into) const {
+        node.eval(weak_assign_continuation<Weak>{ &into });
+    }
+
+    operator Weak() const {
+        Weak result;
+        evaluate(result);
+        return result;
+    }
+
+    ///// Arithmetic Operators /////
+
+    /// Addition
+    template <typename Right>
+    combined<weak_addition, Right> operator+ (const weak_expression<Weak, Right>& right) const {
+        return combined<weak_addition, Right>({ node, right.node });
+    }
+
+    combined<weak_addition, weak_leaf<Weak>> operator+ (const Weak& right) const {
+        return combined<weak_addition, weak_leaf<Weak>>({ node, { &right } });
+    }
+
+    template <typename T, typename = arithmetic<T>>
+    combined<weak_addition, weak_constant<T>> operator+ (T right) const {
+        return combined<weak_addition, weak_constant<T>>({ node, { right } });
+    }
+
+    /// Subtraction
+    template <typename Right>
+    combined<weak_subtraction, Right> operator- (const weak_expression<Weak, Right>& right) const {
+        return combined<weak_subtraction, Right>({ node, right.node });
+    }
+
+    combined<weak_subtraction, weak_leaf<Weak>> operator- (const Weak& right) const {
+        return combined<weak_subtraction, weak_leaf<Weak>>({ node, { &right } });
+    }
+
+    template <typename T, typename = arithmetic<T>>
+    combined<weak_subtraction, weak_constant<T>> operator- (T right) const {
+        return combined<weak_subtraction, weak_constant<T>>({ node, { right } });
+    }
+
+    /// Multiplication
+    template <typename Right>
+    combined<weak_multiplication, Right> operator* (const weak_expression<Weak, Right>& right) const {
+        return combined<weak_multiplication, Right>({ node, right.node });
+    }
+
+    combined<weak_multiplication, weak_leaf<Weak>> operator* (const Weak& right) const {
+        return combined<weak_multiplication, weak_leaf<Weak>>({ node, { &right } });
+    }
+
+    template <typename T, typename = arithmetic<T>>
+    combined<weak_multiplication, weak_constant<T>> operator* (T right) const {
+        return combined<weak_multiplication, weak_constant<T>>({ node, { right } });
+    }
+
+    /// Division
+    template <typename Right>
+    combined<weak_division, Right> operator/ (const weak_expression<Weak, Right>& right) const {
+        return combined<weak_division, Right>({ node, right.node });
+    }
+
+    combined<weak_division, weak_leaf<Weak>> operator/ (const Weak& right) const {
+        return combined<weak_division, weak_leaf<Weak>>({ node, { &right } });
+    }
+
+    template <typename T, typename = arithmetic<T>>
+    combined<weak_division, weak_constant<T>> operator/ (T right) const {
+        return combined<weak_division, weak_constant<T>>({ node, { right } });
+    }
+};
+
+/// starts an expression from a weak, e.g. weak_lazy(a) + b * c
+template <typename Weak>
+weak_expression<Weak, weak_leaf<Weak>> weak_lazy(const Weak& value) {
+    return weak_expression<Weak, weak_leaf<Weak>>({ &value });
+}
+
+// a weak or a constant on the left of an expression
+
+template <typename Op, typename Left, typename Weak, typename Node>
+using weak_left_combined = weak_expression<Weak, weak_node<Op, Left, Node>>;
+
+template <typename Weak, typename Node>
+weak_left_combined<weak_addition, weak_leaf<Weak>, Weak, Node>
+operator+ (const typename weak_expression<Weak, Node>::weak_type& left, const weak_expression<Weak, Node>& right) {
+    return weak_left_combined<weak_addition, weak_leaf<Weak>, Weak, Node>({ { &left }, right.node });
+}
+
+template <typename T, typename Weak, typename Node, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+weak_left_combined<weak_addition, weak_constant<T>, Weak, Node>
+operator+ (T left, const weak_expression<Weak, Node>& right) {
+    return weak_left_combined<weak_addition, weak_constant<T>, Weak, Node>({ { left }, right.node });
+}
+
+template <typename Weak, typename Node>
+weak_left_combined<weak_subtraction, weak_leaf<Weak>, Weak, Node>
+operator- (const typename weak_expression<Weak, Node>::weak_type& left, const weak_expression<Weak, Node>& right) {
+    return weak_left_combined<weak_subtraction, weak_leaf<Weak>, Weak, Node>({ { &left }, right.node });
+}
+
+template <typename T, typename Weak, typename Node, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+weak_left_combined<weak_subtraction, weak_constant<T>, Weak, Node>
+operator- (T left, const weak_expression<Weak, Node>& right) {
+    return weak_left_combined<weak_subtraction, weak_constant<T>, Weak, Node>({ { left }, right.node });
+}
+
+template <typename Weak, typename Node>
+weak_left_combined<weak_multiplication, weak_leaf<Weak>, Weak, Node>
+operator* (const typename weak_expression<Weak, Node>::weak_type& left, const weak_expression<Weak, Node>& right) {
+    return weak_left_combined<weak_multiplication, weak_leaf<Weak>, Weak, Node>({ { &left }, right.node });
+}
+
+template <typename T, typename Weak, typename Node, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+weak_left_combined<weak_multiplication, weak_constant<T>, Weak, Node>
+operator* (T left, const weak_expression<Weak, Node>& right) {
+    return weak_left_combined<weak_multiplication, weak_constant<T>, Weak, Node>({ { left }, right.node });
+}
+
+template <typename Weak, typename Node>
+weak_left_combined<weak_division, weak_leaf<Weak>, Weak, Node>
+operator/ (const typename weak_expression<Weak, Node>::weak_type& left, const weak_expression<Weak, Node>& right) {
+    return weak_left_combined<weak_division, weak_leaf<Weak>, Weak, Node>({ { &left }, right.node });
+}
+
+template <typename T, typename Weak, typename Node, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+weak_left_combined<weak_division, weak_constant<T>, Weak, Node>
+operator/ (T left, const weak_expression<Weak, Node>& right) {
+    return weak_left_combined<weak_division, weak_constant<T>, Weak, Node>({ { left }, right.node });
+}
+
+#endif //WEAK_TYPES_WEAK_EXPRESSION_H
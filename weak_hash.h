@@ -0,0 +1,135 @@
+//
+// Hashing of weak values, consistent with their operator==.
+//
+
+#ifndef WEAK_TYPES_WEAK_HASH_H
+#define WEAK_TYPES_WEAK_HASH_H
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include "weak.h"
+
+//=== weak_value_hash ===//
+
+// Hash of one stored value. Numbers that compare equal hash equal regardless of their type, so weak(1), weak(1.0)
+// and weak('\x01') all hash the same: a number that is a whole int64 is hashed as that int64, any other number as the
+// bits of its double. Integers beyond 2^53 compare equal to the double they round to, so they hash as that double.
+// std::string and C strings hash by their chars, like std::string compares with a C string, so a weak holding
+// "abc" as a const char* hashes like one holding it as a std::string. Other types use std::hash. Specialize
+// weak_value_hash to hash other types.
+// A negative signed integer and an unsigned one compare like C++ compares them, so -1 equals UINT64_MAX, which equals
+// the double UINT64_MAX rounds to, which -1 doesn't. No hash can follow that, so such keys hash by their value instead
+// and shouldn't be mixed in one table.
+template <typename T, typename enable = void>
+struct weak_value_hash {
+    void operator() (const T& val, std::size_t& hashed) const {
+        hashed = std::hash<T>()(val);
+    }
+};
+
+// spreads the bits of a number over the whole hash, from MurmurHash3's finalizer
+inline std::size_t weak_mix(std::uint64_t bits) {
+    bits ^= bits >> 33;
+    bits *= 0xff51afd7ed558ccdu;
+    bits ^= bits >> 33;
+    bits *= 0xc4ceb9fe1a85ec53u;
+    bits ^= bits >> 33;
+    return static_cast<std::size_t>(bits);
+}
+
+/// hash of size bytes, read a word at a time
+inline std::size_t weak_hash_bytes(const void* data, std::size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    std::uint64_t hashed = size;
+
+    for (; size >= sizeof(std::uint64_t); size -= sizeof(std::uint64_t), bytes += sizeof(std::uint64_t)) {
+        std::uint64_t word;
+        std::memcpy(&word, bytes, sizeof(std::uint64_t));
+        hashed = weak_mix(hashed ^ word) + word;
+    }
+
+    std::uint64_t rest = 0u;
+    std::memcpy(&rest, bytes, size);
+
+    return weak_mix(hashed ^ rest);
+}
+
+inline std::size_t weak_hash_number(double val) {
+    // whole numbers in range hash like the integer they are equal to, this includes -0.0
+    if (val >= -9223372036854775808.0 && val < 9223372036854775808.0 && double(std::int64_t(val)) == val) {
+        return weak_mix(static_cast<std::uint64_t>(std::int64_t(val)));
+    }
+
+    std::uint64_t bits;
+    std::memcpy(&bits, &val, sizeof(double));
+    return weak_mix(bits);
+}
+
+inline std::size_t weak_hash_number(std::int64_t val) {
+    // past 2^53 not every integer is a double, and comparing with one rounds the integer to the nearest double first
+    const std::int64_t exact = std::int64_t(1) << 53;
+    if (val > exact || val < -exact) {
+        return weak_hash_number(double(val));
+    }
+
+    return weak_mix(static_cast<std::uint64_t>(val));
+}
+
+template <typename T>
+struct weak_value_hash<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+    void operator() (const T& val, std::size_t& hashed) const {
+        hashed = weak_hash_number(double(val));
+    }
+};
+
+template <typename T>
+struct weak_value_hash<T, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type> {
+    void operator() (const T& val, std::size_t& hashed) const {
+        hashed = weak_hash_number(std::int64_t(val));
+    }
+};
+
+template <typename T>
+struct weak_value_hash<T, typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value>::type> {
+    void operator() (const T& val, std::size_t& hashed) const {
+        // too large for an int64, so only equal to a double
+        hashed = val > T(INT64_MAX) ? weak_hash_number(double(val)) : weak_hash_number(std::int64_t(val));
+    }
+};
+
+template <>
+struct weak_value_hash<std::string> {
+    void operator() (const std::string& val, std::size_t& hashed) const {
+        hashed = weak_hash_bytes(val.data(), val.size());
+    }
+};
+
+// by the chars pointed to, a null pointer hashes like an empty string
+template <typename T>
+struct weak_value_hash<T, typename std::enable_if<std::is_same<T, const char*>::value ||
+                                                  std::is_same<T, char*>::value>::type> {
+    void operator() (const T& val, std::size_t& hashed) const {
+        hashed = val == nullptr ? weak_hash_bytes("", 0) : weak_hash_bytes(val, std::strlen(val));
+    }
+};
+
+//=== weak_hash ===//
+
+// Hashes any weak by its stored value with weak_value_hash, an invalid weak hashes to 0.
+struct weak_hash {
+    template <typename Weak>
+    std::size_t operator() (const Weak& value) const {
+        std::size_t hashed = 0u;
+        value.template run<weak_value_hash>(hashed);
+        return hashed;
+    }
+};
+
+namespace std {
+    template <typename ... Types>
+    struct hash<weak<Types...>> : weak_hash {};
+}
+
+#endif //WEAK_TYPES_WEAK_HASH_H
@@ -0,0 +1,509 @@
+//
+// Open addressing hash map and set keyed by weak values.
+//
+
+#ifndef WEAK_TYPES_WEAK_HASH_MAP_H
+#define WEAK_TYPES_WEAK_HASH_MAP_H
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include "weak.h"
+#include "weak_hash.h"
+
+// Define WEAK_NO_SIMD to always use the scalar loops.
+#ifndef WEAK_NO_SIMD
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#endif
+
+//=== control bytes ===//
+
+// Every slot has a control byte: the low 7 bits of its key's hash when it is full, a negative marker otherwise.
+// Slots are probed in aligned groups of 16, whose control bytes are compared with the hash all at once.
+struct weak_control {
+    static constexpr std::int8_t empty = -128;
+    static constexpr std::int8_t deleted = -2;
+
+    static constexpr std::size_t group_size = 16;
+
+    // one bit per slot of the group, slot 0 in bit 0
+    typedef std::uint32_t mask;
+
+#if !defined(WEAK_NO_SIMD) && defined(__SSE2__)
+    __m128i bytes;
+
+    explicit weak_control(const std::int8_t* group) : bytes(_mm_loadu_si128(reinterpret_cast<const __m128i*>(group))) {}
+
+    mask match(std::int8_t hash) const {
+        return static_cast<mask>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(hash), bytes)));
+    }
+
+    mask matchEmpty() const {
+        return match(empty);
+    }
+
+    // the markers are the only negative bytes
+    mask matchFree() const {
+        return static_cast<mask>(_mm_movemask_epi8(bytes));
+    }
+#else
+    const std::int8_t* bytes;
+
+    explicit weak_control(const std::int8_t* group) : bytes(group) {}
+
+    mask match(std::int8_t hash) const {
+        mask matched = 0u;
+        for (std::size_t i = 0; i < group_size; ++i) {
+            matched |= mask(bytes[i] == hash) << i;
+        }
+        return matched;
+    }
+
+    mask matchEmpty() const {
+        return match(empty);
+    }
+
+    mask matchFree() const {
+        mask matched = 0u;
+        for (std::size_t i = 0; i < group_size; ++i) {
+            matched |= mask(bytes[i] < 0) << i;
+        }
+        return matched;
+    }
+#endif
+
+    static std::size_t lowest(mask bits) {
+#if defined(__GNUC__)
+        return static_cast<std::size_t>(__builtin_ctz(bits));
+#else
+        std::size_t position = 0;
+        while ((bits & 1u) == 0u) {
+            bits >>= 1;
+            ++position;
+        }
+        return position;
+#endif
+    }
+};
+
+//=== weak_hash_table ===//
+
+// The table behind weak_hash_map and weak_hash_set. Values are stored in a flat array next to the control bytes, and
+// KeyOf gets the key from a value. Keys that don't compare equal to themselves, such as an invalid weak or NaN, can't
+// be found again and aren't inserted: emplace and insert return end() and false for them.
+template <typename Value, typename Key, typename KeyOf, typename Hash, typename Equal>
+class weak_hash_table {
+
+    std::int8_t* control;
+
+    Value* slots;
+
+    // a power of two multiple of the group size, or 0 before the first insertion
+    std::size_t capacity;
+
+    std::size_t count;
+
+    // insertions left before the table is 7/8 full, counting deleted slots as full
+    std::size_t growthLeft;
+
+    Hash hasher;
+
+    Equal equal;
+
+    static std::size_t mix(std::size_t hashed) {
+        return weak_mix(static_cast<std::uint64_t>(hashed));
+    }
+
+    static std::int8_t controlOf(std::size_t hashed) {
+        return static_cast<std::int8_t>(hashed & 0x7Fu);
+    }
+
+    std::size_t groupOf(std::size_t hashed) const {
+        return (hashed >> 7) & (capacity / weak_control::group_size - 1);
+    }
+
+    std::size_t groups() const {
+        return capacity / weak_control::group_size;
+    }
+
+    // groups are visited in triangular steps, which covers all of them when their number is a power of two
+    template <typename Visit>
+    std::size_t probe(std::size_t hashed, Visit visit) const {
+        std::size_t group = groupOf(hashed);
+
+        for (std::size_t step = 1; ; ++step) {
+            std::size_t found = visit(group * weak_control::group_size);
+            if (found != capacity) {
+                return found;
+            }
+            group = (group + step) & (groups() - 1);
+        }
+    }
+
+    /// the slot holding key, capacity or more if there is none
+    std::size_t lookup(const Key& key, std::size_t hashed) const {
+        if (capacity == 0) {
+            return 0;
+        }
+
+        std::int8_t tag = controlOf(hashed);
+
+        return probe(hashed, [&](std::size_t first) -> std::size_t {
+            weak_control group(control + first);
+
+            for (weak_control::mask matched = group.match(tag); matched != 0u; matched &= matched - 1) {
+                std::size_t slot = first + weak_control::lowest(matched);
+                if (equal(KeyOf()(slots[slot]), key)) {
+                    return slot;
+                }
+            }
+
+            // an insertion of key would have stopped at the empty slot, past the end means it's not there
+            return group.matchEmpty() != 0u ? capacity + 1 : capacity;
+        });
+    }
+
+    /// the first free slot on the probe sequence for hashed, there always is one
+    std::size_t freeSlot(std::size_t hashed) const {
+        return probe(hashed, [&](std::size_t first) -> std::size_t {
+            weak_control::mask free = weak_control(control + first).matchFree();
+            return free != 0u ? first + weak_control::lowest(free) : capacity;
+        });
+    }
+
+    /// replaces the buffers with empty ones of slotCount slots, or leaves the table as it was if that throws
+    void allocate(std::size_t slotCount) {
+        std::int8_t* allocatedControl = static_cast<std::int8_t*>(::operator new(slotCount));
+
+        Value* allocatedSlots;
+        try {
+            allocatedSlots = static_cast<Value*>(::operator new(slotCount * sizeof(Value)));
+        }
+        catch (...) {
+            ::operator delete(allocatedControl);
+            throw;
+        }
+
+        std::memset(allocatedControl, weak_control::empty, slotCount);
+
+        control = allocatedControl;
+        slots = allocatedSlots;
+        capacity = slotCount;
+        growthLeft = slotCount - slotCount / 8;
+    }
+
+    void release() noexcept {
+        for (std::size_t slot = 0; slot < capacity; ++slot) {
+            if (control[slot] >= 0) {
+                slots[slot].~Value();
+            }
+        }
+
+        ::operator delete(control);
+        ::operator delete(slots);
+
+        control = nullptr;
+        slots = nullptr;
+        capacity = 0;
+        count = 0;
+        growthLeft = 0;
+    }
+
+    void rehash(std::size_t slotCount) {
+        std::int8_t* oldControl = control;
+        Value* oldSlots = slots;
+        std::size_t oldCapacity = capacity;
+
+        allocate(slotCount);
+
+        for (std::size_t slot = 0; slot < oldCapacity; ++slot) {
+            if (oldControl[slot] >= 0) {
+                std::size_t hashed = mix(hasher(KeyOf()(oldSlots[slot])));
+                std::size_t into = freeSlot(hashed);
+
+                ::new (static_cast<void*>(slots + into)) Value(std::move(oldSlots[slot]));
+                control[into] = controlOf(hashed);
+                --growthLeft;
+
+                oldSlots[slot].~Value();
+            }
+        }
+
+        ::operator delete(oldControl);
+        ::operator delete(oldSlots);
+    }
+
+    // the smallest capacity that holds size values under the maximum load
+    static std::size_t capacityFor(std::size_t size) {
+        std::size_t slotCount = weak_control::group_size;
+        while (slotCount - slotCount / 8 < size) {
+            slotCount *= 2;
+        }
+        return slotCount;
+    }
+
+public:
+
+    template <bool Const>
+    class basic_iterator {
+
+        friend class weak_hash_table;
+
+        typedef typename std::conditional<Const, const weak_hash_table*, weak_hash_table*>::type table_pointer;
+
+        table_pointer table;
+
+        std::size_t slot;
+
+        void skipFree() {
+            while (slot < table -> capacity && table -> control[slot] < 0) {
+                ++slot;
+            }
+        }
+
+    public:
+        typedef typename std::conditional<Const, const Value, Value>::type value_type;
+
+        basic_iterator(table_pointer table, std::size_t slot) : table(table), slot(slot) {
+            skipFree();
+        }
+
+        operator basic_iterator<true>() const {
+            return basic_iterator<true>(table, slot);
+        }
+
+        value_type& operator*() const {
+            return table -> slots[slot];
+        }
+
+        value_type* operator->() const {
+            return table -> slots + slot;
+        }
+
+        basic_iterator& operator++() {
+            ++slot;
+            skipFree();
+            return *this;
+        }
+
+        bool operator==(const basic_iterator& other) const {
+            return slot == other.slot;
+        }
+
+        bool operator!=(const basic_iterator& other) const {
+            return slot != other.slot;
+        }
+    };
+
+    typedef basic_iterator<false> iterator;
+    typedef basic_iterator<true> const_iterator;
+
+    weak_hash_table() : control(nullptr), slots(nullptr), capacity(0), count(0), growthLeft(0) {}
+
+    weak_hash_table(const weak_hash_table& other) : weak_hash_table() {
+        reserve(other.count);
+        for (const Value& value : other) {
+            insert(value);
+        }
+    }
+
+    weak_hash_table(weak_hash_table&& other) noexcept
+            : control(other.control), slots(other.slots), capacity(other.capacity), count(other.count),
+              growthLeft(other.growthLeft) {
+        other.control = nullptr;
+        other.slots = nullptr;
+        other.capacity = 0;
+        other.count = 0;
+        other.growthLeft = 0;
+    }
+
+    weak_hash_table& operator=(weak_hash_table other) noexcept {
+        std::swap(control, other.control);
+        std::swap(slots, other.slots);
+        std::swap(capacity, other.capacity);
+        std::swap(count, other.count);
+        std::swap(growthLeft, other.growthLeft);
+        return *this;
+    }
+
+    ~weak_hash_table() {
+        release();
+    }
+
+    std::size_t size() const noexcept {
+        return count;
+    }
+
+    bool empty() const noexcept {
+        return count == 0;
+    }
+
+    void clear() noexcept {
+        release();
+    }
+
+    /// makes room for size values without rehashing
+    void reserve(std::size_t size) {
+        if (capacity == 0 || capacity - capacity / 8 < size) {
+            rehash(capacityFor(size));
+        }
+    }
+
+    iterator begin() {
+        return iterator(this, 0);
+    }
+
+    iterator end() {
+        return iterator(this, capacity);
+    }
+
+    const_iterator begin() const {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const {
+        return const_iterator(this, capacity);
+    }
+
+    iterator find(const Key& key) {
+        std::size_t slot = lookup(key, mix(hasher(key)));
+        return iterator(this, slot < capacity ? slot : capacity);
+    }
+
+    const_iterator find(const Key& key) const {
+        std::size_t slot = lookup(key, mix(hasher(key)));
+        return const_iterator(this, slot < capacity ? slot : capacity);
+    }
+
+    bool contains(const Key& key) const {
+        return lookup(key, mix(hasher(key))) < capacity;
+    }
+
+    /// constructs a value from args if there is none with key yet
+    template <typename ... Args>
+    std::pair<iterator, bool> emplace(const Key& key, Args&&... args) {
+        if (!equal(key, key)) {
+            return std::make_pair(end(), false);
+        }
+
+        std::size_t hashed = mix(hasher(key));
+        std::size_t slot = lookup(key, hashed);
+
+        if (slot < capacity) {
+            return std::make_pair(iterator(this, slot), false);
+        }
+
+        slot = capacity == 0 ? capacity : freeSlot(hashed);
+
+        // reusing a deleted slot doesn't use up room, filling an empty one does
+        if (slot == capacity || (control[slot] == weak_control::empty && growthLeft == 0)) {
+            // a full table grows, one that is only full of deleted slots is cleaned up
+            rehash(capacityFor(count + 1) > capacity ? (capacity == 0 ? capacityFor(1) : capacity * 2) : capacity);
+            slot = freeSlot(hashed);
+        }
+
+        ::new (static_cast<void*>(slots + slot)) Value(std::forward<Args>(args)...);
+
+        if (control[slot] == weak_control::empty) {
+            --growthLeft;
+        }
+        control[slot] = controlOf(hashed);
+        ++count;
+
+        return std::make_pair(iterator(this, slot), true);
+    }
+
+    std::pair<iterator, bool> insert(const Value& value) {
+        return emplace(KeyOf()(value), value);
+    }
+
+    std::pair<iterator, bool> insert(Value&& value) {
+        return emplace(KeyOf()(value), std::move(value));
+    }
+
+    /// removes the value with key, returns the number of values removed
+    std::size_t erase(const Key& key) {
+        std::size_t slot = lookup(key, mix(hasher(key)));
+        if (slot >= capacity) {
+            return 0;
+        }
+
+        slots[slot].~Value();
+
+        // if the group still has an empty slot no probe ever went past it, so this slot can be empty again
+        std::size_t first = slot - slot % weak_control::group_size;
+        if (weak_control(control + first).matchEmpty() != 0u) {
+            control[slot] = weak_control::empty;
+            ++growthLeft;
+        }
+        else {
+            control[slot] = weak_control::deleted;
+        }
+
+        --count;
+        return 1;
+    }
+};
+
+//=== weak_hash_map ===//
+
+template <typename Key, typename Mapped>
+struct weak_map_key {
+    const Key& operator() (const std::pair<const Key, Mapped>& value) const {
+        return value.first;
+    }
+};
+
+template <typename Key>
+struct weak_set_key {
+    const Key& operator() (const Key& value) const {
+        return value;
+    }
+};
+
+// An unordered map from weak values, usually weak<Types...>, to Mapped. Values live in one flat array of
+// std::pair<const Key, Mapped> with the weak's type index and payload inline, and are found by comparing a 16 byte
+// group of hash fragments at once. Keys hash and compare like their operator==, so a key of 1 finds a key of 1.0.
+template <typename Key, typename Mapped, typename Hash = weak_hash, typename Equal = std::equal_to<Key>>
+class weak_hash_map : public weak_hash_table<std::pair<const Key, Mapped>, Key, weak_map_key<Key, Mapped>, Hash, Equal> {
+
+    typedef weak_hash_table<std::pair<const Key, Mapped>, Key, weak_map_key<Key, Mapped>, Hash, Equal> table;
+
+public:
+    typedef std::pair<const Key, Mapped> value_type;
+
+    using table::insert;
+
+    std::pair<typename table::iterator, bool> insert(const Key& key, const Mapped& mapped) {
+        return table::emplace(key, key, mapped);
+    }
+
+    /// constructs the mapped value from args only if there is no value with key yet
+    template <typename ... Args>
+    std::pair<typename table::iterator, bool> try_emplace(const Key& key, Args&&... args) {
+        return table::emplace(key, std::piecewise_construct, std::forward_as_tuple(key),
+                              std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
+    /// the value for key, default constructed first if there is none. Throws std::invalid_argument for a key that
+    /// doesn't compare equal to itself, which has no value to refer to.
+    Mapped& operator[](const Key& key) {
+        std::pair<typename table::iterator, bool> found = try_emplace(key);
+        if (found.first == table::end()) {
+            throw std::invalid_argument("weak_hash_map: key does not compare equal to itself");
+        }
+        return found.first -> second;
+    }
+};
+
+// An unordered set of weak values, stored and probed like weak_hash_map.
+template <typename Key, typename Hash = weak_hash, typename Equal = std::equal_to<Key>>
+class weak_hash_set : public weak_hash_table<Key, Key, weak_set_key<Key>, Hash, Equal> {};
+
+#endif //WEAK_TYPES_WEAK_HASH_MAP_H
@@ -0,0 +1,413 @@
+//
+// Parses text straight into the alternative of a weak it belongs to.
+//
+
+#ifndef WEAK_TYPES_WEAK_PARSE_H
+#define WEAK_TYPES_WEAK_PARSE_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include "weak.h"
+
+//=== scanning ===//
+
+// The shape of a token: text, an integer or a floating point number, with its digits already read. Numbers follow
+// the syntax of strtod without hexadecimal: an optional sign, digits with an optional fraction and exponent, or inf,
+// infinity and nan in any case.
+struct weak_number_scan {
+    enum kind_type { text, integer, floating };
+
+    kind_type kind;
+
+    bool negative;
+
+    // the first 19 significant digits
+    std::uint64_t mantissa;
+
+    // power of ten the mantissa is multiplied by
+    int exponent;
+
+    // no digits other than zeros were left out of the mantissa
+    bool exact;
+
+    // inf, infinity or nan
+    bool special;
+
+    static constexpr int max_digits = 19;
+
+    static bool digit(char c) {
+        return static_cast<unsigned char>(c - '0') < 10u;
+    }
+
+    // compares text case insensitively with a lower case word
+    static bool matches(const char* first, const char* last, const char* word) {
+        for (; first != last; ++first, ++word) {
+            if (*word == '\0' || (*first | 0x20) != *word) {
+                return false;
+            }
+        }
+        return *word == '\0';
+    }
+
+    weak_number_scan(const char* first, const char* last)
+            : kind(text), negative(false), mantissa(0u), exponent(0), exact(true), special(false) {
+        const char* p = first;
+
+        if (p != last && (*p == '-' || *p == '+')) {
+            negative = *p == '-';
+            ++p;
+        }
+
+        if (p != last && !digit(*p) && *p != '.') {
+            special = matches(p, last, "inf") || matches(p, last, "infinity") || matches(p, last, "nan");
+            kind = special ? floating : text;
+            return;
+        }
+
+        // the digits are read into locals, members could be changed through the chars as far as the compiler knows
+        std::uint64_t digitsValue = 0u;
+        int digitsExponent = 0;
+        bool allRead = true;
+
+        // leading zeros are not significant, digits are counted from the first other one
+        const char* start = p;
+        while (p != last && *p == '0') {
+            ++p;
+        }
+
+        const char* significant = p;
+        for (; p != last && digit(*p); ++p) {
+            if (p - significant < max_digits) {
+                digitsValue = digitsValue * 10u + static_cast<std::uint64_t>(*p - '0');
+            }
+            else {
+                ++digitsExponent;
+                allRead = allRead && *p == '0';
+            }
+        }
+        bool integerDigits = p != start;
+
+        bool fraction = p != last && *p == '.';
+        if (fraction) {
+            const char* fractionStart = ++p;
+
+            // zeros right after the point are only significant after another digit
+            if (digitsValue == 0u) {
+                for (; p != last && *p == '0'; ++p) {
+                    --digitsExponent;
+                }
+            }
+
+            std::ptrdiff_t used = digitsValue == 0u ? 0 : (fractionStart - 1) - significant;
+            const char* fractionSignificant = p;
+
+            for (; p != last && digit(*p); ++p) {
+                if (used + (p - fractionSignificant) < max_digits) {
+                    digitsValue = digitsValue * 10u + static_cast<std::uint64_t>(*p - '0');
+                    --digitsExponent;
+                }
+                else {
+                    allRead = allRead && *p == '0';
+                }
+            }
+
+            // "." and "-." are not numbers
+            if (!integerDigits && p == fractionStart) {
+                return;
+            }
+        }
+        else if (!integerDigits) {
+            return;
+        }
+
+        bool scientific = p != last && (*p == 'e' || *p == 'E');
+        if (scientific) {
+            ++p;
+
+            bool negativeExponent = false;
+            if (p != last && (*p == '-' || *p == '+')) {
+                negativeExponent = *p == '-';
+                ++p;
+            }
+
+            if (p == last || !digit(*p)) {
+                return;
+            }
+
+            // large enough to overflow or underflow any type, small enough not to overflow an int
+            int value = 0;
+            for (; p != last && digit(*p); ++p) {
+                value = value < 100000 ? value * 10 + (*p - '0') : value;
+            }
+            digitsExponent += negativeExponent ? -value : value;
+        }
+
+        if (p != last) {
+            return;
+        }
+
+        kind = fraction || scientific ? floating : integer;
+        mantissa = digitsValue;
+        exponent = digitsExponent;
+        exact = allRead;
+    }
+
+    /// the value of an integer token, false if it doesn't fit a std::uint64_t
+    bool magnitude(const char* first, const char* last, std::uint64_t& value) const {
+        if (exact && exponent == 0) {
+            value = mantissa;
+            return true;
+        }
+
+        // more than 19 digits, read them all again
+        value = 0u;
+        for (; first != last; ++first) {
+            if (digit(*first)) {
+                std::uint64_t d = static_cast<std::uint64_t>(*first - '0');
+                if (value > (std::numeric_limits<std::uint64_t>::max() - d) / 10u) {
+                    return false;
+                }
+                value = value * 10u + d;
+            }
+        }
+        return true;
+    }
+};
+
+//=== floating point ===//
+
+template <typename T>
+struct weak_parse_float_traits {
+    // no fast path
+    static constexpr int max_exponent = -1;
+
+    static constexpr std::uint64_t max_mantissa = 0u;
+
+    static T slow(const char* text) {
+        return std::strtold(text, nullptr);
+    }
+};
+
+template <>
+struct weak_parse_float_traits<float> {
+    // powers of ten up to this, and integers up to max_mantissa, are exact in a float
+    static constexpr int max_exponent = 10;
+
+    static constexpr std::uint64_t max_mantissa = std::uint64_t(1) << 24;
+
+    static float slow(const char* text) {
+        return std::strtof(text, nullptr);
+    }
+};
+
+template <>
+struct weak_parse_float_traits<double> {
+    static constexpr int max_exponent = 22;
+
+    static constexpr std::uint64_t max_mantissa = std::uint64_t(1) << 53;
+
+    static double slow(const char* text) {
+        return std::strtod(text, nullptr);
+    }
+};
+
+/// the floating point value of a number token, rounded like strtod
+template <typename T>
+T weak_parse_float(const weak_number_scan& scan, const char* first, const char* last) {
+    typedef weak_parse_float_traits<T> traits;
+
+    static const T powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+    // when the mantissa and the power of ten are both exact, one multiplication or division rounds correctly
+    if (!scan.special && scan.exact && scan.mantissa <= traits::max_mantissa &&
+        scan.exponent >= -traits::max_exponent && scan.exponent <= traits::max_exponent) {
+
+        T value = static_cast<T>(scan.mantissa);
+        value = scan.exponent < 0 ? value / powers[-scan.exponent] : value * powers[scan.exponent];
+
+        return scan.negative ? -value : value;
+    }
+
+    // strtod needs the token to end with a zero
+    char buffer[64];
+    std::size_t size = static_cast<std::size_t>(last - first);
+
+    if (size < sizeof(buffer)) {
+        std::memcpy(buffer, first, size);
+        buffer[size] = '\0';
+        return traits::slow(buffer);
+    }
+
+    return traits::slow(std::string(first, last).c_str());
+}
+
+//=== weak_parser ===//
+
+// types a token of each kind is stored as
+template <typename T>
+struct weak_parse_is_integer : std::integral_constant<bool, std::is_integral<T>::value &&
+        !std::is_same<T, bool>::value && !std::is_same<T, char>::value && !std::is_same<T, wchar_t>::value &&
+        !std::is_same<T, char16_t>::value && !std::is_same<T, char32_t>::value> {};
+
+template <typename T>
+struct weak_parse_is_text : std::integral_constant<bool, !std::is_arithmetic<T>::value &&
+        std::is_constructible<T, const char*, std::size_t>::value> {};
+
+// the first of Types... that Is, void if there is none
+template <template<typename> class Is, typename ... Types>
+struct weak_parse_first {
+    typedef void type;
+};
+
+template <template<typename> class Is, typename T, typename ... Types>
+struct weak_parse_first<Is, T, Types...> {
+    typedef typename std::conditional<Is<T>::value, T, typename weak_parse_first<Is, Types...>::type>::type type;
+};
+
+template <typename Weak>
+struct weak_parser;
+
+template <template<typename ... Ts> class Weak, typename ... Types>
+struct weak_parser<Weak<Types...>> {
+
+    typedef Weak<Types...> weak_type;
+
+    typedef typename weak_parse_first<std::is_floating_point, Types...>::type floating_type;
+
+    typedef typename weak_parse_first<weak_parse_is_text, Types...>::type text_type;
+
+    // an integer goes into the first integer type that holds it
+
+    template <typename T>
+    static bool storeInteger(weak_type& into, bool negative, std::uint64_t magnitude, std::true_type) {
+        typedef typename std::make_unsigned<T>::type unsigned_type;
+        std::uint64_t max = static_cast<unsigned_type>(std::numeric_limits<T>::max());
+
+        if (!negative) {
+            if (magnitude > max) {
+                return false;
+            }
+            into = static_cast<T>(magnitude);
+        }
+        else {
+            // the lowest signed value is one further from 0 than the highest
+            if (magnitude > (std::is_signed<T>::value ? max + 1u : 0u)) {
+                return false;
+            }
+            into = magnitude == 0u ? T(0) : static_cast<T>(-static_cast<T>(magnitude - 1u) - 1);
+        }
+
+        return true;
+    }
+
+    template <typename T>
+    static bool storeInteger(weak_type&, bool, std::uint64_t, std::false_type) {
+        return false;
+    }
+
+    template <typename ... Ts>
+    static typename std::enable_if<sizeof...(Ts) == 0, bool>::type
+    storeInteger(weak_type&, bool, std::uint64_t) {
+        return false;
+    }
+
+    template <typename T, typename ... Ts>
+    static bool storeInteger(weak_type& into, bool negative, std::uint64_t magnitude) {
+        return storeInteger<T>(into, negative, magnitude, weak_parse_is_integer<T>()) ||
+               storeInteger<Ts...>(into, negative, magnitude);
+    }
+
+    static bool storeFloating(weak_type&, const weak_number_scan&, const char*, const char*, void*) {
+        return false;
+    }
+
+    template <typename T>
+    static bool storeFloating(weak_type& into, const weak_number_scan& scan, const char* first, const char* last, T*) {
+        into = weak_parse_float<T>(scan, first, last);
+        return true;
+    }
+
+    static bool storeText(weak_type& into, const char*, const char*, void*) {
+        into = weak_type();
+        return false;
+    }
+
+    template <typename T>
+    static bool storeText(weak_type& into, const char* first, const char* last, T*) {
+        into.emplace(T(first, static_cast<std::size_t>(last - first)));
+        return true;
+    }
+
+    static bool parse(const char* first, const char* last, weak_type& into) {
+        if (first == last) {
+            into = weak_type();
+            return false;
+        }
+
+        weak_number_scan scan(first, last);
+
+        if (scan.kind == weak_number_scan::integer) {
+            std::uint64_t magnitude = 0u;
+            if (scan.magnitude(first, last, magnitude) && storeInteger<Types...>(into, scan.negative, magnitude)) {
+                return true;
+            }
+        }
+
+        if (scan.kind != weak_number_scan::text &&
+            storeFloating(into, scan, first, last, static_cast<floating_type*>(nullptr))) {
+            return true;
+        }
+
+        return storeText(into, first, last, static_cast<text_type*>(nullptr));
+    }
+};
+
+//=== parsing ===//
+
+/// Parses the token [first, last) into into, as the first integer type among the weak's types that holds it, or else
+/// the first floating point type, or else the first type constructible from (const char*, std::size_t) such as
+/// std::string. bool and character types are not numbers. Returns false and leaves into invalid when the token is
+/// empty or no type can hold it.
+template <typename Weak>
+bool weak_parse(const char* first, const char* last, Weak& into) {
+    return weak_parser<Weak>::parse(first, last, into);
+}
+
+/// Parses every field of [first, last) into a Weak written to out, for example a std::back_inserter of a
+/// std::vector<Weak> or of a weak_vector. Fields are separated by separator or by line ends, \n or \r\n, and a final
+/// line end doesn't start another field. Fields are not unquoted. Returns out past the last field.
+template <typename Weak, typename OutputIterator>
+OutputIterator weak_parse_fields(const char* first, const char* last, char separator, OutputIterator out) {
+    Weak field;
+
+    while (first != last) {
+        const char* end = first;
+        while (end != last && *end != separator && *end != '\n') {
+            ++end;
+        }
+
+        const char* fieldEnd = end != first && end[-1] == '\r' && (end == last || *end == '\n') ? end - 1 : end;
+        weak_parser<Weak>::parse(first, fieldEnd, field);
+        *out++ = std::move(field);
+
+        if (end == last) {
+            break;
+        }
+
+        first = end + 1;
+
+        // a separator right before the end still ends an empty field
+        if (first == last && *end == separator) {
+            weak_parser<Weak>::parse(first, first, field);
+            *out++ = std::move(field);
+        }
+    }
+
+    return out;
+}
+
+#endif //WEAK_TYPES_WEAK_PARSE_H
@@ -0,0 +1,208 @@
+//
+// Opt-in counters of what weak values do at run time, enabled by defining WEAK_STATS before including weak.h.
+//
+
+#ifndef WEAK_TYPES_WEAK_STATS_H
+#define WEAK_TYPES_WEAK_STATS_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "weak.h"
+
+//=== counts ===//
+
+// Totals for one weak<Types...>. Types are indexed like weak::index(), so index 0 is the invalid type and Types... follow
+// from 1, operations by weak_operation_id.
+template <std::size_t Types>
+struct weak_stats_counts {
+    /// values stored by type, copies and moves included
+    std::uint64_t emplaces[Types];
+
+    /// [from][to] type of the weak before and after each emplace, from is 0 for a weak that was invalid
+    std::uint64_t transitions[Types][Types];
+
+    /// [operation][left][right] types of the operands of every binary operation, compound assignments included
+    std::uint64_t operations[weak_operation_count][Types][Types];
+
+    /// operations that made an invalid result because they aren't defined for their operands, by operation
+    std::uint64_t unsupported[weak_operation_count];
+
+    /// emplaces of alternatives stored out of line, and the bytes they allocated for the value itself
+    std::uint64_t allocations;
+    std::uint64_t allocated_bytes;
+};
+
+//=== weak_stats ===//
+
+// Every thread counts into its own block, which only that thread writes, so counting is a plain increment without a
+// lock or a read-modify-write instruction. collect() adds up the blocks of the running threads and what threads that
+// exited left behind. Counters only grow, subtract two collections to count what happened between them.
+template <typename ... Types>
+class weak_stats {
+
+    static constexpr std::size_t types = sizeof...(Types) + 1;
+
+    typedef weak_stats_counts<types> counts_type;
+
+    typedef std::atomic<std::uint64_t> counter;
+
+    // mirrors counts_type, atomic so that collect() can read it while its thread writes
+    struct block {
+        counter emplaces[types];
+        counter transitions[types][types];
+        counter operations[weak_operation_count][types][types];
+        counter unsupported[weak_operation_count];
+        counter allocations;
+        counter allocated_bytes;
+    };
+
+    struct registry {
+        std::mutex lock;
+        std::vector<block*> running;
+        counts_type exited;
+    };
+
+    static registry& shared() {
+        static registry* instance = new registry();  // never destroyed, threads may exit after static destruction
+        return *instance;
+    }
+
+    // the calling thread's block, registered on first use and folded into exited when the thread ends
+    class local {
+        std::unique_ptr<block> counts;
+
+    public:
+        local() : counts(new block()) {
+            registry& all = shared();
+            std::lock_guard<std::mutex> guard(all.lock);
+            all.running.push_back(counts.get());
+        }
+
+        ~local() {
+            registry& all = shared();
+            std::lock_guard<std::mutex> guard(all.lock);
+
+            add(all.exited, *counts);
+
+            for (std::size_t i = 0; i < all.running.size(); ++i) {
+                if (all.running[i] == counts.get()) {
+                    all.running[i] = all.running.back();
+                    all.running.pop_back();
+                    break;
+                }
+            }
+        }
+
+        block& get() noexcept {
+            return *counts;
+        }
+    };
+
+    static block& mine() {
+        static thread_local local counts;
+        return counts.get();
+    }
+
+    // only the owning thread writes a counter, so a load and a store can't lose a count
+    static void increment(counter& count, std::uint64_t by = 1) noexcept {
+        count.store(count.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+    }
+
+    static std::uint64_t read(const counter& count) noexcept {
+        return count.load(std::memory_order_relaxed);
+    }
+
+    static void add(counts_type& total, const block& counts) noexcept {
+        for (std::size_t left = 0; left < types; ++left) {
+            total.emplaces[left] += read(counts.emplaces[left]);
+
+            for (std::size_t right = 0; right < types; ++right) {
+                total.transitions[left][right] += read(counts.transitions[left][right]);
+
+                for (std::size_t op = 0; op < weak_operation_count; ++op) {
+                    total.operations[op][left][right] += read(counts.operations[op][left][right]);
+                }
+            }
+        }
+
+        for (std::size_t op = 0; op < weak_operation_count; ++op) {
+            total.unsupported[op] += read(counts.unsupported[op]);
+        }
+
+        total.allocations += read(counts.allocations);
+        total.allocated_bytes += read(counts.allocated_bytes);
+    }
+
+    struct row {
+        bool cells[types];
+    };
+
+    template <typename T>
+    static constexpr bool undefinedFor() {
+        return false;
+    }
+
+    template <typename Op, typename L>
+    static constexpr row definedRow() {
+        return row{{ false, Op::template defined<L, Types>::value... }};
+    }
+
+    /// whether Op makes a value for a left and right type, false for the invalid type
+    template <typename Op>
+    static bool defined(std::size_t left, std::size_t right) {
+        static const row rows[] = {
+                row{{ false, undefinedFor<Types>()... }},
+                definedRow<Op, Types>()...
+        };
+
+        return rows[left].cells[right];
+    }
+
+public:
+    typedef counts_type counts;
+
+    /// counts of all threads so far
+    static counts_type collect() {
+        registry& all = shared();
+        std::lock_guard<std::mutex> guard(all.lock);
+
+        counts_type total = all.exited;
+        for (std::size_t i = 0; i < all.running.size(); ++i) {
+            add(total, *all.running[i]);
+        }
+
+        return total;
+    }
+
+    //=== hooks called by weak ===//
+
+    /// a weak holding the type at from stores the type at to, allocating bytes for it
+    static void emplaced(std::size_t from, std::size_t to, std::size_t bytes) {
+        block& counts = mine();
+
+        increment(counts.emplaces[to]);
+        increment(counts.transitions[from][to]);
+
+        if (bytes != 0) {
+            increment(counts.allocations);
+            increment(counts.allocated_bytes, bytes);
+        }
+    }
+
+    /// Op runs on a left and right operand of the types at left and right
+    template <typename Op>
+    static void operated(std::size_t left, std::size_t right) {
+        block& counts = mine();
+
+        increment(counts.operations[weak_operation_id<Op>::value][left][right]);
+
+        if (!defined<Op>(left, right)) {
+            increment(counts.unsupported[weak_operation_id<Op>::value]);
+        }
+    }
+};
+
+#endif //WEAK_TYPES_WEAK_STATS_H
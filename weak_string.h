@@ -0,0 +1,363 @@
+//
+// A string that keeps short contents inside itself, so storing it in a weak doesn't allocate.
+//
+
+#ifndef WEAK_TYPES_WEAK_STRING_H
+#define WEAK_TYPES_WEAK_STRING_H
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include "weak.h"
+#include "weak_hash.h"
+
+// Up to Capacity chars are stored in the object itself, longer strings in a block from weak_allocator, so a
+// basic_weak_string<Capacity> is Capacity + 1 bytes. Its last byte holds how many more chars fit inline, which is 0 and
+// doubles as the terminating zero when it is full, or on_heap when the chars are in a block whose address starts the
+// object. Always stored inline in a weak.
+template <std::size_t Capacity>
+class basic_weak_string {
+
+    static_assert(Capacity >= sizeof(void*) && Capacity < 255,
+                  "Capacity must fit a pointer and leave the last byte to tell the size.");
+
+    // precedes the chars of a string on the heap
+    struct header {
+        std::size_t size;
+        std::size_t capacity;
+    };
+
+    typedef typename std::allocator_traits<typename weak_allocator<basic_weak_string>::type>::template rebind_alloc<header> allocator_type;
+    typedef std::allocator_traits<allocator_type> allocator_traits;
+
+    static constexpr unsigned char on_heap = 0xFF;
+
+    alignas(void*) char bytes[Capacity + 1];
+
+    bool local() const noexcept {
+        return static_cast<unsigned char>(bytes[Capacity]) != on_heap;
+    }
+
+    header* block() const noexcept {
+        header* allocated;
+        std::memcpy(&allocated, bytes, sizeof(header*));
+        return allocated;
+    }
+
+    // blocks are counted in headers, so the chars after the header stay aligned
+    static std::size_t blocksFor(std::size_t capacity) noexcept {
+        return 1 + (capacity + sizeof(header)) / sizeof(header);
+    }
+
+    void setSize(std::size_t size) noexcept {
+        if (local()) {
+            bytes[size] = '\0';
+            bytes[Capacity] = static_cast<char>(Capacity - size);
+        }
+        else {
+            block() -> size = size;
+            data()[size] = '\0';
+        }
+    }
+
+    void release() noexcept {
+        if (!local()) {
+            allocator_type allocator;
+            allocator_traits::deallocate(allocator, block(), blocksFor(block() -> capacity));
+        }
+    }
+
+    void steal(basic_weak_string& other) noexcept {
+        std::memcpy(bytes, other.bytes, sizeof(bytes));
+        other.bytes[Capacity] = static_cast<char>(Capacity);
+        other.bytes[0] = '\0';
+    }
+
+public:
+    typedef char value_type;
+    typedef std::size_t size_type;
+    typedef char* iterator;
+    typedef const char* const_iterator;
+
+    static constexpr std::size_t inline_capacity = Capacity;
+
+    basic_weak_string() noexcept {
+        bytes[0] = '\0';
+        bytes[Capacity] = static_cast<char>(Capacity);
+    }
+
+    basic_weak_string(const char* chars, std::size_t size) : basic_weak_string() {
+        assign(chars, size);
+    }
+
+    basic_weak_string(const char* chars) : basic_weak_string(chars, std::strlen(chars)) {}
+
+    basic_weak_string(const std::string& chars) : basic_weak_string(chars.data(), chars.size()) {}
+
+    basic_weak_string(const basic_weak_string& other) : basic_weak_string(other.data(), other.size()) {}
+
+    /// never allocates, other is left empty
+    basic_weak_string(basic_weak_string&& other) noexcept {
+        steal(other);
+    }
+
+    basic_weak_string& operator=(const basic_weak_string& other) {
+        return assign(other.data(), other.size());
+    }
+
+    basic_weak_string& operator=(basic_weak_string&& other) noexcept {
+        if (this != &other) {
+            release();
+            steal(other);
+        }
+        return *this;
+    }
+
+    basic_weak_string& operator=(const char* chars) {
+        return assign(chars, std::strlen(chars));
+    }
+
+    ~basic_weak_string() {
+        release();
+    }
+
+    std::size_t size() const noexcept {
+        return local() ? Capacity - static_cast<unsigned char>(bytes[Capacity]) : block() -> size;
+    }
+
+    std::size_t length() const noexcept {
+        return size();
+    }
+
+    bool empty() const noexcept {
+        return size() == 0;
+    }
+
+    std::size_t capacity() const noexcept {
+        return local() ? Capacity : block() -> capacity;
+    }
+
+    /// true when the chars are stored in the object
+    bool isInline() const noexcept {
+        return local();
+    }
+
+    char* data() noexcept {
+        return local() ? bytes : reinterpret_cast<char*>(block() + 1);
+    }
+
+    const char* data() const noexcept {
+        return local() ? bytes : reinterpret_cast<const char*>(block() + 1);
+    }
+
+    const char* c_str() const noexcept {
+        return data();
+    }
+
+    std::string str() const {
+        return std::string(data(), size());
+    }
+
+    char& operator[](std::size_t position) noexcept {
+        return data()[position];
+    }
+
+    const char& operator[](std::size_t position) const noexcept {
+        return data()[position];
+    }
+
+    iterator begin() noexcept {
+        return data();
+    }
+
+    iterator end() noexcept {
+        return data() + size();
+    }
+
+    const_iterator begin() const noexcept {
+        return data();
+    }
+
+    const_iterator end() const noexcept {
+        return data() + size();
+    }
+
+    void clear() noexcept {
+        setSize(0);
+    }
+
+    /// makes room for capacity chars, moving them to the heap if they don't fit inline
+    void reserve(std::size_t capacity) {
+        if (capacity <= this -> capacity()) {
+            return;
+        }
+
+        allocator_type allocator;
+        header* allocated = allocator_traits::allocate(allocator, blocksFor(capacity));
+        allocated -> size = size();
+        allocated -> capacity = capacity;
+        std::memcpy(allocated + 1, data(), allocated -> size + 1);
+
+        release();
+        std::memcpy(bytes, &allocated, sizeof(header*));
+        bytes[Capacity] = static_cast<char>(on_heap);
+    }
+
+    basic_weak_string& assign(const char* chars, std::size_t size) {
+        if (size <= capacity()) {
+            // chars may point into this string
+            std::memmove(data(), chars, size);
+            setSize(size);
+            return *this;
+        }
+
+        basic_weak_string assigned;
+        assigned.reserve(size);
+        std::memcpy(assigned.data(), chars, size);
+        assigned.setSize(size);
+
+        return *this = std::move(assigned);
+    }
+
+    basic_weak_string& append(const char* chars, std::size_t size) {
+        std::size_t current = this -> size();
+
+        if (current + size <= capacity()) {
+            std::memmove(data() + current, chars, size);
+            setSize(current + size);
+            return *this;
+        }
+
+        // grow geometrically, chars may point into this string so it is copied before the old chars are freed
+        basic_weak_string appended;
+        appended.reserve(current + size > 2 * capacity() ? current + size : 2 * capacity());
+        std::memcpy(appended.data(), data(), current);
+        std::memcpy(appended.data() + current, chars, size);
+        appended.setSize(current + size);
+
+        return *this = std::move(appended);
+    }
+
+    void push_back(char c) {
+        append(&c, 1);
+    }
+
+    basic_weak_string& operator+=(const basic_weak_string& other) {
+        return append(other.data(), other.size());
+    }
+
+    basic_weak_string& operator+=(const char* chars) {
+        return append(chars, std::strlen(chars));
+    }
+
+    basic_weak_string& operator+=(char c) {
+        return append(&c, 1);
+    }
+
+    /// negative, 0 or positive as this sorts before, with or after other, by unsigned char
+    int compare(const char* chars, std::size_t size) const noexcept {
+        std::size_t current = this -> size();
+        int order = std::memcmp(data(), chars, current < size ? current : size);
+
+        return order != 0 ? order : current < size ? -1 : current > size ? 1 : 0;
+    }
+
+    int compare(const basic_weak_string& other) const noexcept {
+        return compare(other.data(), other.size());
+    }
+};
+
+typedef basic_weak_string<23> weak_string;
+
+//=== operators ===//
+
+template <std::size_t Capacity>
+basic_weak_string<Capacity> operator+(const basic_weak_string<Capacity>& left, const basic_weak_string<Capacity>& right) {
+    basic_weak_string<Capacity> joined;
+    joined.reserve(left.size() + right.size());
+    joined.append(left.data(), left.size());
+    joined.append(right.data(), right.size());
+    return joined;
+}
+
+template <std::size_t Capacity>
+basic_weak_string<Capacity> operator+(basic_weak_string<Capacity>&& left, const basic_weak_string<Capacity>& right) {
+    left.append(right.data(), right.size());
+    return std::move(left);
+}
+
+template <std::size_t Capacity>
+bool operator==(const basic_weak_string<Capacity>& left, const basic_weak_string<Capacity>& right) noexcept {
+    return left.size() == right.size() && std::memcmp(left.data(), right.data(), left.size()) == 0;
+}
+
+template <std::size_t Capacity>
+bool operator!=(const basic_weak_string<Capacity>& left, const basic_weak_string<Capacity>& right) noexcept {
+    return !(left == right);
+}
+
+template <std::size_t Capacity>
+bool operator<(const basic_weak_string<Capacity>& left, const basic_weak_string<Capacity>& right) noexcept {
+    return left.compare(right) < 0;
+}
+
+template <std::size_t Capacity>
+bool operator>(const basic_weak_string<Capacity>& left, const basic_weak_string<Capacity>& right) noexcept {
+    return left.compare(right) > 0;
+}
+
+template <std::size_t Capacity>
+bool operator<=(const basic_weak_string<Capacity>& left, const basic_weak_string<Capacity>& right) noexcept {
+    return left.compare(right) <= 0;
+}
+
+template <std::size_t Capacity>
+bool operator>=(const basic_weak_string<Capacity>& left, const basic_weak_string<Capacity>& right) noexcept {
+    return left.compare(right) >= 0;
+}
+
+// a null pointer compares like an empty string, as it hashes in weak_hash.h
+template <std::size_t Capacity>
+bool operator==(const basic_weak_string<Capacity>& left, const char* right) noexcept {
+    return right == nullptr ? left.empty() : left.compare(right, std::strlen(right)) == 0;
+}
+
+template <std::size_t Capacity>
+bool operator!=(const basic_weak_string<Capacity>& left, const char* right) noexcept {
+    return !(left == right);
+}
+
+template <std::size_t Capacity>
+bool operator==(const char* left, const basic_weak_string<Capacity>& right) noexcept {
+    return right == left;
+}
+
+template <std::size_t Capacity>
+bool operator!=(const char* left, const basic_weak_string<Capacity>& right) noexcept {
+    return !(right == left);
+}
+
+//=== weak integration ===//
+
+// the chars are inline already, a pointer to the heap would only add an allocation
+template <std::size_t Capacity>
+struct weak_is_inline<basic_weak_string<Capacity>> : std::true_type {};
+
+template <std::size_t Capacity>
+struct weak_value_hash<basic_weak_string<Capacity>> {
+    void operator() (const basic_weak_string<Capacity>& val, std::size_t& hashed) const {
+        hashed = weak_hash_bytes(val.data(), val.size());
+    }
+};
+
+namespace std {
+    template <std::size_t Capacity>
+    struct hash<basic_weak_string<Capacity>> {
+        std::size_t operator() (const basic_weak_string<Capacity>& val) const {
+            return weak_hash_bytes(val.data(), val.size());
+        }
+    };
+}
+
+#endif //WEAK_TYPES_WEAK_STRING_H
@@ -0,0 +1,581 @@
+//
+// A sequence of weak<Types...> values stored column by column.
+//
+
+#ifndef WEAK_TYPES_WEAK_VECTOR_H
+#define WEAK_TYPES_WEAK_VECTOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <tuple>
+#include <vector>
+#include "weak.h"
+
+// Behaves like a std::vector<weak<Types...>>, but keeps a compact array of type tags and stores the values of each type
+// contiguously in their own column, so scanning the values of one type touches only that type's memory.
+// Elements are accessed through reference proxies that support the same operators and run as weak, by index or by
+// iterating from begin() to end().
+template <typename ... Types>
+class weak_vector {
+
+    typedef typename smallest_unsigned<sizeof...(Types)>::type tag_type;
+
+    template <typename ... Ts>
+    friend class weak_batch;
+
+    template <typename T>
+    struct typed_column {
+        std::vector<T> values;
+
+        // position in the weak_vector of each value
+        std::vector<std::size_t> owners;
+    };
+
+    // per element, the index of its type (0 when invalid) and where it is in that type's column
+    std::vector<tag_type> tags;
+
+    std::vector<std::size_t> slots;
+
+    std::tuple<typed_column<Types>...> columns;
+
+    template <typename T>
+    typed_column<T>& columnOf() {
+        return std::get<get_type_index_impl<T, Types...>::value - 1>(columns);
+    }
+
+    template <typename T>
+    const typed_column<T>& columnOf() const {
+        return std::get<get_type_index_impl<T, Types...>::value - 1>(columns);
+    }
+
+    //// per type operations, called through tables indexed by tag
+
+    template <typename T>
+    static const void* addressOf(const weak_vector& vector, std::size_t position) {
+        return &vector.columnOf<T>().values[vector.slots[position]];
+    }
+
+    static const void* noAddress(const weak_vector&, std::size_t) {
+        return nullptr;
+    }
+
+    const void* address(std::size_t position) const {
+        static const void* (* const table[])(const weak_vector&, std::size_t) = {
+                &noAddress, &addressOf<Types>...
+        };
+
+        return table[tags[position]](*this, position);
+    }
+
+    /// removes the value of position from its column by moving the column's last value into its slot
+    template <typename T>
+    static void eraseFrom(weak_vector& vector, std::size_t position) {
+        typed_column<T>& values = vector.columnOf<T>();
+        std::size_t slot = vector.slots[position];
+        std::size_t last = values.values.size() - 1;
+
+        if (slot != last) {
+            values.values[slot] = std::move(values.values[last]);
+            values.owners[slot] = values.owners[last];
+            vector.slots[values.owners[slot]] = slot;
+        }
+
+        values.values.pop_back();
+        values.owners.pop_back();
+    }
+
+    static void noErase(weak_vector&, std::size_t) {}
+
+    void erase(std::size_t position) {
+        static void (* const table[])(weak_vector&, std::size_t) = {
+                &noErase, &eraseFrom<Types>...
+        };
+
+        table[tags[position]](*this, position);
+        tags[position] = 0;
+    }
+
+    template <typename T>
+    void store(std::size_t position, T val) {
+        typed_column<T>& values = columnOf<T>();
+
+        tags[position] = get_type_index_impl<T, Types...>::value;
+        slots[position] = values.values.size();
+
+        values.values.push_back(std::move(val));
+        values.owners.push_back(position);
+    }
+
+    template <typename T>
+    void assign(std::size_t position, T val) {
+        using t = typename std::decay<T>::type;
+        static_assert(get_type_index_impl<t, Types...>::value != 0u, "Cannot store with non-weak type.");
+
+        if (tags[position] == get_type_index_impl<t, Types...>::value) {
+            // same type, overwrite in place
+            columnOf<t>().values[slots[position]] = std::move(val);
+            return;
+        }
+
+        erase(position);
+        store<t>(position, std::move(val));
+    }
+
+    template <typename T>
+    struct assignTo {
+        void operator() (const T& val, weak_vector* vector, std::size_t position) {
+            vector -> assign<T>(position, val);
+        }
+    };
+
+    void assign(std::size_t position, const weak<Types...>& val) {
+        if (!val.isValid()) {
+            erase(position);
+            return;
+        }
+
+        val.template run<assignTo>(this, position);
+    }
+
+    // What weak_compound_table stores a result into when it doesn't update the element in place. Its kernels assign a
+    // default constructed one for an invalid result.
+    struct compound_target {
+        weak_vector* vector;
+
+        std::size_t position;
+
+        compound_target() : vector(nullptr), position(0) {}
+
+        compound_target(weak_vector* vector, std::size_t position) : vector(vector), position(position) {}
+
+        compound_target& operator=(const compound_target&) {
+            vector -> erase(position);
+            return *this;
+        }
+
+        template <typename T, typename = typename std::enable_if<get_type_index_impl<T, Types...>::value != 0u>::type>
+        compound_target& operator=(T val) {
+            vector -> assign(position, std::move(val));
+            return *this;
+        }
+    };
+
+public:
+
+    typedef weak<Types...> value_type;
+
+    class const_reference {
+
+    protected:
+        const weak_vector* owner;
+
+        std::size_t position;
+
+        std::size_t index() const noexcept {
+            return owner -> tags[position];
+        }
+
+        const void* address() const {
+            return owner -> address(position);
+        }
+
+        // the other operand of an operator, a reference into any weak_vector of the same types or a weak
+        template <typename Other>
+        using operand = typename std::enable_if<std::is_base_of<const_reference, Other>::value ||
+                                                std::is_same<Other, weak<Types...>>::value>::type;
+
+        static std::size_t operandIndex(const const_reference& other) noexcept {
+            return other.index();
+        }
+
+        static std::size_t operandIndex(const weak<Types...>& other) noexcept {
+            return other.index();
+        }
+
+        static const void* operandAddress(const const_reference& other) {
+            return other.address();
+        }
+
+        static const void* operandAddress(const weak<Types...>& other) {
+            return other.address();
+        }
+
+        /// runs Op on this and other, see weak::binary
+        template <typename Op, typename Result, typename Other>
+        void binary(const Other& other, Result* result) const {
+            weak_binary_apply<Op, Result, Types...>(index(), operandIndex(other), address(), operandAddress(other), result);
+        }
+
+        template <template<typename Type, typename ... Ts> class Functor, typename ... Ts>
+        struct using_column {
+
+            template <typename T, typename ... Args>
+            static void call(const weak_vector& vector, std::size_t position, Args&&... args) {
+                Functor<T, Ts...>()(vector.columnOf<T>().values[vector.slots[position]], std::forward<Args>(args)...);
+            };
+
+            template <typename T, typename ... Args>
+            static void mutableCall(weak_vector& vector, std::size_t position, Args&&... args) {
+                Functor<T, Ts...>()(vector.columnOf<T>().values[vector.slots[position]], std::forward<Args>(args)...);
+            };
+
+            template <typename ... Args>
+            static void none(const weak_vector&, std::size_t, Args&&...) {};
+
+            template <typename ... Args>
+            static void mutableNone(weak_vector&, std::size_t, Args&&...) {};
+
+            template <typename ... Args>
+            static void with(const weak_vector& vector, std::size_t position, Args&&... args) {
+                static void (* const table[])(const weak_vector&, std::size_t, Args&&...) = {
+                        &none<Args...>, &call<Types, Args...>...
+                };
+
+                table[vector.tags[position]](vector, position, std::forward<Args>(args)...);
+            };
+
+            template <typename ... Args>
+            static void with(weak_vector& vector, std::size_t position, Args&&... args) {
+                static void (* const table[])(weak_vector&, std::size_t, Args&&...) = {
+                        &mutableNone<Args...>, &mutableCall<Types, Args...>...
+                };
+
+                table[vector.tags[position]](vector, position, std::forward<Args>(args)...);
+            };
+        };
+
+    public:
+        const_reference(const weak_vector* owner, std::size_t position) : owner(owner), position(position) {}
+
+        /// copies the element out
+        operator weak<Types...>() const {
+            weak<Types...> copied;
+            run<copyTo>(&copied);
+            return copied;
+        }
+
+        bool isValid() const {
+            return index() != 0u;
+        }
+
+        template <typename Type>
+        bool isType() const {
+            return get_type_index_impl<Type, Types...>::value != 0u &&
+                   index() == get_type_index_impl<Type, Types...>::value;
+        }
+
+        template <typename T>
+        const T& value() const {
+            return owner -> template columnOf<T>().values[owner -> slots[position]];
+        }
+
+        template <typename T>
+        const T* get_if() const noexcept {
+            return isType<T>() ? &value<T>() : nullptr;
+        }
+
+        template <template<typename Type, typename ... Ts> class Functor, typename ... Ts, typename ... Args>
+        void run(Args&&... args) const {
+            using_column<Functor, Ts...>::with(*owner, position, std::forward<Args>(args)...);
+        };
+
+        ///// Arithmetic Operators /////
+
+        template <typename Other, typename = operand<Other>>
+        weak<Types...> operator+ (const Other& other) const {
+            weak<Types...> added;
+            binary<weak_addition>(other, &added);
+            return added;
+        }
+
+        template <typename Other, typename = operand<Other>>
+        weak<Types...> operator- (const Other& other) const {
+            weak<Types...> subtracted;
+            binary<weak_subtraction>(other, &subtracted);
+            return subtracted;
+        }
+
+        template <typename Other, typename = operand<Other>>
+        weak<Types...> operator* (const Other& other) const {
+            weak<Types...> multiplied;
+            binary<weak_multiplication>(other, &multiplied);
+            return multiplied;
+        }
+
+        template <typename Other, typename = operand<Other>>
+        weak<Types...> operator/ (const Other& other) const {
+            weak<Types...> divided;
+            binary<weak_division>(other, &divided);
+            return divided;
+        }
+
+        // comparison operators
+        template <typename Other, typename = operand<Other>>
+        bool operator== (const Other& other) const {
+            bool result = false;
+            binary<weak_equal>(other, &result);
+            return result;
+        }
+
+        template <typename Other, typename = operand<Other>>
+        bool operator!= (const Other& other) const {
+            bool result = false;
+            binary<weak_not_equal>(other, &result);
+            return result;
+        }
+
+        template <typename Other, typename = operand<Other>>
+        bool operator< (const Other& other) const {
+            bool result = false;
+            binary<weak_less_than>(other, &result);
+            return result;
+        }
+
+        template <typename Other, typename = operand<Other>>
+        bool operator> (const Other& other) const {
+            bool result = false;
+            binary<weak_greater_than>(other, &result);
+            return result;
+        }
+
+        template <typename Other, typename = operand<Other>>
+        bool operator<= (const Other& other) const {
+            bool result = false;
+            binary<weak_less_than_equal_to>(other, &result);
+            return result;
+        }
+
+        template <typename Other, typename = operand<Other>>
+        bool operator>= (const Other& other) const {
+            bool result = false;
+            binary<weak_greater_than_equal_to>(other, &result);
+            return result;
+        }
+
+    private:
+        template <typename T>
+        struct copyTo {
+            void operator() (const T& val, weak<Types...>* copied) const {
+                copied -> emplace(val);
+            }
+        };
+    };
+
+    class reference : public const_reference {
+
+        template <typename Other>
+        using operand = typename const_reference::template operand<Other>;
+
+        weak_vector* mutableOwner() const {
+            return const_cast<weak_vector*>(this -> owner);
+        }
+
+        /// element = element Op other, in place when the result has the element's type, like weak's compound assignments
+        template <typename Op, typename Other>
+        void compound(const Other& other) const {
+#ifdef WEAK_SMALL_CODE
+            weak<Types...> result;
+            this -> template binary<Op>(other, &result);
+            mutableOwner() -> assign(this -> position, result);
+#else
+            compound_target target(mutableOwner(), this -> position);
+            weak_compound_table<Op, compound_target, Types...>::lookup(this -> index(),
+                                                                      const_reference::operandIndex(other))(
+                    const_cast<void*>(this -> address()), const_reference::operandAddress(other), &target);
+#endif
+        }
+
+    public:
+        reference(weak_vector* owner, std::size_t position) : const_reference(owner, position) {}
+
+        /// assigning through a reference changes the element, not what the reference refers to
+        reference& operator=(const reference& other) {
+            mutableOwner() -> assign(this -> position, weak<Types...>(other));
+            return *this;
+        }
+
+        reference& operator=(const const_reference& other) {
+            mutableOwner() -> assign(this -> position, weak<Types...>(other));
+            return *this;
+        }
+
+        reference& operator=(const weak<Types...>& val) {
+            mutableOwner() -> assign(this -> position, val);
+            return *this;
+        }
+
+        template <typename T, typename = typename std::enable_if<get_type_index_impl<typename std::decay<T>::type, Types...>::value != 0u>::type>
+        reference& operator=(T val) {
+            mutableOwner() -> assign(this -> position, std::move(val));
+            return *this;
+        }
+
+        template <typename T>
+        void emplace(T val) {
+            mutableOwner() -> assign(this -> position, std::move(val));
+        }
+
+        template <typename T>
+        T& value() const {
+            return mutableOwner() -> template columnOf<T>().values[this -> owner -> slots[this -> position]];
+        }
+
+        template <typename T>
+        T* get_if() const noexcept {
+            return this -> template isType<T>() ? &value<T>() : nullptr;
+        }
+
+        template <template<typename Type, typename ... Ts> class Functor, typename ... Ts, typename ... Args>
+        void run(Args&&... args) const {
+            const_reference::template using_column<Functor, Ts...>::with(*mutableOwner(), this -> position, std::forward<Args>(args)...);
+        };
+
+        template <typename Other, typename = operand<Other>>
+        reference& operator+=(const Other& other) {
+            compound<weak_addition>(other);
+            return *this;
+        }
+
+        template <typename Other, typename = operand<Other>>
+        reference& operator-=(const Other& other) {
+            compound<weak_subtraction>(other);
+            return *this;
+        }
+
+        template <typename Other, typename = operand<Other>>
+        reference& operator*=(const Other& other) {
+            compound<weak_multiplication>(other);
+            return *this;
+        }
+
+        template <typename Other, typename = operand<Other>>
+        reference& operator/=(const Other& other) {
+            compound<weak_division>(other);
+            return *this;
+        }
+    };
+
+    /// iterates over the elements by position, yielding reference proxies like operator[]
+    template <typename Reference, typename Owner>
+    class basic_iterator {
+
+        Owner* owner;
+
+        std::size_t position;
+
+    public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef weak<Types...> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef Reference reference;
+        typedef void pointer;
+
+        basic_iterator(Owner* owner, std::size_t position) : owner(owner), position(position) {}
+
+        Reference operator*() const {
+            return Reference(owner, position);
+        }
+
+        basic_iterator& operator++() {
+            ++position;
+            return *this;
+        }
+
+        basic_iterator operator++(int) {
+            basic_iterator before = *this;
+            ++position;
+            return before;
+        }
+
+        bool operator==(const basic_iterator& other) const {
+            return position == other.position;
+        }
+
+        bool operator!=(const basic_iterator& other) const {
+            return position != other.position;
+        }
+    };
+
+    typedef basic_iterator<reference, weak_vector> iterator;
+    typedef basic_iterator<const_reference, const weak_vector> const_iterator;
+
+    std::size_t size() const noexcept {
+        return tags.size();
+    }
+
+    bool empty() const noexcept {
+        return tags.empty();
+    }
+
+    void reserve(std::size_t count) {
+        tags.reserve(count);
+        slots.reserve(count);
+    }
+
+    void clear() noexcept {
+        tags.clear();
+        slots.clear();
+        columns = std::tuple<typed_column<Types>...>();
+    }
+
+    iterator begin() {
+        return iterator(this, 0);
+    }
+
+    iterator end() {
+        return iterator(this, size());
+    }
+
+    const_iterator begin() const {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const {
+        return const_iterator(this, size());
+    }
+
+    reference operator[](std::size_t position) {
+        return reference(this, position);
+    }
+
+    const_reference operator[](std::size_t position) const {
+        return const_reference(this, position);
+    }
+
+    reference back() {
+        return reference(this, size() - 1);
+    }
+
+    const_reference back() const {
+        return const_reference(this, size() - 1);
+    }
+
+    void push_back(const weak<Types...>& val) {
+        tags.push_back(0);
+        slots.push_back(0);
+        assign(size() - 1, val);
+    }
+
+    /// appends a T, T must be one of Types...
+    template <typename T>
+    void emplace_back(T val) {
+        tags.push_back(0);
+        slots.push_back(0);
+        assign(size() - 1, std::move(val));
+    }
+
+    void pop_back() {
+        erase(size() - 1);
+        tags.pop_back();
+        slots.pop_back();
+    }
+
+    /// every value of type T in the vector, in no particular order
+    template <typename T>
+    const std::vector<T>& column() const {
+        return columnOf<T>().values;
+    }
+};
+
+#endif //WEAK_TYPES_WEAK_VECTOR_H
@@ -0,0 +1,572 @@
+//
+// A compact binary format for weak values, encoded into and decoded from caller provided buffers.
+//
+
+#ifndef WEAK_TYPES_WEAK_WIRE_H
+#define WEAK_TYPES_WEAK_WIRE_H
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include "weak.h"
+
+// A weak is written as its type index as a varint, 0 for an invalid weak, followed by its value:
+//     bool and 1 byte integers        the byte
+//     larger unsigned integers        varint, 7 bits per byte, least significant first
+//     larger signed integers          zigzag varint, so small negative numbers stay short
+//     enums                           as their underlying type
+//     float and double                4 or 8 bytes, little endian
+//     std::string                     varint length followed by the bytes
+// Specialize weak_wire_format to write other types.
+
+enum class weak_wire_status {
+    ok,
+    // the buffer ends in the middle of a value, decode again once more of it has arrived
+    incomplete,
+    // the bytes are not a value of the weak's types
+    malformed
+};
+
+// a string decoded in place, pointing into the buffer being decoded
+struct weak_wire_string {
+    const char* data;
+    std::size_t size;
+
+    std::string str() const {
+        return std::string(data, size);
+    }
+};
+
+template <typename T, typename enable = void>
+struct weak_wire_format {
+    static_assert(sizeof(T) == 0, "Specialize weak_wire_format to encode this type.");
+};
+
+//=== weak_wire_encoder ===//
+
+// Writes into a buffer it doesn't own. A value is written whole or not at all: when it doesn't fit, write returns false
+// and leaves the buffer as it was, so the caller can send what was written, reset to a new buffer and write it again.
+class weak_wire_encoder {
+
+    unsigned char* start;
+    unsigned char* position;
+    unsigned char* end;
+
+    template <typename T, typename ... Types>
+    struct encode {
+        void operator() (const T& val, weak_wire_encoder& out, bool& written) const {
+            written = out.writeVarint(get_type_index_impl<T, Types...>::value) && weak_wire_format<T>::encode(out, val);
+        }
+    };
+
+public:
+    // the longest varint, a std::uint64_t in 7 bit groups
+    static constexpr std::size_t max_varint = 10;
+
+    weak_wire_encoder(void* buffer, std::size_t capacity) {
+        reset(buffer, capacity);
+    }
+
+    /// continues writing at the start of buffer
+    void reset(void* buffer, std::size_t capacity) noexcept {
+        start = static_cast<unsigned char*>(buffer);
+        position = start;
+        end = start + capacity;
+    }
+
+    /// number of bytes written since the last reset
+    std::size_t size() const noexcept {
+        return static_cast<std::size_t>(position - start);
+    }
+
+    std::size_t remaining() const noexcept {
+        return static_cast<std::size_t>(end - position);
+    }
+
+    bool writeVarint(std::uint64_t val) noexcept {
+        // only check the room for each byte near the end of the buffer
+        if (remaining() < max_varint) {
+            std::size_t length = 1;
+            for (std::uint64_t rest = val >> 7; rest != 0u; rest >>= 7) {
+                ++length;
+            }
+            if (remaining() < length) {
+                return false;
+            }
+        }
+
+        while (val >= 0x80u) {
+            *position++ = static_cast<unsigned char>(val | 0x80u);
+            val >>= 7;
+        }
+        *position++ = static_cast<unsigned char>(val);
+
+        return true;
+    }
+
+    /// writes the low Size bytes of val, least significant first
+    template <std::size_t Size>
+    bool writeFixed(std::uint64_t val) noexcept {
+        if (remaining() < Size) {
+            return false;
+        }
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        std::memcpy(position, &val, Size);
+#else
+        for (std::size_t i = 0; i < Size; ++i) {
+            position[i] = static_cast<unsigned char>(val >> (8 * i));
+        }
+#endif
+        position += Size;
+
+        return true;
+    }
+
+    bool writeBytes(const void* bytes, std::size_t size) noexcept {
+        if (remaining() < size) {
+            return false;
+        }
+
+        std::memcpy(position, bytes, size);
+        position += size;
+
+        return true;
+    }
+
+    template <typename Derived, typename ... Types>
+    bool write(const weak_interface<Derived, Types...>& value) {
+        if (!value.isValid()) {
+            return writeVarint(0u);
+        }
+
+        unsigned char* before = position;
+        bool written = false;
+
+        value.template run<encode, Types...>(*this, written);
+
+        if (!written) {
+            position = before;
+        }
+        return written;
+    }
+
+    /// writes the weak values from first on until one doesn't fit, returns the first one not written
+    template <typename Iterator>
+    Iterator write(Iterator first, Iterator last) {
+        while (first != last && write(*first)) {
+            ++first;
+        }
+        return first;
+    }
+};
+
+//=== weak_wire_decoder ===//
+
+// Reads from a buffer it doesn't own. A value that fails to decode leaves the decoder where it was, so after
+// weak_wire_status::incomplete the caller can carry the remaining bytes over to the front of a fuller buffer.
+// Strings are decoded as weak_wire_string views into the buffer, copied only when decoded into a std::string.
+class weak_wire_decoder {
+
+    const unsigned char* position;
+    const unsigned char* end;
+
+    // splits the types out of a weak type
+    template <typename Weak>
+    struct weak_wire_types;
+
+    template <template<typename ... Ts> class Weak, typename ... Types>
+    struct weak_wire_types<Weak<Types...>> {
+
+        static constexpr std::size_t count = sizeof...(Types);
+
+        template <typename T>
+        using format = weak_wire_format<T>;
+
+        static weak_wire_status none(weak_wire_decoder&, Weak<Types...>& into) {
+            into = Weak<Types...>();
+            return weak_wire_status::ok;
+        }
+
+        template <typename T>
+        static weak_wire_status store(weak_wire_decoder& in, Weak<Types...>& into) {
+            typename format<T>::view_type view;
+
+            weak_wire_status status = format<T>::decode(in, view);
+            if (status == weak_wire_status::ok) {
+                into = format<T>::own(view);
+            }
+            return status;
+        }
+
+        template <template<typename Type, typename ... Ts> class Functor, typename ... Args>
+        static weak_wire_status skip(weak_wire_decoder&, Args&&...) {
+            return weak_wire_status::ok;
+        }
+
+        template <template<typename Type, typename ... Ts> class Functor, typename T, typename ... Args>
+        static weak_wire_status call(weak_wire_decoder& in, Args&&... args) {
+            typename format<T>::view_type view;
+
+            weak_wire_status status = format<T>::decode(in, view);
+            if (status == weak_wire_status::ok) {
+                Functor<typename format<T>::view_type>()(view, std::forward<Args>(args)...);
+            }
+            return status;
+        }
+
+        static weak_wire_status read(weak_wire_decoder& in, std::uint64_t tag, Weak<Types...>& into) {
+            // slot 0 is the invalid type
+            static weak_wire_status (* const table[])(weak_wire_decoder&, Weak<Types...>&) = {
+                    &none, &store<Types>...
+            };
+
+            return table[tag](in, into);
+        }
+
+        template <template<typename Type, typename ... Ts> class Functor, typename ... Args>
+        static weak_wire_status visit(weak_wire_decoder& in, std::uint64_t tag, Args&&... args) {
+            static weak_wire_status (* const table[])(weak_wire_decoder&, Args&&...) = {
+                    &skip<Functor, Args...>, &call<Functor, Types, Args...>...
+            };
+
+            return table[tag](in, std::forward<Args>(args)...);
+        }
+    };
+
+    template <typename Weak>
+    weak_wire_status readTag(std::uint64_t& tag) {
+        weak_wire_status status = readVarint(tag);
+        return status != weak_wire_status::ok || tag <= weak_wire_types<Weak>::count ? status : weak_wire_status::malformed;
+    }
+
+public:
+
+    weak_wire_decoder(const void* data, std::size_t size) {
+        reset(data, size);
+    }
+
+    /// continues reading at the start of data
+    void reset(const void* data, std::size_t size) noexcept {
+        position = static_cast<const unsigned char*>(data);
+        end = position + size;
+    }
+
+    /// the bytes not decoded yet
+    const void* rest() const noexcept {
+        return position;
+    }
+
+    std::size_t remaining() const noexcept {
+        return static_cast<std::size_t>(end - position);
+    }
+
+    weak_wire_status readVarint(std::uint64_t& val) noexcept {
+        std::uint64_t result = 0u;
+        const unsigned char* next = position;
+
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            if (next == end) {
+                return weak_wire_status::incomplete;
+            }
+
+            unsigned char byte = *next++;
+            result |= std::uint64_t(byte & 0x7Fu) << shift;
+
+            if (byte < 0x80u) {
+                // the tenth byte only has room for the highest bit
+                if (shift == 63 && byte > 1u) {
+                    return weak_wire_status::malformed;
+                }
+
+                val = result;
+                position = next;
+                return weak_wire_status::ok;
+            }
+        }
+
+        return weak_wire_status::malformed;
+    }
+
+    /// reads Size bytes, least significant first
+    template <std::size_t Size>
+    weak_wire_status readFixed(std::uint64_t& val) noexcept {
+        if (remaining() < Size) {
+            return weak_wire_status::incomplete;
+        }
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        val = 0u;
+        std::memcpy(&val, position, Size);
+#else
+        val = 0u;
+        for (std::size_t i = 0; i < Size; ++i) {
+            val |= std::uint64_t(position[i]) << (8 * i);
+        }
+#endif
+        position += Size;
+
+        return weak_wire_status::ok;
+    }
+
+    /// the next size bytes, in place
+    weak_wire_status readBytes(std::size_t size, const unsigned char*& bytes) noexcept {
+        if (remaining() < size) {
+            return weak_wire_status::incomplete;
+        }
+
+        bytes = position;
+        position += size;
+
+        return weak_wire_status::ok;
+    }
+
+    /// decodes the next value into into, which may be any weak representation constructible from its types
+    template <typename Weak>
+    weak_wire_status read(Weak& into) {
+        const unsigned char* before = position;
+        std::uint64_t tag = 0u;
+
+        weak_wire_status status = readTag<Weak>(tag);
+        if (status == weak_wire_status::ok) {
+            status = weak_wire_types<Weak>::read(*this, tag, into);
+        }
+
+        if (status != weak_wire_status::ok) {
+            position = before;
+        }
+        return status;
+    }
+
+    /// decodes weak values into first on until last or a value fails to decode, returns the first one not decoded
+    template <typename Iterator>
+    Iterator read(Iterator first, Iterator last, weak_wire_status& status) {
+        status = weak_wire_status::ok;
+        while (first != last && (status = read(*first)) == weak_wire_status::ok) {
+            ++first;
+        }
+        return first;
+    }
+
+    /// decodes the next value of a Weak and runs Functor<View> on it without building the weak, where View is
+    /// weak_wire_format<T>::view_type for its type T, so strings are weak_wire_string. Does nothing for an invalid weak.
+    template <typename Weak, template<typename Type, typename ... Ts> class Functor, typename ... Args>
+    weak_wire_status visit(Args&&... args) {
+        const unsigned char* before = position;
+        std::uint64_t tag = 0u;
+
+        weak_wire_status status = readTag<Weak>(tag);
+        if (status == weak_wire_status::ok) {
+            status = weak_wire_types<Weak>::template visit<Functor>(*this, tag, std::forward<Args>(args)...);
+        }
+
+        if (status != weak_wire_status::ok) {
+            position = before;
+        }
+        return status;
+    }
+};
+
+//=== weak_wire_format ===//
+
+// Every format has
+//     view_type                                       what a value is decoded as
+//     static bool encode(weak_wire_encoder&, const T&)
+//     static weak_wire_status decode(weak_wire_decoder&, view_type&)
+//     static T own(const view_type&)                  the value to store in a weak
+
+template <>
+struct weak_wire_format<bool> {
+    typedef bool view_type;
+
+    static bool encode(weak_wire_encoder& out, bool val) {
+        return out.writeFixed<1>(val ? 1u : 0u);
+    }
+
+    static weak_wire_status decode(weak_wire_decoder& in, bool& val) {
+        std::uint64_t bits = 0u;
+        weak_wire_status status = in.readFixed<1>(bits);
+        val = bits != 0u;
+        return status == weak_wire_status::ok && bits > 1u ? weak_wire_status::malformed : status;
+    }
+
+    static bool own(bool val) {
+        return val;
+    }
+};
+
+template <typename T>
+struct weak_wire_format<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value &&
+                                                   sizeof(T) == 1>::type> {
+    typedef T view_type;
+
+    static bool encode(weak_wire_encoder& out, T val) {
+        return out.writeFixed<1>(static_cast<unsigned char>(val));
+    }
+
+    static weak_wire_status decode(weak_wire_decoder& in, T& val) {
+        std::uint64_t bits = 0u;
+        weak_wire_status status = in.readFixed<1>(bits);
+        val = static_cast<T>(static_cast<unsigned char>(bits));
+        return status;
+    }
+
+    static T own(T val) {
+        return val;
+    }
+};
+
+template <typename T>
+struct weak_wire_format<T, typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value &&
+                                                   !std::is_same<T, bool>::value && (sizeof(T) > 1)>::type> {
+    typedef T view_type;
+
+    static bool encode(weak_wire_encoder& out, T val) {
+        return out.writeVarint(val);
+    }
+
+    static weak_wire_status decode(weak_wire_decoder& in, T& val) {
+        std::uint64_t bits = 0u;
+        weak_wire_status status = in.readVarint(bits);
+        val = static_cast<T>(bits);
+        return status == weak_wire_status::ok && bits > std::numeric_limits<T>::max() ? weak_wire_status::malformed : status;
+    }
+
+    static T own(T val) {
+        return val;
+    }
+};
+
+template <typename T>
+struct weak_wire_format<T, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value &&
+                                                   (sizeof(T) > 1)>::type> {
+    typedef T view_type;
+
+    static bool encode(weak_wire_encoder& out, T val) {
+        // 0, -1, 1, -2, ... become 0, 1, 2, 3, ...
+        std::uint64_t bits = static_cast<std::uint64_t>(std::int64_t(val));
+        return out.writeVarint((bits << 1) ^ (val < 0 ? ~std::uint64_t(0) : 0u));
+    }
+
+    static weak_wire_status decode(weak_wire_decoder& in, T& val) {
+        std::uint64_t bits = 0u;
+        weak_wire_status status = in.readVarint(bits);
+
+        std::uint64_t magnitude = bits >> 1;
+        std::int64_t decoded = (bits & 1u) ? -std::int64_t(magnitude) - 1 : std::int64_t(magnitude);
+        val = static_cast<T>(decoded);
+
+        return status == weak_wire_status::ok && (decoded < std::numeric_limits<T>::min() ||
+                                                  decoded > std::numeric_limits<T>::max())
+               ? weak_wire_status::malformed : status;
+    }
+
+    static T own(T val) {
+        return val;
+    }
+};
+
+template <typename T>
+struct weak_wire_format<T, typename std::enable_if<std::is_enum<T>::value>::type> {
+    typedef T view_type;
+
+    typedef typename std::underlying_type<T>::type underlying;
+
+    static bool encode(weak_wire_encoder& out, T val) {
+        return weak_wire_format<underlying>::encode(out, static_cast<underlying>(val));
+    }
+
+    static weak_wire_status decode(weak_wire_decoder& in, T& val) {
+        underlying raw = underlying();
+        weak_wire_status status = weak_wire_format<underlying>::decode(in, raw);
+        val = static_cast<T>(raw);
+        return status;
+    }
+
+    static T own(T val) {
+        return val;
+    }
+};
+
+template <typename T>
+struct weak_wire_format<T, typename std::enable_if<std::is_floating_point<T>::value &&
+                                                   (sizeof(T) == 4 || sizeof(T) == 8)>::type> {
+    typedef T view_type;
+
+    typedef typename std::conditional<sizeof(T) == 4, std::uint32_t, std::uint64_t>::type bits_type;
+
+    static bool encode(weak_wire_encoder& out, T val) {
+        bits_type bits;
+        std::memcpy(&bits, &val, sizeof(T));
+        return out.writeFixed<sizeof(T)>(bits);
+    }
+
+    static weak_wire_status decode(weak_wire_decoder& in, T& val) {
+        std::uint64_t bits = 0u;
+        weak_wire_status status = in.readFixed<sizeof(T)>(bits);
+
+        bits_type narrowed = static_cast<bits_type>(bits);
+        std::memcpy(&val, &narrowed, sizeof(T));
+
+        return status;
+    }
+
+    static T own(T val) {
+        return val;
+    }
+};
+
+template <>
+struct weak_wire_format<weak_wire_string> {
+    typedef weak_wire_string view_type;
+
+    static bool encode(weak_wire_encoder& out, const weak_wire_string& val) {
+        return out.writeVarint(val.size) && out.writeBytes(val.data, val.size);
+    }
+
+    static weak_wire_status decode(weak_wire_decoder& in, weak_wire_string& val) {
+        std::uint64_t size = 0u;
+        weak_wire_status status = in.readVarint(size);
+        if (status != weak_wire_status::ok) {
+            return status;
+        }
+
+        // a length std::size_t can't hold is malformed, where casting it would wrap on 32 and 16 bit targets. One
+        // longer than the bytes left is incomplete, since the rest may come in the next buffer.
+        if (size > std::numeric_limits<std::size_t>::max()) {
+            return weak_wire_status::malformed;
+        }
+
+        const unsigned char* bytes = nullptr;
+        status = in.readBytes(static_cast<std::size_t>(size), bytes);
+
+        val.data = reinterpret_cast<const char*>(bytes);
+        val.size = static_cast<std::size_t>(size);
+
+        return status;
+    }
+
+    static weak_wire_string own(const weak_wire_string& val) {
+        return val;
+    }
+};
+
+template <>
+struct weak_wire_format<std::string> {
+    typedef weak_wire_string view_type;
+
+    static bool encode(weak_wire_encoder& out, const std::string& val) {
+        return weak_wire_format<weak_wire_string>::encode(out, weak_wire_string{ val.data(), val.size() });
+    }
+
+    static weak_wire_status decode(weak_wire_decoder& in, weak_wire_string& val) {
+        return weak_wire_format<weak_wire_string>::decode(in, val);
+    }
+
+    static std::string own(const weak_wire_string& val) {
+        return val.str();
+    }
+};
+
+#endif //WEAK_TYPES_WEAK_WIRE_H